@@ -0,0 +1,8 @@
+// Client.h (compilation des en-têtes de la carte) - Classe de base Client d'Arduino-ESP32,
+// fournie sur l'hôte par le remplaçant de WiFiClientSecure
+#ifndef DEVICE_CLIENT_H
+#define DEVICE_CLIENT_H
+
+#include <WiFiClientSecure.h>
+
+#endif // DEVICE_CLIENT_H
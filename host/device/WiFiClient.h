@@ -0,0 +1,23 @@
+// WiFiClient.h (compilation des en-têtes de la carte) - Socket TCP d'Arduino-ESP32 : déclarations
+// seules, les en-têtes qui l'utilisent sont compilés sans être liés
+#ifndef DEVICE_WIFI_CLIENT_H
+#define DEVICE_WIFI_CLIENT_H
+
+#include <Arduino.h>
+
+class WiFiClient {
+public:
+    int connect(IPAddress ip, uint16_t port);
+    int connect(const char* host, uint16_t port);
+    int connect(IPAddress ip, uint16_t port, int32_t timeout);
+    int connect(const char* host, uint16_t port, int32_t timeout);
+    size_t write(const uint8_t* buf, size_t size);
+    int available();
+    int read(uint8_t* buf, size_t size);
+    void flush();
+    void stop();
+    uint8_t connected();
+    int fd() const;
+};
+
+#endif // DEVICE_WIFI_CLIENT_H
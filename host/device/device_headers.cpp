@@ -0,0 +1,22 @@
+// device_headers.cpp - Compile src/ResumableTlsClient.h, que les autres cibles remplacent par
+// host/shims/ResumableTlsClient.h, contre le vrai mbedTLS et le WiFiClient déclaré dans host/device.
+// Rien n'est lié : la bibliothèque objet vérifie seulement que l'en-tête de la carte compile.
+#include "ResumableTlsClient.h"
+
+// Utiliser l'interface publique comme le firmware
+int deviceHeaders(TlsSessionCache& cache) {
+    ResumableTlsClient tls;
+    tls.setSessionCache(&cache);
+    tls.setHandshakeTimeout(10000);
+    tls.setWriteTimeout(5000);
+    if (!tls.connect("broker", 8883)) {
+        return -1;
+    }
+    const uint8_t packet[] = {0xC0, 0x00};
+    uint8_t reply[2];
+    tls.write(packet, sizeof(packet));
+    tls.waitForData(100);
+    int received = tls.available() ? tls.read(reply, sizeof(reply)) : tls.peek();
+    tls.stop();
+    return received + (int)tls.lastWriteMs() + (int)tls.handshakeStats().full;
+}
@@ -0,0 +1,7 @@
+// lwip/sockets.h (compilation des en-têtes de la carte) - select() de lwIP, celui de POSIX sur l'hôte
+#ifndef DEVICE_LWIP_SOCKETS_H
+#define DEVICE_LWIP_SOCKETS_H
+
+#include <sys/select.h>
+
+#endif // DEVICE_LWIP_SOCKETS_H
@@ -0,0 +1,117 @@
+// Arduino.h (hôte) - Remplaçant minimal du cœur Arduino-ESP32 pour la cible Linux
+// Le temps est simulé : millis()/delay() avancent une horloge virtuelle pilotée par HostSim
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+typedef uint8_t byte;
+
+// Sur ESP32, place une variable en mémoire RTC (conservée pendant le sommeil profond).
+// Sur l'hôte, le processus survit au sommeil simulé : une variable ordinaire suffit.
+#define RTC_DATA_ATTR
+
+// ------------------- TEMPS ------------------------
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// ------------------- ALEATOIRE ------------------------
+void randomSeed(unsigned long seed);
+long random(long howbig);
+long random(long howsmall, long howbig);
+uint32_t esp_random();
+
+// ------------------- CPU ------------------------
+uint32_t getCpuFrequencyMhz();
+
+// ------------------- TAS ------------------------
+// Valeurs fixes, proches d'un ESP32 connecté en TLS : le tas de l'hôte n'a rien de comparable
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+};
+
+extern EspClass ESP;
+
+// ------------------- CHAINES ------------------------
+class String {
+private:
+    std::string buffer;
+
+public:
+    String() {}
+    String(const char* s) : buffer(s ? s : "") {}
+    String(const std::string& s) : buffer(s) {}
+    String(int value);
+    String(unsigned int value);
+    String(long value);
+    String(unsigned long value);
+    // Comme sur Arduino, deux décimales par défaut
+    String(float value, unsigned int decimals = 2);
+    String(double value, unsigned int decimals = 2);
+
+    const char* c_str() const { return buffer.c_str(); }
+    size_t length() const { return buffer.size(); }
+    String& operator+=(const String& other) { buffer += other.buffer; return *this; }
+    String operator+(const String& other) const { return String(buffer + other.buffer); }
+    bool operator==(const char* other) const { return buffer == (other ? other : ""); }
+};
+
+// ------------------- ADRESSE IP ------------------------
+class IPAddress {
+private:
+    uint8_t octets[4];
+
+public:
+    IPAddress() : octets{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+    IPAddress(uint32_t address) {
+        memcpy(octets, &address, sizeof(octets));
+    }
+    uint8_t operator[](int index) const { return octets[index]; }
+    operator uint32_t() const {
+        uint32_t address;
+        memcpy(&address, octets, sizeof(address));
+        return address;
+    }
+    String toString() const;
+};
+
+// ------------------- PORT SERIE ------------------------
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+    size_t write(const uint8_t* data, size_t len);
+    size_t print(const char* s);
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t print(char c);
+    size_t print(int value);
+    size_t print(unsigned int value);
+    size_t print(long value);
+    size_t print(unsigned long value);
+    size_t print(double value, int decimals = 2);
+    size_t print(const IPAddress& ip) { return print(ip.toString()); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    // Place libre dans la FIFO d'émission de l'UART (sans attendre)
+    int availableForWrite();
+    void flush();
+    size_t println() { return print("\n"); }
+    template <typename T>
+    size_t println(const T& value) { size_t n = print(value); return n + print("\n"); }
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif // HOST_ARDUINO_H
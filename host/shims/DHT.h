@@ -0,0 +1,22 @@
+// DHT.h (hôte) - Capteur DHT simulé, les mesures proviennent de HostSim
+#ifndef HOST_DHT_H
+#define HOST_DHT_H
+
+#include <Arduino.h>
+
+#define DHT11 11
+#define DHT22 22
+
+class DHT {
+private:
+    uint8_t pin;
+    uint8_t type;
+
+public:
+    DHT(uint8_t pin, uint8_t type) : pin(pin), type(type) {}
+    void begin() {}
+    float readTemperature(bool fahrenheit = false, bool force = false);
+    float readHumidity(bool force = false);
+};
+
+#endif // HOST_DHT_H
@@ -0,0 +1,26 @@
+// HTTPClient.h (hôte) - Requêtes HTTP vers les appareils simulés du réseau local (prise Shelly)
+#ifndef HOST_HTTPCLIENT_H
+#define HOST_HTTPCLIENT_H
+
+#include <Arduino.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED -1
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NOT_FOUND 404
+
+class HTTPClient {
+private:
+    std::string url;
+    std::string body;
+    uint16_t timeoutMs = 5000;
+
+public:
+    bool begin(const char* target) { url = target; body.clear(); return true; }
+    void setTimeout(uint16_t ms) { timeoutMs = ms; }
+    void setConnectTimeout(int32_t ms) { timeoutMs = (uint16_t)ms; }
+    int GET();
+    String getString() { return String(body); }
+    void end() { url.clear(); }
+};
+
+#endif // HOST_HTTPCLIENT_H
@@ -0,0 +1,1925 @@
+// HostSim.cpp - Implémentation des remplaçants Arduino/ESP32 pour la cible Linux
+#include "HostSim.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <DHT.h>
+#include <esp_wifi.h>
+#include <esp_efuse.h>
+#include <esp_sleep.h>
+#include <esp_pm.h>
+#include <WiFiUdp.h>
+#include <HTTPClient.h>
+#include <mbedtls/aes.h>
+
+#include <stdarg.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <new>
+#include <random>
+
+namespace {
+
+// ------------------- ETAT GLOBAL DE LA SIMULATION ------------------------
+uint64_t clockMicros = 0;
+uint64_t bootMicros = 0;       // Instant du dernier démarrage (réveil compris)
+uint64_t sleepTimerMicros = 0; // Durée programmée par esp_sleep_enable_timer_wakeup()
+bool wokeFromSleep = false;
+hostsim::SleepStats sleepCounters = {0, 0, 0};
+bool lightSleepEnabled = false;  // esp_pm_configure() avec light_sleep_enable
+bool realTimeClock = false;
+// Valeur de l'horloge monotone lors du passage en temps réel, moins clockMicros
+uint64_t realTimeOrigin = 0;
+
+std::mt19937 arduinoRng(1);
+std::mt19937 hardwareRng(0x0A12u);
+
+uint8_t macAddress[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+// La MAC peut être imposée par OAR_HOST_MAC : elle est lue dès l'initialisation statique
+// (SecureStorage dérive sa clé dans son constructeur, avant main())
+bool macLoaded = false;
+bool wifiMacAvailable = true;
+
+typedef std::map<std::string, std::vector<uint8_t>> Namespace;
+std::map<std::string, Namespace> nvs;
+std::string nvsFile;
+hostsim::NvsStats nvsCounters = {0, 0, 0, 0};
+long nvsWritesBeforeFailure = -1;
+
+bool accessPointUp = true;
+uint8_t accessPointBssid[6] = {0xA4, 0x2B, 0xB0, 0x00, 0x00, 0x01};
+uint8_t accessPointChannel = 6;
+unsigned long scanDelayMs = 1000;
+unsigned long joinDelayMs = 150;
+unsigned long dhcpDelayMs = 350;
+bool wifiBegun = false;
+bool wifiConnected = false;
+bool wifiTargeted = false;     // WiFi.begin() avec BSSID et canal
+bool wifiTargetFound = false;  // Le BSSID/canal demandé correspond au point d'accès
+uint64_t wifiBeganAt = 0;
+IPAddress staticIp;            // Adresse de WiFi.config(), nulle en DHCP
+IPAddress staticGateway;
+IPAddress staticSubnet;
+IPAddress staticDns;
+hostsim::WifiStats wifiCounters = {0, 0, 0, 0, 0};
+wifi_ps_type_t wifiPowerSave = WIFI_PS_MIN_MODEM;
+unsigned long dtimPeriodMs = 102;
+
+bool brokerRunning = true;
+unsigned long brokerEpoch = 1;
+// Arrêts programmés (µs depuis le lancement) : début, fin
+std::vector<std::pair<uint64_t, uint64_t>> brokerOutages;
+// Temps CPU du broker (µs) et occupance par tranche de 1 ms, pour la file d'attente
+unsigned long brokerPublishMicros = 0;
+unsigned long brokerFullHandshakeMicros = 0;
+unsigned long brokerResumedHandshakeMicros = 0;
+std::map<uint64_t, uint32_t> brokerLoad;
+// Identifiant client -> propriétaire de la session (PubSubClient simulé ou connexion du transport)
+std::map<std::string, const void*> brokerSessions;
+std::vector<uint64_t> reconnectLog;
+unsigned long handshakeDelayMs = 300;
+unsigned long resumedHandshakeDelayMs = 60;
+unsigned long ticketLifetimeMs = 7200000;
+bool ticketKeyPersistent = false;
+uint32_t ticketKeyEpoch = 1;
+// Tickets émis : numéro -> (clé de tickets, instant d'émission)
+std::map<uint32_t, std::pair<uint32_t, uint64_t>> tickets;
+uint32_t nextTicket = 1;
+hostsim::TlsStats tlsCounters = {0, 0};
+std::string brokerUser;
+std::string brokerPass;
+std::vector<hostsim::Message> brokerLog;
+hostsim::BrokerStats brokerCounters = {0, 0, 0, 0, 0, 0, 0, 0};
+
+struct Subscription {
+    const void* client;
+    std::string filter;
+};
+std::vector<Subscription> subscriptions;
+std::vector<hostsim::Message> inbound;
+
+// Connexions du transport TLS au broker (voir hostsim::transportOpen)
+struct PendingBytes {
+    uint64_t availableAt;          // Réception par la carte
+    std::vector<uint8_t> bytes;
+};
+
+struct TransportConnection {
+    size_t device;
+    bool open;
+    bool mqtt;                     // CONNECT accepté
+    bool opaque;                   // Premier paquet qui n'est pas un CONNECT : octets ignorés
+    unsigned long session;         // brokerEpoch à l'ouverture
+    uint64_t openedMicros;
+    uint64_t lastInMicros;         // Dernier paquet reçu de la carte (keepalive)
+    uint16_t keepAliveSeconds;
+    std::string clientId;
+    std::vector<uint8_t> received; // Octets reçus, paquet incomplet
+    std::deque<PendingBytes> replies;
+};
+std::map<size_t, TransportConnection> transportConnections;
+size_t nextTransportConnection = 1;
+// Carte -> instant où elle a perdu sa connexion MQTT, pour les durées de reconnexion
+std::map<size_t, uint64_t> transportLostAt;
+unsigned long linkLatencyMicros = 0;
+unsigned long tlsWriteRecordMicros = 0;
+unsigned long tlsWritePerKiloByteMicros = 0;
+
+hostsim::SensorSource sensorSource;
+double sensorFailureRate = 0.0;
+std::map<uint8_t, std::pair<float, float>> sensorBias;
+std::map<uint8_t, uint64_t> sensorReadAt;   // Dernière lecture de chaque broche
+uint64_t lastSensorReadMicros = 0;
+uint8_t lastSensorPin = 0;
+hostsim::SensorStats sensorCounters = {0, 0, 0};
+const unsigned int DHT_READ_MICROS = 5000;
+std::mt19937 sensorRng(7);
+float sensorNoiseTemperature = 0;
+float sensorNoiseHumidity = 0;
+
+// Salle serveur, climatiseur, Broadlink et prise Shelly (voir hostsim::setRoom)
+bool roomEnabled = false;
+hostsim::RoomModel room;
+double roomC = 0;
+uint64_t roomMicros = 0;            // Instant jusqu'où la température de la salle est calculée
+bool acOn = false;
+uint64_t acToggledAt = 0;
+uint64_t reactionSince = 0;         // Seuil franchi, climatiseur pas encore dans le bon état (0 : aucun)
+double irLossRate = 0;
+std::mt19937 climateRng(11);
+hostsim::ClimateStats climateCounters = {};
+
+const IPAddress BROADLINK_ADDRESS(192, 168, 5, 79);
+const std::string SHELLY_URL = "http://192.168.5.251/";
+const uint16_t BROADLINK_DEVTYPE = 0x2737;                                  // RM mini 3
+const uint8_t BROADLINK_MAC[6] = {0x78, 0x0F, 0x77, 0x00, 0x00, 0x01};
+// Clé et vecteur d'initialisation publics du protocole (python-broadlink)
+const uint8_t BROADLINK_KEY[16] = {0x09, 0x76, 0x28, 0x34, 0x3f, 0xe9, 0x9e, 0x23,
+                                   0x76, 0x5c, 0x15, 0x13, 0xac, 0xcf, 0x8b, 0x02};
+const uint8_t BROADLINK_CBC_IV[16] = {0x56, 0x2e, 0x17, 0x99, 0x6d, 0x09, 0x3d, 0x28,
+                                      0xdd, 0xb3, 0xba, 0x69, 0x5a, 0x2e, 0x6f, 0x58};
+const unsigned long LAN_LATENCY_MICROS = 15000;     // Aller-retour UDP sur le réseau local
+const unsigned long SHELLY_RESPONSE_MICROS = 40000; // Requête HTTP complète vers la prise
+bool broadlinkUp = true;
+uint32_t broadlinkSession = 0;      // Session ouverte par l'authentification (0 : aucune)
+uint8_t broadlinkSessionKey[16];
+
+// État propre à chaque carte d'une flotte (voir hostsim::selectDevice). Le contexte de la carte
+// courante est dans les variables globales ci-dessus ; son emplacement ici n'a pas de sens.
+struct DeviceContext {
+    uint64_t clockMicros;
+    uint64_t bootMicros;
+    uint8_t mac[6];
+    std::map<std::string, Namespace> nvs;
+    bool wifiBegun;
+    bool wifiConnected;
+    bool wifiTargeted;
+    bool wifiTargetFound;
+    uint64_t wifiBeganAt;
+    IPAddress staticIp;
+    IPAddress staticGateway;
+    IPAddress staticSubnet;
+    IPAddress staticDns;
+    wifi_ps_type_t wifiPowerSave;
+    bool lightSleepEnabled;
+};
+std::vector<DeviceContext> devices;
+size_t activeDevice = 0;
+
+bool serialQuiet = false;
+
+std::atomic<unsigned long> allocations(0);
+thread_local int allocationPauseDepth = 0;
+
+// ------------------- PERSISTANCE DE LA NVS ------------------------
+void writeString(FILE* file, const std::string& s) {
+    uint32_t len = s.size();
+    fwrite(&len, sizeof(len), 1, file);
+    fwrite(s.data(), 1, len, file);
+}
+
+bool readString(FILE* file, std::string& s) {
+    uint32_t len;
+    if (fread(&len, sizeof(len), 1, file) != 1) {
+        return false;
+    }
+    s.resize(len);
+    return fread(&s[0], 1, len, file) == len;
+}
+
+void saveNvs() {
+    if (nvsFile.empty()) {
+        return;
+    }
+    FILE* file = fopen(nvsFile.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    for (const auto& space : nvs) {
+        for (const auto& entry : space.second) {
+            writeString(file, space.first);
+            writeString(file, entry.first);
+            writeString(file, std::string(entry.second.begin(), entry.second.end()));
+        }
+    }
+    fclose(file);
+}
+
+bool loadNvs() {
+    FILE* file = fopen(nvsFile.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    nvs.clear();
+    std::string space, key, value;
+    while (readString(file, space) && readString(file, key) && readString(file, value)) {
+        nvs[space][key] = std::vector<uint8_t>(value.begin(), value.end());
+    }
+    fclose(file);
+    return true;
+}
+
+// ------------------- CAPTEUR PAR DEFAUT ------------------------
+// Salle serveur : lente oscillation autour de 21 °C et 45 % d'humidité
+float defaultSensor(unsigned long ms, bool humidity) {
+    double hours = ms / 3600000.0;
+    if (humidity) {
+        return 45.0 + 5.0 * sin(2 * M_PI * hours / 6.0);
+    }
+    return 21.0 + 1.5 * sin(2 * M_PI * hours);
+}
+
+bool topicMatches(const std::string& filter, const std::string& topic) {
+    if (!filter.empty() && filter.back() == '#') {
+        return topic.compare(0, filter.size() - 1, filter, 0, filter.size() - 1) == 0;
+    }
+    return filter == topic;
+}
+
+// Instant où la carte reçoit un message arrivé au broker : en économie d'énergie, le point
+// d'accès garde la trame jusqu'à la balise DTIM suivante (toutes les 3 balises en MAX_MODEM)
+uint64_t deliveryMicros(uint64_t arrivalMicros) {
+    if (wifiPowerSave == WIFI_PS_NONE || dtimPeriodMs == 0) {
+        return arrivalMicros;
+    }
+    uint64_t period = (uint64_t)dtimPeriodMs * 1000 * (wifiPowerSave == WIFI_PS_MAX_MODEM ? 3 : 1);
+    return (arrivalMicros + period - 1) / period * period;
+}
+
+// UART simulée : instant (ns) où la FIFO d'émission sera vide. Un seul port pour tout le
+// programme, à n'utiliser qu'avec une seule carte simulée.
+const size_t UART_FIFO_SIZE = 128;
+unsigned long serialBaud = 0;
+uint64_t uartIdleAtNanos = 0;
+hostsim::SerialStats serialCounters = {0, 0};
+
+uint64_t uartByteNanos() { return 10000000000ULL / serialBaud; }
+
+// Octets encore dans la FIFO
+size_t uartQueued() {
+    uint64_t now = hostsim::nowMicros() * 1000;
+    if (serialBaud == 0 || uartIdleAtNanos <= now) {
+        return 0;
+    }
+    return (size_t)((uartIdleAtNanos - now + uartByteNanos() - 1) / uartByteNanos());
+}
+
+size_t emit(const char* text, size_t len) {
+    if (!serialQuiet) {
+        fwrite(text, 1, len, stdout);
+    }
+    serialCounters.bytes += len;
+    if (serialBaud) {
+        // L'appelant rend la main quand le reste de l'écriture tient dans la FIFO
+        uint64_t now = hostsim::nowMicros() * 1000;
+        uartIdleAtNanos = std::max(uartIdleAtNanos, now) + len * uartByteNanos();
+        uint64_t returnAt = uartIdleAtNanos - std::min(uartIdleAtNanos, (uint64_t)UART_FIFO_SIZE * uartByteNanos());
+        if (returnAt > now) {
+            uint64_t blocked = (returnAt - now + 999) / 1000;
+            serialCounters.blockedMicros += blocked;
+            hostsim::advanceMicros(blocked);
+        }
+    }
+    return len;
+}
+
+uint64_t monotonicMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Synchroniser l'horloge simulée sur l'horloge monotone en mode temps réel
+void syncClock() {
+    if (realTimeClock) {
+        clockMicros = monotonicMicros() - realTimeOrigin;
+    }
+}
+
+void sleepMicros(uint64_t us) {
+    struct timespec ts;
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    nanosleep(&ts, nullptr);
+}
+
+// ------------------- BROKER ------------------------
+bool brokerAvailable() {
+    if (!brokerRunning) {
+        return false;
+    }
+    uint64_t now = hostsim::nowMicros();
+    for (const auto& outage : brokerOutages) {
+        if (now >= outage.first && now < outage.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Un arrêt programmé a commencé depuis cet instant : sessions et clés de tickets sont perdues
+bool brokerRestartedSince(uint64_t since) {
+    uint64_t now = hostsim::nowMicros();
+    for (const auto& outage : brokerOutages) {
+        if (outage.first > since && outage.first <= now) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Réserver costMicros de CPU broker à partir de atMicros ; renvoie la fin du travail.
+// Les cartes d'une flotte n'avancent pas au même rythme : les demandes n'arrivent pas dans
+// l'ordre chronologique, d'où une occupation par tranche plutôt qu'une simple file.
+uint64_t brokerWork(uint64_t atMicros, unsigned long costMicros) {
+    if (costMicros == 0) {
+        return atMicros;
+    }
+    uint64_t slot = atMicros / 1000;
+    uint32_t offset = atMicros % 1000;
+    uint64_t done = atMicros;
+    while (costMicros > 0) {
+        uint32_t& used = brokerLoad[slot];
+        uint32_t start = std::max(used, offset);
+        uint32_t take = std::min<unsigned long>(1000 - start, costMicros);
+        used = start + take;
+        costMicros -= take;
+        done = slot * 1000 + used;
+        slot++;
+        offset = 0;
+    }
+    // Les cartes ne reviennent pas plus d'une minute en arrière
+    if (brokerLoad.size() > 120000) {
+        brokerLoad.erase(brokerLoad.begin(), brokerLoad.lower_bound(atMicros / 1000 - 60000));
+    }
+    return done;
+}
+
+// ------------------- BROKER MQTT SUR LE TRANSPORT ------------------------
+// Réponse envoyée par le broker à sentMicros : la carte la reçoit après la latence du lien (et la
+// balise DTIM suivante en économie d'énergie), jamais avant une réponse précédente (TCP)
+void transportReply(TransportConnection& connection, uint64_t sentMicros, std::vector<uint8_t> bytes) {
+    uint64_t at = deliveryMicros(sentMicros + linkLatencyMicros);
+    if (!connection.replies.empty()) {
+        at = std::max(at, connection.replies.back().availableAt);
+    }
+    connection.replies.push_back({at, std::move(bytes)});
+}
+
+// Fermer la connexion côté broker ; lost : perte de session constatée par la carte
+void closeTransport(TransportConnection& connection, bool lost) {
+    if (!connection.open) {
+        return;
+    }
+    connection.open = false;
+    if (!connection.mqtt) {
+        return;
+    }
+    auto owner = brokerSessions.find(connection.clientId);
+    if (owner != brokerSessions.end() && owner->second == &connection) {
+        brokerSessions.erase(owner);
+    }
+    const void* self = &connection;
+    subscriptions.erase(std::remove_if(subscriptions.begin(), subscriptions.end(),
+                                       [self](const Subscription& s) { return s.client == self; }),
+                        subscriptions.end());
+    if (lost) {
+        connection.replies.clear();
+        transportLostAt.insert(std::make_pair(connection.device, hostsim::nowMicros()));
+    }
+}
+
+bool readMqttString(const uint8_t*& p, const uint8_t* end, std::string& out) {
+    if (end - p < 2) {
+        return false;
+    }
+    size_t length = (p[0] << 8) | p[1];
+    if ((size_t)(end - p - 2) < length) {
+        return false;
+    }
+    out.assign((const char*)p + 2, length);
+    p += 2 + length;
+    return true;
+}
+
+std::vector<uint8_t> packetWithId(uint8_t type, uint16_t packetId) {
+    return {type, 2, (uint8_t)(packetId >> 8), (uint8_t)packetId};
+}
+
+// CONNECT : protocole MQTT 3.1.1, identifiants, prise de session (comme Mosquitto, un client de
+// même identifiant perd la sienne). Faux si ce n'est pas un CONNECT valide.
+bool brokerConnect(TransportConnection& connection, const uint8_t* p, const uint8_t* end) {
+    std::string protocol, id, user, pass;
+    if (!readMqttString(p, end, protocol) || protocol != "MQTT" || end - p < 4 || p[0] != 4) {
+        return false;
+    }
+    uint8_t flags = p[1];
+    connection.keepAliveSeconds = (p[2] << 8) | p[3];
+    p += 4;
+    if ((flags & 0x04) || !readMqttString(p, end, id) ||
+        ((flags & 0x80) && !readMqttString(p, end, user)) ||
+        ((flags & 0x40) && !readMqttString(p, end, pass))) {
+        return false;
+    }
+    uint64_t now = hostsim::nowMicros();
+    uint64_t arrival = now + linkLatencyMicros;
+    connection.mqtt = true;
+    connection.clientId = id;
+    if (!brokerUser.empty() && (brokerUser != user || brokerPass != pass)) {
+        brokerCounters.refused++;
+        transportReply(connection, arrival, {0x20, 2, 0, 4});
+        connection.open = false;
+        return true;
+    }
+    const void*& owner = brokerSessions[id];
+    if (owner && owner != &connection) {
+        brokerCounters.takeovers++;
+    }
+    owner = &connection;
+    brokerCounters.connects++;
+    auto lost = transportLostAt.find(connection.device);
+    if (lost != transportLostAt.end()) {
+        reconnectLog.push_back(now - lost->second);
+        transportLostAt.erase(lost);
+    }
+    transportReply(connection, arrival, {0x20, 2, 0, 0});
+    return true;
+}
+
+void brokerPacket(TransportConnection& connection, uint8_t header, const uint8_t* p, const uint8_t* end) {
+    uint64_t now = hostsim::nowMicros();
+    uint64_t arrival = now + linkLatencyMicros;
+    connection.lastInMicros = now;
+    switch (header >> 4) {
+    case 3: {  // PUBLISH
+        hostsim::Message message;
+        uint16_t packetId = 0;
+        message.qos = (header >> 1) & 0x03;
+        message.dup = (header & 0x08) != 0;
+        if (!readMqttString(p, end, message.topic) || (message.qos && end - p < 2)) {
+            return;
+        }
+        if (message.qos) {
+            packetId = (p[0] << 8) | p[1];
+            p += 2;
+        }
+        message.payload.assign(p, end);
+        message.timeMicros = now;
+        message.deliveredMicros = brokerWork(arrival, brokerPublishMicros);
+        message.device = connection.device;
+        brokerLog.push_back(message);
+        brokerCounters.published++;
+        if (message.qos) {
+            brokerCounters.qos1++;
+            brokerCounters.duplicates += message.dup;
+            transportReply(connection, message.deliveredMicros, packetWithId(0x40, packetId));
+        }
+        break;
+    }
+    case 8: {  // SUBSCRIBE : abonnements accordés en QoS 0
+        if (end - p < 2) {
+            return;
+        }
+        uint16_t packetId = (p[0] << 8) | p[1];
+        std::vector<uint8_t> suback = packetWithId(0x90, packetId);
+        p += 2;
+        std::string filter;
+        while (readMqttString(p, end, filter) && p < end) {
+            subscriptions.push_back({&connection, filter});
+            suback.push_back(0);
+            p++;
+        }
+        suback[1] = (uint8_t)(suback.size() - 2);
+        transportReply(connection, arrival, suback);
+        break;
+    }
+    case 12:  // PINGREQ
+        brokerCounters.pings++;
+        transportReply(connection, arrival, {0xD0, 0});
+        break;
+    case 14:  // DISCONNECT
+        closeTransport(connection, false);
+        break;
+    default:  // PUBACK d'un message entrant (QoS 0 uniquement ici), autres paquets ignorés
+        break;
+    }
+}
+
+// Messages injectés parvenus à la carte : PUBLISH QoS 0 vers les abonnements de la connexion
+void deliverInbound(TransportConnection& connection) {
+    uint64_t now = hostsim::nowMicros();
+    for (size_t i = 0; i < inbound.size();) {
+        const hostsim::Message& message = inbound[i];
+        uint64_t at = deliveryMicros(message.timeMicros + linkLatencyMicros);
+        if (at > now) {
+            i++;
+            continue;
+        }
+        bool subscribed = false;
+        for (const auto& subscription : subscriptions) {
+            if (subscription.client == &connection && topicMatches(subscription.filter, message.topic)) {
+                subscribed = true;
+            }
+        }
+        if (subscribed) {
+            size_t length = 2 + message.topic.size() + message.payload.size();
+            std::vector<uint8_t> packet(1, 0x30);
+            do {
+                packet.push_back((uint8_t)((length & 0x7F) | (length > 0x7F ? 0x80 : 0)));
+                length >>= 7;
+            } while (length);
+            packet.push_back((uint8_t)(message.topic.size() >> 8));
+            packet.push_back((uint8_t)message.topic.size());
+            packet.insert(packet.end(), message.topic.begin(), message.topic.end());
+            packet.insert(packet.end(), message.payload.begin(), message.payload.end());
+            transportReply(connection, message.timeMicros, packet);
+        }
+        inbound.erase(inbound.begin() + i);
+    }
+}
+
+// ------------------- SALLE ET CLIMATISEUR ------------------------
+bool compressorRunning(uint64_t at) {
+    return acOn && at - acToggledAt >= (uint64_t)room.compressorDelayMs * 1000;
+}
+
+// Le climatiseur est dans le mauvais état pour la température courante
+bool climateOffTarget() {
+    return (roomC > room.upperC && !acOn) || (roomC < room.lowerC && acOn);
+}
+
+// Faire avancer la température de la salle jusqu'à un instant, par pas d'une seconde au plus
+void advanceRoom(uint64_t now) {
+    while (roomEnabled && roomMicros < now) {
+        uint64_t step = std::min<uint64_t>(now - roomMicros, 1000000);
+        bool cooling = compressorRunning(roomMicros);
+        double watts = room.heatLoadW - (cooling ? room.coolingW : 0) - room.leakWK * (roomC - room.outsideC);
+        roomC += watts * (step / 1e6) / room.heatCapacityJK;
+        roomMicros += step;
+        climateCounters.minC = std::min(climateCounters.minC, (float)roomC);
+        climateCounters.maxC = std::max(climateCounters.maxC, (float)roomC);
+        if (roomC > room.upperC) {
+            climateCounters.aboveUpperMicros += step;
+        }
+        if (cooling) {
+            climateCounters.compressorMicros += step;
+        }
+        if (reactionSince == 0 && climateOffTarget()) {
+            reactionSince = roomMicros;
+        }
+    }
+}
+
+// Commande IR émise : une chance sur irLossRate de ne pas atteindre le climatiseur
+void receiveIrCommand(uint64_t now) {
+    hostsim::AllocationPause pause;
+    advanceRoom(now);
+    climateCounters.irCommands++;
+    if (irLossRate > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(climateRng) < irLossRate) {
+        climateCounters.irLost++;
+        return;
+    }
+    acOn = !acOn;
+    acToggledAt = now;
+    climateCounters.toggles++;
+    if (reactionSince != 0 && !climateOffTarget()) {
+        climateCounters.reactions.push_back(now - reactionSince);
+        reactionSince = 0;
+    }
+}
+
+float meteredPower(uint64_t now) {
+    advanceRoom(now);
+    bool toggledRecently = climateCounters.toggles > 0 && now - acToggledAt < (uint64_t)room.powerLagMs * 1000;
+    bool metered = toggledRecently ? !acOn : acOn;
+    if (!metered) {
+        return 0.8f;  // Veille
+    }
+    return compressorRunning(now) ? 1650.0f : 45.0f;  // Ventilation seule avant le compresseur
+}
+
+uint16_t broadlinkSum(const uint8_t* data, size_t length) {
+    uint32_t sum = 0xBEAF;
+    for (size_t i = 0; i < length; i++) {
+        sum += data[i];
+    }
+    return (uint16_t)sum;
+}
+
+void broadlinkAes(const uint8_t key[16], int mode, const uint8_t* input, uint8_t* output, size_t length) {
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    uint8_t iv[16];
+    memcpy(iv, BROADLINK_CBC_IV, sizeof(iv));
+    if (mode == MBEDTLS_AES_ENCRYPT) {
+        mbedtls_aes_setkey_enc(&aes, key, 128);
+    } else {
+        mbedtls_aes_setkey_dec(&aes, key, 128);
+    }
+    mbedtls_aes_crypt_cbc(&aes, mode, length, iv, input, output);
+    mbedtls_aes_free(&aes);
+}
+
+// Réponse du Broadlink : en-tête, code d'erreur et charge utile chiffrée
+void broadlinkReply(uint16_t type, uint16_t error, const uint8_t key[16], const uint8_t* payload, size_t length,
+                    std::vector<uint8_t>& reply) {
+    static const uint8_t magic[8] = {0x5a, 0xa5, 0xaa, 0x55, 0x5a, 0xa5, 0xaa, 0x55};
+    reply.assign(0x38 + length, 0);
+    memcpy(reply.data(), magic, sizeof(magic));
+    reply[0x22] = (uint8_t)error;
+    reply[0x23] = (uint8_t)(error >> 8);
+    reply[0x24] = (uint8_t)BROADLINK_DEVTYPE;
+    reply[0x25] = (uint8_t)(BROADLINK_DEVTYPE >> 8);
+    reply[0x26] = (uint8_t)(type + 0x3E8);
+    reply[0x27] = (uint8_t)((type + 0x3E8) >> 8);
+    if (length) {
+        broadlinkAes(key, MBEDTLS_AES_ENCRYPT, payload, reply.data() + 0x38, length);
+    }
+    uint16_t checksum = broadlinkSum(reply.data(), reply.size());
+    reply[0x20] = (uint8_t)checksum;
+    reply[0x21] = (uint8_t)(checksum >> 8);
+}
+
+// Traiter un datagramme reçu par le Broadlink ; false si l'appareil ne répond pas
+bool broadlinkReceive(const std::vector<uint8_t>& packet, std::vector<uint8_t>& reply) {
+    if (!broadlinkUp) {
+        return false;
+    }
+    // Découverte : type d'appareil et MAC (octets inversés)
+    if (packet.size() == 0x30 && packet[0x26] == 0x06) {
+        reply.assign(0x80, 0);
+        reply[0x34] = (uint8_t)BROADLINK_DEVTYPE;
+        reply[0x35] = (uint8_t)(BROADLINK_DEVTYPE >> 8);
+        for (int i = 0; i < 6; i++) {
+            reply[0x3a + i] = BROADLINK_MAC[5 - i];
+        }
+        return true;
+    }
+    static const uint8_t magic[8] = {0x5a, 0xa5, 0xaa, 0x55, 0x5a, 0xa5, 0xaa, 0x55};
+    if (packet.size() < 0x48 || (packet.size() - 0x38) % 16 != 0 || memcmp(packet.data(), magic, 8) != 0) {
+        climateCounters.rejected++;
+        return false;
+    }
+    std::vector<uint8_t> header(packet.begin(), packet.end());
+    header[0x20] = header[0x21] = 0;
+    bool macMatches = true;
+    for (int i = 0; i < 6; i++) {
+        macMatches = macMatches && packet[0x2a + i] == BROADLINK_MAC[5 - i];
+    }
+    if (broadlinkSum(header.data(), header.size()) != (packet[0x20] | (packet[0x21] << 8)) ||
+        (packet[0x24] | (packet[0x25] << 8)) != BROADLINK_DEVTYPE || !macMatches) {
+        climateCounters.rejected++;
+        return false;
+    }
+    uint16_t type = packet[0x26] | (packet[0x27] << 8);
+    uint32_t id = packet[0x30] | (packet[0x31] << 8) | (packet[0x32] << 16) | ((uint32_t)packet[0x33] << 24);
+    if (type != 0x65 && (broadlinkSession == 0 || id != broadlinkSession)) {
+        climateCounters.rejected++;
+        broadlinkReply(type, 0xFFF9, BROADLINK_KEY, nullptr, 0, reply);  // Session inconnue : réauthentifier
+        return true;
+    }
+    const uint8_t* key = type == 0x65 ? BROADLINK_KEY : broadlinkSessionKey;
+    std::vector<uint8_t> payload(packet.size() - 0x38);
+    broadlinkAes(key, MBEDTLS_AES_DECRYPT, packet.data() + 0x38, payload.data(), payload.size());
+    if (broadlinkSum(payload.data(), payload.size()) != (packet[0x34] | (packet[0x35] << 8))) {
+        climateCounters.rejected++;
+        return false;
+    }
+
+    uint8_t response[32] = {};
+    if (type == 0x65) {
+        // Authentification : nouvel identifiant et nouvelle clé de session
+        broadlinkSession = (uint32_t)climateRng() | 1;
+        for (auto& byte : broadlinkSessionKey) {
+            byte = (uint8_t)climateRng();
+        }
+        for (int i = 0; i < 4; i++) {
+            response[i] = (uint8_t)(broadlinkSession >> (8 * i));
+        }
+        memcpy(response + 4, broadlinkSessionKey, 16);
+        climateCounters.authentications++;
+        broadlinkReply(type, 0, BROADLINK_KEY, response, 32, reply);
+        return true;
+    }
+    if (type == 0x6a && payload.size() > 4 && payload[0] == 0x02 && payload[1] == 0 && payload[2] == 0 &&
+        payload[3] == 0 && payload[4] == 0x26) {
+        receiveIrCommand(hostsim::nowMicros());
+        broadlinkReply(type, 0, broadlinkSessionKey, response, 16, reply);
+        return true;
+    }
+    climateCounters.rejected++;
+    broadlinkReply(type, 0xFFFB, broadlinkSessionKey, nullptr, 0, reply);  // Commande non prise en charge
+    return true;
+}
+
+// ------------------- FLOTTE ------------------------
+void saveDevice(DeviceContext& context) {
+    context.clockMicros = clockMicros;
+    context.bootMicros = bootMicros;
+    memcpy(context.mac, macAddress, 6);
+    context.nvs.swap(nvs);
+    context.wifiBegun = wifiBegun;
+    context.wifiConnected = wifiConnected;
+    context.wifiTargeted = wifiTargeted;
+    context.wifiTargetFound = wifiTargetFound;
+    context.wifiBeganAt = wifiBeganAt;
+    context.staticIp = staticIp;
+    context.staticGateway = staticGateway;
+    context.staticSubnet = staticSubnet;
+    context.staticDns = staticDns;
+    context.wifiPowerSave = wifiPowerSave;
+    context.lightSleepEnabled = lightSleepEnabled;
+}
+
+void loadDevice(DeviceContext& context) {
+    clockMicros = context.clockMicros;
+    bootMicros = context.bootMicros;
+    memcpy(macAddress, context.mac, 6);
+    nvs.swap(context.nvs);
+    wifiBegun = context.wifiBegun;
+    wifiConnected = context.wifiConnected;
+    wifiTargeted = context.wifiTargeted;
+    wifiTargetFound = context.wifiTargetFound;
+    wifiBeganAt = context.wifiBeganAt;
+    staticIp = context.staticIp;
+    staticGateway = context.staticGateway;
+    staticSubnet = context.staticSubnet;
+    staticDns = context.staticDns;
+    wifiPowerSave = context.wifiPowerSave;
+    lightSleepEnabled = context.lightSleepEnabled;
+}
+
+} // namespace
+
+// ------------------- ALLOCATIONS ------------------------
+// Remplacement des opérateurs globaux : malloc/free sont le bon couple ici
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void* operator new(size_t size) {
+    if (allocationPauseDepth == 0) {
+        allocations++;
+    }
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+#pragma GCC diagnostic pop
+
+// ------------------- TEMPS ------------------------
+// millis()/micros() repartent de zéro au réveil d'un sommeil profond, comme sur l'ESP32
+unsigned long millis() { syncClock(); return (unsigned long)((clockMicros - bootMicros) / 1000); }
+unsigned long micros() { syncClock(); return (unsigned long)(clockMicros - bootMicros); }
+void delay(unsigned long ms) { hostsim::advanceMicros((uint64_t)ms * 1000); }
+void delayMicroseconds(unsigned int us) { hostsim::advanceMicros(us); }
+void yield() {}
+
+// ------------------- ALEATOIRE ------------------------
+void randomSeed(unsigned long seed) { arduinoRng.seed(seed); }
+
+long random(long howbig) {
+    if (howbig <= 0) {
+        return 0;
+    }
+    return (long)(arduinoRng() % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig) {
+    if (howsmall >= howbig) {
+        return howsmall;
+    }
+    return howsmall + random(howbig - howsmall);
+}
+
+uint32_t esp_random() { return hardwareRng(); }
+
+uint32_t getCpuFrequencyMhz() { return 240; }
+
+EspClass ESP;
+uint32_t EspClass::getFreeHeap() { return 182000; }
+uint32_t EspClass::getMinFreeHeap() { return 141000; }
+uint32_t EspClass::getMaxAllocHeap() { return 110580; }
+
+namespace {
+
+// MAC de base, telle que lue dans les eFuses
+void readBaseMac(uint8_t mac[6]) {
+    if (!macLoaded) {
+        const char* text = getenv("OAR_HOST_MAC");
+        if (text && !hostsim::parseMac(text, macAddress)) {
+            fprintf(stderr, "OAR_HOST_MAC invalide : %s\n", text);
+        }
+        macLoaded = true;
+    }
+    memcpy(mac, macAddress, 6);
+}
+
+} // namespace
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]) {
+    (void)ifx;
+    if (!wifiMacAvailable) {
+        return ESP_FAIL;
+    }
+    readBaseMac(mac);
+    return ESP_OK;
+}
+
+esp_err_t esp_read_mac(uint8_t mac[6], esp_mac_type_t type) {
+    (void)type;
+    readBaseMac(mac);
+    return ESP_OK;
+}
+
+esp_err_t esp_efuse_read_block(esp_efuse_block_t blk, void* dst_key, size_t offset_in_bits, size_t size_bits) {
+    (void)blk;
+    (void)offset_in_bits;
+    memset(dst_key, 0, (size_bits + 7) / 8);
+    return ESP_OK;
+}
+
+// ------------------- SOMMEIL PROFOND ------------------------
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) {
+    sleepTimerMicros = time_in_us;
+    return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+    return wokeFromSleep ? ESP_SLEEP_WAKEUP_TIMER : ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+void esp_deep_sleep_start() {
+    // La radio est coupée pendant le sommeil ; au réveil, millis() repart de zéro
+    WiFi.disconnect(true);
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+    hostsim::advanceMicros(sleepTimerMicros);
+    sleepCounters.wakeups++;
+    sleepCounters.sleptMicros += sleepTimerMicros;
+    bootMicros = hostsim::nowMicros();
+    wokeFromSleep = true;
+    throw hostsim::DeepSleep();
+}
+
+// ------------------- GESTION D'ENERGIE ------------------------
+esp_err_t esp_pm_configure(const void* config) {
+    const esp_pm_config_t* pm = (const esp_pm_config_t*)config;
+    if (!pm || pm->min_freq_mhz > pm->max_freq_mhz) {
+        return ESP_FAIL;
+    }
+    lightSleepEnabled = pm->light_sleep_enable;
+    return ESP_OK;
+}
+
+// ------------------- CHAINES ------------------------
+String::String(int value) : buffer(std::to_string(value)) {}
+String::String(unsigned int value) : buffer(std::to_string(value)) {}
+String::String(long value) : buffer(std::to_string(value)) {}
+String::String(unsigned long value) : buffer(std::to_string(value)) {}
+String::String(float value, unsigned int decimals) : String((double)value, decimals) {}
+
+String::String(double value, unsigned int decimals) {
+    char text[48];
+    snprintf(text, sizeof(text), "%.*f", (int)decimals, value);
+    buffer = text;
+}
+
+String IPAddress::toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+    return String(text);
+}
+
+// ------------------- PORT SERIE ------------------------
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud) { (void)baud; }
+size_t HardwareSerial::write(const uint8_t* data, size_t len) { return emit((const char*)data, len); }
+size_t HardwareSerial::print(const char* s) { return emit(s, strlen(s)); }
+size_t HardwareSerial::print(char c) { return emit(&c, 1); }
+size_t HardwareSerial::print(int value) { return printf("%d", value); }
+size_t HardwareSerial::print(unsigned int value) { return printf("%u", value); }
+size_t HardwareSerial::print(long value) { return printf("%ld", value); }
+size_t HardwareSerial::print(unsigned long value) { return printf("%lu", value); }
+size_t HardwareSerial::print(double value, int decimals) { return printf("%.*f", decimals, value); }
+
+int HardwareSerial::availableForWrite() { return (int)(UART_FIFO_SIZE - uartQueued()); }
+
+void HardwareSerial::flush() {
+    fflush(stdout);
+    uint64_t now = hostsim::nowMicros() * 1000;
+    if (serialBaud && uartIdleAtNanos > now) {
+        hostsim::advanceMicros((uartIdleAtNanos - now + 999) / 1000);
+    }
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (len < 0) {
+        return 0;
+    }
+    return emit(text, (size_t)len < sizeof(text) ? (size_t)len : sizeof(text) - 1);
+}
+
+// ------------------- PREFERENCES (NVS) ------------------------
+bool Preferences::begin(const char* name, bool readOnly) {
+    hostsim::AllocationPause pause;
+    if (opened || !name || strlen(name) > 15) {
+        return false;
+    }
+    // En lecture seule, un espace de noms inexistant ne peut pas être ouvert
+    if (readOnly && nvs.find(name) == nvs.end()) {
+        return false;
+    }
+    ns = name;
+    this->readOnly = readOnly;
+    opened = true;
+    nvsCounters.opens++;
+    return true;
+}
+
+void Preferences::end() {
+    opened = false;
+    ns.clear();
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+    hostsim::AllocationPause pause;
+    if (!opened || readOnly || !key || strlen(key) > 15 || !value || len == 0) {
+        return 0;
+    }
+    if (nvsWritesBeforeFailure >= 0 && nvsWritesBeforeFailure-- == 0) {
+        return 0;
+    }
+    const uint8_t* bytes = (const uint8_t*)value;
+    nvs[ns][key] = std::vector<uint8_t>(bytes, bytes + len);
+    nvsCounters.writes++;
+    nvsCounters.bytesWritten += len;
+    saveNvs();
+    return len;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    hostsim::AllocationPause pause;
+    if (!opened || !key) {
+        return 0;
+    }
+    auto space = nvs.find(ns);
+    if (space == nvs.end()) {
+        return 0;
+    }
+    auto entry = space->second.find(key);
+    return entry == space->second.end() ? 0 : entry->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+    hostsim::AllocationPause pause;
+    size_t len = getBytesLength(key);
+    if (len == 0 || !buf || len > maxLen) {
+        return 0;
+    }
+    memcpy(buf, nvs[ns][key].data(), len);
+    nvsCounters.reads++;
+    return len;
+}
+
+bool Preferences::isKey(const char* key) {
+    return getBytesLength(key) > 0;
+}
+
+bool Preferences::remove(const char* key) {
+    hostsim::AllocationPause pause;
+    if (!opened || readOnly || !key) {
+        return false;
+    }
+    bool removed = nvs[ns].erase(key) > 0;
+    saveNvs();
+    return removed;
+}
+
+bool Preferences::clear() {
+    hostsim::AllocationPause pause;
+    if (!opened || readOnly) {
+        return false;
+    }
+    nvs[ns].clear();
+    saveNvs();
+    return true;
+}
+
+// ------------------- WI-FI ------------------------
+WiFiClass WiFi;
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel,
+                              const uint8_t* bssid, bool connect) {
+    (void)ssid;
+    (void)passphrase;
+    wifiBegun = connect;
+    wifiConnected = false;
+    wifiTargeted = channel > 0 && bssid != nullptr;
+    wifiTargetFound = wifiTargeted && channel == accessPointChannel &&
+                      memcmp(bssid, accessPointBssid, sizeof(accessPointBssid)) == 0;
+    wifiBeganAt = hostsim::nowMicros();
+    wifiCounters.begins++;
+    return status();
+}
+
+bool WiFiClass::config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2) {
+    (void)dns2;
+    staticIp = local_ip;
+    staticGateway = gateway;
+    staticSubnet = subnet;
+    staticDns = dns1;
+    return true;
+}
+
+bool WiFiClass::disconnect(bool wifiOff) {
+    (void)wifiOff;
+    wifiBegun = false;
+    wifiConnected = false;
+    return true;
+}
+
+wl_status_t WiFiClass::status() {
+    if (!wifiBegun) {
+        return WL_DISCONNECTED;
+    }
+    if (!accessPointUp) {
+        bool lost = wifiConnected;
+        wifiConnected = false;
+        wifiBegun = !lost;
+        return lost ? WL_CONNECTION_LOST : WL_NO_SSID_AVAIL;
+    }
+    if (wifiTargeted && !wifiTargetFound) {
+        // Le point d'accès n'est plus sur ce canal : pas de balayage, l'association n'aboutit pas
+        return WL_NO_SSID_AVAIL;
+    }
+    if (!wifiConnected) {
+        bool dhcp = (uint32_t)staticIp == 0;
+        unsigned long delayMs = (wifiTargeted ? 0 : scanDelayMs) + joinDelayMs + (dhcp ? dhcpDelayMs : 0);
+        if (hostsim::nowMicros() >= wifiBeganAt + (uint64_t)delayMs * 1000) {
+            wifiConnected = true;
+            wifiCounters.associations++;
+            wifiCounters.scans += wifiTargeted ? 0 : 1;
+            wifiCounters.dhcp += dhcp ? 1 : 0;
+            wifiCounters.connectMicros += (uint64_t)delayMs * 1000;
+        }
+    }
+    return wifiConnected ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+IPAddress WiFiClass::localIP() {
+    if (!wifiConnected) {
+        return IPAddress();
+    }
+    return (uint32_t)staticIp != 0 ? staticIp : IPAddress(192, 168, 1, 50);
+}
+
+IPAddress WiFiClass::gatewayIP() {
+    return wifiConnected ? IPAddress(192, 168, 1, 1) : IPAddress();
+}
+
+IPAddress WiFiClass::subnetMask() {
+    return wifiConnected ? IPAddress(255, 255, 255, 0) : IPAddress();
+}
+
+IPAddress WiFiClass::dnsIP(uint8_t dns_no) {
+    (void)dns_no;
+    return wifiConnected ? IPAddress(192, 168, 1, 1) : IPAddress();
+}
+
+uint8_t* WiFiClass::BSSID() {
+    return wifiConnected ? accessPointBssid : nullptr;
+}
+
+int32_t WiFiClass::channel() {
+    return wifiConnected ? accessPointChannel : 0;
+}
+
+bool WiFiClass::setSleep(bool enabled) {
+    return setSleep(enabled ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+}
+
+bool WiFiClass::setSleep(wifi_ps_type_t sleepType) {
+    wifiPowerSave = sleepType;
+    return true;
+}
+
+// ------------------- CLIENT MQTT ------------------------
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+    host = domain ? domain : "";
+    this->port = port;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+    this->callback = callback;
+    return *this;
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass) {
+    hostsim::AllocationPause pause;
+    session = 0;
+    if (host.empty() || WiFi.status() != WL_CONNECTED) {
+        currentState = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    // Comme PubSubClient : connexion TCP + TLS par le transport, puis paquet CONNECT
+    if (!transport->connect(host.c_str(), port)) {
+        currentState = MQTT_CONNECTION_TIMEOUT;
+        return false;
+    }
+    if (!brokerUser.empty() && (brokerUser != (user ? user : "") || brokerPass != (pass ? pass : ""))) {
+        brokerCounters.refused++;
+        currentState = MQTT_CONNECT_BAD_CREDENTIALS;
+        return false;
+    }
+    // Comme Mosquitto : un client de même identifiant perd sa session au profit du nouveau
+    clientId = id ? id : "";
+    const void*& owner = brokerSessions[clientId];
+    if (owner && owner != this) {
+        brokerCounters.takeovers++;
+    }
+    owner = this;
+    // Session propre : les abonnements de la session précédente sont oubliés
+    subscriptions.erase(std::remove_if(subscriptions.begin(), subscriptions.end(),
+                                       [this](const Subscription& s) { return s.client == this; }),
+                        subscriptions.end());
+    session = brokerEpoch;
+    sessionStartMicros = hostsim::nowMicros();
+    if (lostAtMicros) {
+        reconnectLog.push_back(sessionStartMicros - lostAtMicros);
+        lostAtMicros = 0;
+    }
+    currentState = MQTT_CONNECTED;
+    brokerCounters.connects++;
+    static const uint8_t connectPacket[2] = {0x10, 0x00};
+    writePacket(connectPacket, sizeof(connectPacket));
+    return true;
+}
+
+void PubSubClient::disconnect() {
+    hostsim::AllocationPause pause;
+    auto owner = brokerSessions.find(clientId);
+    if (owner != brokerSessions.end() && owner->second == this) {
+        brokerSessions.erase(owner);
+    }
+    session = 0;
+    currentState = MQTT_DISCONNECTED;
+    transport->stop();
+}
+
+void PubSubClient::loseSession() {
+    session = 0;
+    currentState = MQTT_CONNECTION_LOST;
+    lostAtMicros = hostsim::nowMicros();
+    transport->stop();
+}
+
+bool PubSubClient::connected() {
+    if (currentState != MQTT_CONNECTED) {
+        return false;
+    }
+    if (session != brokerEpoch || brokerRestartedSince(sessionStartMicros) || WiFi.status() != WL_CONNECTED) {
+        loseSession();
+        return false;
+    }
+    // Le broker ferme la session après 1,5 x keepAlive sans paquet du client (MQTT 3.1.1)
+    if (keepAliveSeconds && millis() - lastOutActivity > keepAliveSeconds * 1500UL) {
+        brokerCounters.expired++;
+        loseSession();
+        return false;
+    }
+    if (!brokerSessions.empty()) {
+        auto owner = brokerSessions.find(clientId);
+        if (owner == brokerSessions.end() || owner->second != this) {
+            loseSession();
+            return false;
+        }
+    }
+    return true;
+}
+
+void PubSubClient::writePacket(const uint8_t* data, size_t len) {
+    transport->write(data, len);
+    lastOutActivity = millis();
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload) {
+    return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+    hostsim::AllocationPause pause;
+    (void)retained;
+    if (!connected() || !topic) {
+        return false;
+    }
+    // Comme PubSubClient : le paquet entier doit tenir dans le buffer
+    if (5 + 2 + strlen(topic) + length > bufferSize) {
+        return false;
+    }
+    hostsim::Message message;
+    message.topic = topic;
+    message.payload.assign(payload, payload + length);
+    message.timeMicros = hostsim::nowMicros();
+    message.deliveredMicros = brokerWork(message.timeMicros + linkLatencyMicros, brokerPublishMicros);
+    message.device = activeDevice;
+    message.qos = 0;
+    message.dup = false;
+    brokerLog.push_back(message);
+    brokerCounters.published++;
+    writePacket(payload, length);
+    return true;
+}
+
+bool PubSubClient::subscribe(const char* topic) {
+    hostsim::AllocationPause pause;
+    if (!connected() || !topic) {
+        return false;
+    }
+    subscriptions.push_back({this, topic});
+    return true;
+}
+
+bool PubSubClient::loop() {
+    hostsim::AllocationPause pause;
+    if (!connected()) {
+        return false;
+    }
+    if (keepAliveSeconds && millis() - lastOutActivity > keepAliveSeconds * 1000UL) {
+        static const uint8_t pingPacket[2] = {0xC0, 0x00};
+        writePacket(pingPacket, sizeof(pingPacket));
+        brokerCounters.pings++;
+    }
+    // Seuls les messages déjà parvenus à la carte sont lus (balise DTIM en économie d'énergie)
+    std::vector<hostsim::Message> pending;
+    uint64_t now = hostsim::nowMicros();
+    for (size_t i = 0; i < inbound.size();) {
+        if (deliveryMicros(inbound[i].timeMicros) <= now) {
+            pending.push_back(inbound[i]);
+            inbound.erase(inbound.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    for (auto& message : pending) {
+        bool delivered = false;
+        for (const auto& subscription : subscriptions) {
+            if (subscription.client == this && topicMatches(subscription.filter, message.topic)) {
+                delivered = true;
+            }
+        }
+        if (delivered && callback) {
+            callback(&message.topic[0], message.payload.data(), message.payload.size());
+        }
+    }
+    return true;
+}
+
+// ------------------- CAPTEUR DHT ------------------------
+// Noter l'instant de la lecture : les sondes doivent être lues à tour de rôle, pas en rafale
+void recordSensorRead(uint8_t pin) {
+    hostsim::AllocationPause pause;
+    uint64_t now = hostsim::nowMicros();
+    if (sensorCounters.reads > 0 && pin != lastSensorPin) {
+        uint64_t spacing = now - lastSensorReadMicros;
+        if (sensorCounters.minSpacingMicros == 0 || spacing < sensorCounters.minSpacingMicros) {
+            sensorCounters.minSpacingMicros = spacing;
+        }
+    }
+    sensorReadAt[pin] = now;
+    sensorCounters.reads++;
+    sensorCounters.pins = sensorReadAt.size();
+    lastSensorReadMicros = now;
+    lastSensorPin = pin;
+}
+
+float DHT::readTemperature(bool fahrenheit, bool force) {
+    (void)force;
+    recordSensorRead(pin);
+    // Trame du DHT22 : signal de départ et 40 bits, lus en attente active
+    delayMicroseconds(DHT_READ_MICROS);
+    std::uniform_real_distribution<double> draw(0.0, 1.0);
+    if (sensorFailureRate > 0 && draw(sensorRng) < sensorFailureRate) {
+        return NAN;
+    }
+    float celsius = (sensorSource ? sensorSource : defaultSensor)(hostsim::nowMicros() / 1000, false);
+    auto bias = sensorBias.find(pin);
+    if (bias != sensorBias.end()) {
+        celsius += bias->second.first;
+    }
+    if (sensorNoiseTemperature > 0) {
+        celsius += std::normal_distribution<float>(0, sensorNoiseTemperature)(sensorRng);
+    }
+    return fahrenheit ? celsius * 1.8f + 32 : celsius;
+}
+
+float DHT::readHumidity(bool force) {
+    (void)force;
+    std::uniform_real_distribution<double> draw(0.0, 1.0);
+    if (sensorFailureRate > 0 && draw(sensorRng) < sensorFailureRate) {
+        return NAN;
+    }
+    float humidity = (sensorSource ? sensorSource : defaultSensor)(hostsim::nowMicros() / 1000, true);
+    auto bias = sensorBias.find(pin);
+    if (bias != sensorBias.end()) {
+        humidity += bias->second.second;
+    }
+    if (sensorNoiseHumidity > 0) {
+        humidity += std::normal_distribution<float>(0, sensorNoiseHumidity)(sensorRng);
+    }
+    return humidity;
+}
+
+// ------------------- UDP ET HTTP DU RESEAU LOCAL ------------------------
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    hostsim::AllocationPause pause;
+    destination = ip;
+    destinationPort = port;
+    outgoing.clear();
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size) {
+    hostsim::AllocationPause pause;
+    outgoing.insert(outgoing.end(), buffer, buffer + size);
+    return size;
+}
+
+int WiFiUDP::endPacket() {
+    hostsim::AllocationPause pause;
+    if (!wifiConnected || localPort == 0) {
+        return 0;
+    }
+    // Seul le Broadlink répond ; les autres datagrammes sont perdus
+    std::vector<uint8_t> reply;
+    if ((uint32_t)destination == (uint32_t)BROADLINK_ADDRESS && destinationPort == 80 &&
+        broadlinkReceive(outgoing, reply)) {
+        pending.swap(reply);
+        pendingAt = hostsim::nowMicros() + LAN_LATENCY_MICROS;
+        source = destination;
+    }
+    outgoing.clear();
+    return 1;
+}
+
+int WiFiUDP::parsePacket() {
+    hostsim::AllocationPause pause;
+    if (pending.empty() || hostsim::nowMicros() < pendingAt) {
+        return 0;
+    }
+    incoming.swap(pending);
+    pending.clear();
+    return (int)incoming.size();
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t len) {
+    size_t n = std::min(len, incoming.size());
+    memcpy(buffer, incoming.data(), n);
+    incoming.erase(incoming.begin(), incoming.begin() + n);
+    return (int)n;
+}
+
+// Prise Shelly : /status avec la consommation du climatiseur ; tout autre hôte est injoignable
+int HTTPClient::GET() {
+    hostsim::AllocationPause pause;
+    if (!wifiConnected) {
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    if (url.compare(0, SHELLY_URL.size(), SHELLY_URL) != 0) {
+        delay(timeoutMs);
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    if (url != SHELLY_URL + "status") {
+        hostsim::advanceMicros(SHELLY_RESPONSE_MICROS);
+        return HTTP_CODE_NOT_FOUND;
+    }
+    hostsim::advanceMicros(SHELLY_RESPONSE_MICROS);
+    climateCounters.powerReads++;
+    float power = meteredPower(hostsim::nowMicros());
+    char json[320];
+    snprintf(json, sizeof(json),
+             "{\"wifi_sta\":{\"connected\":true,\"ssid\":\"oar\",\"ip\":\"192.168.5.251\",\"rssi\":-61},"
+             "\"relays\":[{\"ison\":true,\"has_timer\":false,\"overpower\":false}],"
+             "\"meters\":[{\"power\":%.2f,\"overpower\":0.00,\"is_valid\":true,\"total\":%lu}],"
+             "\"temperature\":41.3,\"overtemperature\":false}",
+             power, (unsigned long)(climateCounters.compressorMicros / 60000000));
+    body = json;
+    return HTTP_CODE_OK;
+}
+
+// ------------------- PILOTAGE ------------------------
+namespace hostsim {
+
+uint64_t nowMicros() { syncClock(); return clockMicros; }
+
+void advanceMicros(uint64_t us) {
+    if (realTimeClock) {
+        sleepMicros(us);
+        syncClock();
+    } else {
+        clockMicros += us;
+    }
+}
+
+void setRealTime(bool enabled) {
+    syncClock();
+    realTimeClock = enabled;
+    realTimeOrigin = monotonicMicros() - clockMicros;
+}
+
+bool realTime() { return realTimeClock; }
+
+void setMac(const uint8_t mac[6]) {
+    memcpy(macAddress, mac, 6);
+    macLoaded = true;
+}
+
+void setWifiMacAvailable(bool available) { wifiMacAvailable = available; }
+
+void seedHardwareRandom(uint32_t seed) { hardwareRng.seed(seed); }
+
+bool parseMac(const char* text, uint8_t mac[6]) {
+    unsigned int bytes[6];
+    if (sscanf(text, "%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2],
+               &bytes[3], &bytes[4], &bytes[5]) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (bytes[i] > 0xFF) {
+            return false;
+        }
+        mac[i] = (uint8_t)bytes[i];
+    }
+    return true;
+}
+
+bool setNvsFile(const char* path) {
+    nvsFile = path ? path : "";
+    return !nvsFile.empty() && loadNvs();
+}
+
+const NvsContents& nvsContents() { return nvs; }
+const NvsStats& nvsStats() { return nvsCounters; }
+void resetNvsStats() { nvsCounters = {0, 0, 0, 0}; }
+
+void failNvsWriteAfter(long writes) { nvsWritesBeforeFailure = writes; }
+
+void setAccessPointUp(bool up) { accessPointUp = up; }
+void setAccessPointChannel(uint8_t channel) {
+    if (channel != accessPointChannel) {
+        // Le point d'accès redémarre sur un autre canal : les stations sont déconnectées
+        accessPointChannel = channel;
+        wifiConnected = false;
+        wifiBegun = false;
+    }
+}
+
+void setWifiTimings(unsigned long scanMs, unsigned long joinMs, unsigned long dhcpMs) {
+    scanDelayMs = scanMs;
+    joinDelayMs = joinMs;
+    dhcpDelayMs = dhcpMs;
+}
+void setDtimPeriod(unsigned long ms) { dtimPeriodMs = ms; }
+const WifiStats& wifiStats() { return wifiCounters; }
+
+void setBrokerUp(bool up) {
+    if (brokerRunning && !up) {
+        // Toutes les sessions en cours sont perdues
+        brokerEpoch++;
+        subscriptions.clear();
+        brokerSessions.clear();
+        if (!ticketKeyPersistent) {
+            ticketKeyEpoch++;
+        }
+    }
+    brokerRunning = up;
+}
+
+bool brokerUp() { return brokerAvailable(); }
+
+void addBrokerOutage(unsigned long startMs, unsigned long endMs) {
+    brokerOutages.push_back(std::make_pair((uint64_t)startMs * 1000, (uint64_t)endMs * 1000));
+}
+
+void setBrokerCosts(unsigned long publishMicros, unsigned long fullHandshakeMicros,
+                    unsigned long resumedHandshakeMicros) {
+    brokerPublishMicros = publishMicros;
+    brokerFullHandshakeMicros = fullHandshakeMicros;
+    brokerResumedHandshakeMicros = resumedHandshakeMicros;
+}
+
+const std::vector<uint64_t>& reconnectDurations() { return reconnectLog; }
+void setHandshakeDelay(unsigned long ms) { handshakeDelayMs = ms; }
+
+void setResumedHandshakeDelay(unsigned long ms) { resumedHandshakeDelayMs = ms; }
+void setTicketLifetime(unsigned long ms) { ticketLifetimeMs = ms; }
+void setTicketKeyPersistent(bool persistent) { ticketKeyPersistent = persistent; }
+
+uint32_t tlsHandshake(uint32_t ticket, bool& resumed) {
+    auto it = tickets.find(ticket);
+    resumed = brokerAvailable() && it != tickets.end() && it->second.first == ticketKeyEpoch &&
+              (ticketKeyPersistent || !brokerRestartedSince(it->second.second)) &&
+              nowMicros() - it->second.second < (uint64_t)ticketLifetimeMs * 1000;
+    // La poignée de main occupe le CPU, qu'elle aboutisse ou non
+    delay(resumed ? resumedHandshakeDelayMs : handshakeDelayMs);
+    if (!brokerAvailable()) {
+        brokerCounters.refused++;
+        return 0;
+    }
+    // Puis le CPU du broker, partagé avec les autres cartes
+    uint64_t now = nowMicros();
+    advanceMicros(brokerWork(now, resumed ? brokerResumedHandshakeMicros : brokerFullHandshakeMicros) - now);
+    if (resumed) {
+        tlsCounters.resumed++;
+    } else {
+        tlsCounters.full++;
+    }
+    // Un nouveau ticket à chaque poignée de main, comme le fait un serveur TLS 1.2
+    uint32_t issued = nextTicket++;
+    tickets[issued] = std::make_pair(ticketKeyEpoch, nowMicros());
+    return issued;
+}
+
+const TlsStats& tlsStats() { return tlsCounters; }
+
+void setBrokerCredentials(const char* user, const char* pass) {
+    brokerUser = user ? user : "";
+    brokerPass = pass ? pass : "";
+}
+
+const std::vector<Message>& publishedMessages() { return brokerLog; }
+const BrokerStats& brokerStats() { return brokerCounters; }
+
+void injectMessage(const char* topic, const uint8_t* payload, size_t length) {
+    injectMessageAt(topic, payload, length, nowMicros());
+}
+
+void injectMessageAt(const char* topic, const uint8_t* payload, size_t length, uint64_t atMicros) {
+    Message message;
+    message.topic = topic;
+    message.payload.assign(payload, payload + length);
+    message.timeMicros = atMicros;
+    message.deliveredMicros = atMicros;
+    message.device = 0;
+    message.qos = 0;
+    message.dup = false;
+    inbound.push_back(message);
+}
+
+void setLinkLatency(unsigned long micros) { linkLatencyMicros = micros; }
+
+void setTlsWriteCost(unsigned long recordMicros, unsigned long perKiloByteMicros) {
+    tlsWriteRecordMicros = recordMicros;
+    tlsWritePerKiloByteMicros = perKiloByteMicros;
+}
+
+size_t transportOpen() {
+    AllocationPause pause;
+    size_t id = nextTransportConnection++;
+    TransportConnection& connection = transportConnections[id];
+    uint64_t now = nowMicros();
+    connection.device = activeDevice;
+    connection.open = true;
+    connection.mqtt = false;
+    connection.opaque = false;
+    connection.session = brokerEpoch;
+    connection.openedMicros = now;
+    connection.lastInMicros = now;
+    connection.keepAliveSeconds = 0;
+    return id;
+}
+
+void transportClose(size_t connection) {
+    AllocationPause pause;
+    auto it = transportConnections.find(connection);
+    if (it != transportConnections.end()) {
+        closeTransport(it->second, true);
+        transportConnections.erase(it);
+    }
+}
+
+bool transportConnected(size_t connection) {
+    AllocationPause pause;
+    auto it = transportConnections.find(connection);
+    if (it == transportConnections.end() || !it->second.open) {
+        return false;
+    }
+    TransportConnection& c = it->second;
+    bool alive = WiFi.status() == WL_CONNECTED && brokerAvailable() && c.session == brokerEpoch &&
+                 !brokerRestartedSince(c.openedMicros);
+    if (alive && c.mqtt) {
+        // Le broker ferme la session après 1,5 x keepAlive sans paquet du client (MQTT 3.1.1)
+        if (c.keepAliveSeconds && nowMicros() - c.lastInMicros > c.keepAliveSeconds * 1500000ULL) {
+            brokerCounters.expired++;
+            alive = false;
+        }
+        auto owner = brokerSessions.find(c.clientId);
+        if (owner == brokerSessions.end() || owner->second != &c) {
+            alive = false;
+        }
+    }
+    if (!alive) {
+        closeTransport(c, true);
+    }
+    return alive;
+}
+
+size_t transportWrite(size_t connection, const uint8_t* data, size_t length) {
+    AllocationPause pause;
+    advanceMicros(tlsWriteRecordMicros + (uint64_t)length * tlsWritePerKiloByteMicros / 1024);
+    if (!transportConnected(connection)) {
+        return 0;
+    }
+    TransportConnection& c = transportConnections[connection];
+    if (c.opaque) {
+        return length;
+    }
+    c.received.insert(c.received.end(), data, data + length);
+    size_t offset = 0;
+    while (c.open && !c.opaque) {
+        // En-tête fixe : type, longueur restante (1 à 4 octets de 7 bits)
+        size_t available = c.received.size() - offset;
+        size_t remaining = 0;
+        size_t lengthBytes = 0;
+        bool complete = false;
+        while (!complete && lengthBytes < 4 && 1 + lengthBytes < available) {
+            uint8_t b = c.received[offset + 1 + lengthBytes];
+            remaining |= (size_t)(b & 0x7F) << (7 * lengthBytes);
+            lengthBytes++;
+            complete = !(b & 0x80);
+        }
+        if (!complete || available < 1 + lengthBytes + remaining) {
+            break;
+        }
+        uint8_t header = c.received[offset];
+        const uint8_t* body = c.received.data() + offset + 1 + lengthBytes;
+        if (c.mqtt) {
+            brokerPacket(c, header, body, body + remaining);
+        } else if ((header >> 4) != 1 || !brokerConnect(c, body, body + remaining)) {
+            c.opaque = true;
+        }
+        offset += 1 + lengthBytes + remaining;
+    }
+    if (c.opaque) {
+        c.received.clear();
+    } else {
+        c.received.erase(c.received.begin(), c.received.begin() + offset);
+    }
+    return length;
+}
+
+int transportAvailable(size_t connection) {
+    AllocationPause pause;
+    auto it = transportConnections.find(connection);
+    if (it == transportConnections.end()) {
+        return 0;
+    }
+    TransportConnection& c = it->second;
+    if (c.open && c.mqtt) {
+        deliverInbound(c);
+    }
+    uint64_t now = nowMicros();
+    int available = 0;
+    for (const auto& pending : c.replies) {
+        if (pending.availableAt > now) {
+            break;
+        }
+        available += pending.bytes.size();
+    }
+    return available;
+}
+
+int transportRead(size_t connection, uint8_t* buffer, size_t size) {
+    AllocationPause pause;
+    if (transportAvailable(connection) == 0) {
+        return -1;
+    }
+    std::deque<PendingBytes>& replies = transportConnections[connection].replies;
+    uint64_t now = nowMicros();
+    size_t read = 0;
+    while (read < size && !replies.empty() && replies.front().availableAt <= now) {
+        std::vector<uint8_t>& bytes = replies.front().bytes;
+        size_t take = std::min(size - read, bytes.size());
+        memcpy(buffer + read, bytes.data(), take);
+        read += take;
+        bytes.erase(bytes.begin(), bytes.begin() + take);
+        if (bytes.empty()) {
+            replies.pop_front();
+        }
+    }
+    return (int)read;
+}
+
+bool waitForInbound(unsigned long timeoutMs) {
+    uint64_t now = nowMicros();
+    uint64_t deadline = now + (uint64_t)timeoutMs * 1000;
+    uint64_t wake = deadline;
+    if (wifiConnected) {
+        for (const auto& message : inbound) {
+            uint64_t delivery = deliveryMicros(message.timeMicros);
+            wake = std::min(wake, std::max(now, delivery));
+        }
+        // Réponses du broker au client MQTT de cette carte
+        for (const auto& entry : transportConnections) {
+            const TransportConnection& c = entry.second;
+            if (c.device == activeDevice && c.open && !c.replies.empty()) {
+                wake = std::min(wake, std::max(now, c.replies.front().availableAt));
+            }
+        }
+    }
+    if (wake > now) {
+        advanceMicros(wake - now);
+        if (lightSleepEnabled) {
+            sleepCounters.lightSleptMicros += wake - now;
+        }
+    }
+    return wake < deadline;
+}
+
+void setSensorSource(SensorSource source) { sensorSource = source; }
+void setSensorFailureRate(double rate) { sensorFailureRate = rate; }
+void setSensorBias(uint8_t pin, float temperature, float humidity) {
+    sensorBias[pin] = std::make_pair(temperature, humidity);
+}
+void setSensorNoise(float temperature, float humidity) {
+    sensorNoiseTemperature = temperature;
+    sensorNoiseHumidity = humidity;
+}
+const SensorStats& sensorStats() { return sensorCounters; }
+
+bool loadSensorTrace(const char* path, std::vector<TraceSample>& samples) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    samples.clear();
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        TraceSample sample;
+        char temperature[16];
+        char humidity[16];
+        if (line[0] == '#' || sscanf(line, "%lu,%15[^,],%15s", &sample.ms, temperature, humidity) != 3) {
+            continue;
+        }
+        // strtof lit "nan" comme NaN
+        sample.temperature = strtof(temperature, nullptr);
+        sample.humidity = strtof(humidity, nullptr);
+        samples.push_back(sample);
+    }
+    fclose(file);
+    return !samples.empty();
+}
+
+void setSensorTrace(const std::vector<TraceSample>& samples) {
+    if (samples.empty()) {
+        sensorSource = nullptr;
+        return;
+    }
+    unsigned long period = samples.back().ms + (samples.size() > 1 ? samples[1].ms - samples[0].ms : 1);
+    sensorSource = [samples, period](unsigned long ms, bool humidity) {
+        unsigned long t = samples.front().ms + ms % period;
+        auto it = std::upper_bound(samples.begin(), samples.end(), t,
+                                   [](unsigned long value, const TraceSample& s) { return value < s.ms; });
+        const TraceSample& sample = it == samples.begin() ? *it : *(it - 1);
+        return humidity ? sample.humidity : sample.temperature;
+    };
+}
+
+RoomModel defaultRoom() {
+    RoomModel model;
+    model.initialC = 21.0f;
+    model.outsideC = 25.0f;
+    model.heatLoadW = 3000.0f;
+    model.coolingW = 5000.0f;
+    model.heatCapacityJK = 900000.0f;
+    model.leakWK = 40.0f;
+    model.powerLagMs = 5000;
+    model.compressorDelayMs = 60000;
+    model.upperC = 22.0f;
+    model.lowerC = 20.0f;
+    return model;
+}
+
+void setRoom(const RoomModel& model) {
+    room = model;
+    roomEnabled = true;
+    roomC = model.initialC;
+    roomMicros = nowMicros();
+    climateCounters.minC = climateCounters.maxC = model.initialC;
+    sensorSource = [](unsigned long ms, bool humidity) {
+        (void)ms;
+        return humidity ? 45.0f : roomTemperature();
+    };
+}
+
+void setIrLossRate(double rate) { irLossRate = rate; }
+
+void setBroadlinkUp(bool up) {
+    if (up && !broadlinkUp) {
+        broadlinkSession = 0;  // Redémarrage : la session ouverte est perdue
+    }
+    broadlinkUp = up;
+}
+
+void sendIrCommand() { receiveIrCommand(nowMicros()); }
+
+float roomTemperature() {
+    advanceRoom(nowMicros());
+    return (float)roomC;
+}
+
+float acPower() {
+    AllocationPause pause;
+    return meteredPower(nowMicros());
+}
+
+const ClimateStats& climateStats() {
+    advanceRoom(nowMicros());
+    return climateCounters;
+}
+
+void selectDevice(size_t index) {
+    if (devices.empty()) {
+        devices.resize(1);
+    }
+    if (index == activeDevice) {
+        return;
+    }
+    saveDevice(devices[activeDevice]);
+    if (index >= devices.size()) {
+        uint64_t now = clockMicros;
+        size_t first = devices.size();
+        devices.resize(index + 1);
+        for (size_t i = first; i <= index; i++) {
+            DeviceContext& context = devices[i];
+            context.clockMicros = now;
+            context.bootMicros = now;
+            memcpy(context.mac, devices[0].mac, 6);
+            context.mac[4] = (uint8_t)((i + 1) >> 8);
+            context.mac[5] = (uint8_t)(i + 1);
+            context.wifiBegun = false;
+            context.wifiConnected = false;
+            context.wifiTargeted = false;
+            context.wifiTargetFound = false;
+            context.wifiBeganAt = 0;
+            context.wifiPowerSave = WIFI_PS_MIN_MODEM;
+            context.lightSleepEnabled = false;
+        }
+    }
+    loadDevice(devices[index]);
+    activeDevice = index;
+    macLoaded = true;
+}
+
+size_t currentDevice() { return activeDevice; }
+
+void setSerialQuiet(bool quiet) { serialQuiet = quiet; }
+void setSerialBaud(unsigned long baud) { serialBaud = baud; }
+const SerialStats& serialStats() { return serialCounters; }
+
+const SleepStats& sleepStats() { return sleepCounters; }
+
+unsigned long allocationCount() { return allocations; }
+AllocationPause::AllocationPause() { allocationPauseDepth++; }
+AllocationPause::~AllocationPause() { allocationPauseDepth--; }
+
+} // namespace hostsim
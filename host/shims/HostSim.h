@@ -0,0 +1,288 @@
+// HostSim.h - Pilotage de l'environnement simulé (horloge, NVS, Wi-Fi, broker, capteur)
+// Utilisé par les programmes hôtes pour mettre en scène le firmware sans carte ESP32
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace hostsim {
+
+// ------------------- HORLOGE VIRTUELLE ------------------------
+// Temps simulé en microsecondes depuis le démarrage
+uint64_t nowMicros();
+void advanceMicros(uint64_t us);
+inline void advance(unsigned long ms) { advanceMicros((uint64_t)ms * 1000); }
+// Mode temps réel : millis()/micros() suivent l'horloge monotone et delay() dort vraiment
+// (nécessaire pour les bancs de mesure)
+void setRealTime(bool enabled);
+bool realTime();
+
+// ------------------- SOMMEIL PROFOND ------------------------
+// Levée par esp_deep_sleep_start() : le programme hôte la rattrape et rappelle setup(),
+// les variables RTC_DATA_ATTR (variables ordinaires sur l'hôte) gardent leur valeur
+struct DeepSleep {};
+
+struct SleepStats {
+    unsigned long wakeups;      // Réveils par le timer
+    uint64_t sleptMicros;       // Durée cumulée de sommeil
+    uint64_t lightSleptMicros;  // Attentes bloquées avec le sommeil léger automatique (esp_pm)
+};
+
+const SleepStats& sleepStats();
+
+// ------------------- IDENTITE DE LA CARTE ------------------------
+// Par défaut 24:0a:c4:00:00:01, ou la valeur de la variable d'environnement OAR_HOST_MAC
+void setMac(const uint8_t mac[6]);
+bool parseMac(const char* text, uint8_t mac[6]);
+// Sur la carte, esp_wifi_get_mac échoue tant que le Wi-Fi n'est pas démarré (esp_read_mac, qui lit
+// les eFuses, réussit toujours) : false reproduit ce cas. Disponible par défaut.
+void setWifiMacAvailable(bool available);
+// Graine du générateur matériel (esp_random), fixe par défaut pour des simulations reproductibles
+void seedHardwareRandom(uint32_t seed);
+
+// ------------------- NVS ------------------------
+struct NvsStats {
+    unsigned long opens;        // Appels à Preferences::begin()
+    unsigned long reads;        // Lectures de blobs (getBytes)
+    unsigned long writes;       // Écritures de blobs (putBytes)
+    unsigned long bytesWritten; // Octets écrits en flash
+};
+
+// Contenu de la NVS simulée : espace de noms -> clé -> blob
+typedef std::map<std::string, std::map<std::string, std::vector<uint8_t>>> NvsContents;
+
+// Persister la NVS simulée dans un fichier (chargée immédiatement si elle existe)
+bool setNvsFile(const char* path);
+const NvsContents& nvsContents();
+const NvsStats& nvsStats();
+void resetNvsStats();
+// Faire échouer un putBytes après writes écritures réussies (erreur d'écriture en flash),
+// les suivants réussissent à nouveau ; -1 : aucun échec
+void failNvsWriteAfter(long writes);
+
+// ------------------- WI-FI ------------------------
+struct WifiStats {
+    unsigned long begins;       // Appels à WiFi.begin()
+    unsigned long associations; // Associations réussies
+    unsigned long scans;        // Balayages complets des canaux
+    unsigned long dhcp;         // Baux obtenus par DHCP
+    uint64_t connectMicros;     // Durée cumulée entre WiFi.begin() et l'association
+};
+
+// Point d'accès simulé : BSSID a4:2b:b0:00:00:01, canal 6, réseau 192.168.1.0/24
+void setAccessPointUp(bool up);
+// Changer le canal du point d'accès (un BSSID/canal en cache ne permet plus de le rejoindre)
+void setAccessPointChannel(uint8_t channel);
+// Durées simulées : balayage de tous les canaux, authentification/association, DHCP
+void setWifiTimings(unsigned long scanMs, unsigned long joinMs, unsigned long dhcpMs);
+// Intervalle entre deux balises DTIM (102 ms : balise de 102,4 ms, DTIM 1). En économie d'énergie,
+// le point d'accès garde les trames destinées à la carte jusqu'à la balise DTIM suivante.
+void setDtimPeriod(unsigned long ms);
+const WifiStats& wifiStats();
+
+// ------------------- BROKER MQTT ------------------------
+struct Message {
+    std::string topic;
+    std::vector<uint8_t> payload;
+    uint64_t timeMicros;        // Envoi par la carte
+    uint64_t deliveredMicros;   // Traitement par le broker (file d'attente CPU comprise)
+    size_t device;              // Carte émettrice (voir selectDevice)
+    uint8_t qos;
+    bool dup;                   // Renvoi d'un message QoS 1 après une perte de session
+};
+
+struct BrokerStats {
+    unsigned long connects;     // Connexions acceptées
+    unsigned long refused;      // Connexions refusées (broker arrêté, identifiants)
+    unsigned long published;    // Messages reçus par le broker
+    unsigned long pings;        // PINGREQ reçus
+    unsigned long expired;      // Sessions fermées par le broker faute d'activité (keepalive)
+    unsigned long takeovers;    // Sessions fermées par la connexion d'un client de même identifiant
+    unsigned long qos1;         // Messages QoS 1 reçus (acquittés par PUBACK)
+    unsigned long duplicates;   // Messages QoS 1 reçus avec le drapeau DUP
+};
+
+void setBrokerUp(bool up);
+bool brokerUp();
+// Arrêt programmé du broker entre deux instants (ms depuis le lancement), évalué sur l'horloge de
+// la carte courante : chaque carte d'une flotte voit la coupure à son propre rythme
+void addBrokerOutage(unsigned long startMs, unsigned long endMs);
+// Temps CPU du broker par message reçu, par poignée de main complète et par reprise de session.
+// Le broker traite un travail à la fois : sous la charge d'une flotte, les messages attendent
+// et les poignées de main s'allongent. Nuls par défaut (broker infiniment rapide).
+void setBrokerCosts(unsigned long publishMicros, unsigned long fullHandshakeMicros,
+                    unsigned long resumedHandshakeMicros);
+// Durées de reconnexion MQTT : de la perte de la session constatée par la carte à la
+// connexion suivante acceptée
+const std::vector<uint64_t>& reconnectDurations();
+// Durée simulée d'une poignée de main TLS complète + CONNECT
+void setHandshakeDelay(unsigned long ms);
+// Identifiants attendus par le broker (vides = tout accepter)
+void setBrokerCredentials(const char* user, const char* pass);
+const std::vector<Message>& publishedMessages();
+const BrokerStats& brokerStats();
+// Déposer un message entrant pour les clients abonnés au topic
+void injectMessage(const char* topic, const uint8_t* payload, size_t length);
+// Même chose à un instant donné (temps simulé depuis le lancement)
+void injectMessageAt(const char* topic, const uint8_t* payload, size_t length, uint64_t atMicros);
+// Latence aller simple du lien carte-broker (0 par défaut) : les paquets du client MQTT de la carte
+// arrivent au broker après ce délai, ses réponses (PUBACK...) reviennent après le même délai
+void setLinkLatency(unsigned long micros);
+// Durée d'un write() sur le transport TLS (chiffrement de l'enregistrement, remise à la pile TCP),
+// pendant laquelle l'appelant est bloqué : par écriture et par Ko (0 par défaut)
+void setTlsWriteCost(unsigned long recordMicros, unsigned long perKiloByteMicros);
+// Côté carte : attendre un message entrant livrable, au plus timeoutMs. L'attente compte comme
+// sommeil léger si esp_pm_configure() l'a activé. Renvoie true si un message est arrivé.
+bool waitForInbound(unsigned long timeoutMs);
+
+// ------------------- MQTT SUR LE TRANSPORT TLS ------------------------
+// Connexion ouverte par le transport TLS simulé après la poignée de main. Le broker lit les
+// paquets MQTT 3.1.1 écrits par la carte (CONNECT, PUBLISH QoS 0 et 1, SUBSCRIBE, PINGREQ,
+// DISCONNECT) et ses réponses (CONNACK, PUBACK, SUBACK, PINGRESP, messages des abonnements) sont
+// lisibles après la latence du lien. Une connexion dont le premier paquet n'est pas un CONNECT
+// MQTT (PubSubClient simulé, paquets factices) est ignorée. Les sessions ne sont pas conservées
+// par le broker (CONNACK sans session présente) : les abonnements sont refaits à chaque connexion.
+size_t transportOpen();
+void transportClose(size_t connection);
+bool transportConnected(size_t connection);
+size_t transportWrite(size_t connection, const uint8_t* data, size_t length);
+int transportAvailable(size_t connection);
+int transportRead(size_t connection, uint8_t* buffer, size_t size);
+
+// ------------------- TLS ------------------------
+// Le broker accepte de reprendre une session (ticket) tant qu'elle n'a pas expiré et que sa clé
+// de tickets n'a pas changé. Par défaut la clé change à chaque redémarrage du broker, comme
+// Mosquitto ; une clé persistante modélise un terminateur TLS partagé par plusieurs brokers.
+struct TlsStats {
+    unsigned long full;         // Poignées de main complètes
+    unsigned long resumed;      // Sessions reprises
+};
+
+// Durée simulée d'une reprise de session + CONNECT
+void setResumedHandshakeDelay(unsigned long ms);
+void setTicketLifetime(unsigned long ms);
+void setTicketKeyPersistent(bool persistent);
+// Poignée de main côté broker : ticket = 0 pour une poignée complète. Renvoie le nouveau
+// ticket (0 si le broker est injoignable) et indique si la session a été reprise.
+uint32_t tlsHandshake(uint32_t ticket, bool& resumed);
+const TlsStats& tlsStats();
+
+// ------------------- CAPTEUR DHT ------------------------
+// Source des mesures : (temps en ms, true pour l'humidité) -> valeur
+typedef std::function<float(unsigned long, bool)> SensorSource;
+void setSensorSource(SensorSource source);
+// Probabilité qu'une lecture renvoie NaN
+void setSensorFailureRate(double rate);
+// Écart ajouté aux valeurs de la source pour le capteur d'une broche (sondes d'une même baie)
+void setSensorBias(uint8_t pin, float temperature, float humidity);
+// Bruit gaussien ajouté à chaque lecture (écarts types en °C et en %)
+void setSensorNoise(float temperature, float humidity);
+
+struct SensorStats {
+    unsigned long reads;            // Lectures du DHT (readTemperature), toutes broches confondues
+    unsigned long pins;             // Broches lues au moins une fois
+    unsigned long minSpacingMicros; // Écart minimal entre deux lectures de broches différentes
+};
+const SensorStats& sensorStats();
+
+// Trace enregistrée : une lecture par ligne "ms,temperature,humidite" ("nan" pour un échec),
+// lignes commençant par # ignorées
+struct TraceSample {
+    unsigned long ms;
+    float temperature;
+    float humidity;
+};
+
+bool loadSensorTrace(const char* path, std::vector<TraceSample>& samples);
+// Rejouer une trace : chaque lecture renvoie la ligne la plus récente, la trace tourne en boucle
+void setSensorTrace(const std::vector<TraceSample>& samples);
+
+// ------------------- SALLE ET CLIMATISEUR ------------------------
+// Salle serveur simulée : la chaleur des équipements, les échanges avec l'extérieur et le froid du
+// compresseur font évoluer la température lue par le capteur DHT (humidité fixe à 45 %).
+// Le climatiseur n'a qu'une touche marche/arrêt, reçue par infrarouge d'un Broadlink RM mini 3
+// (UDP, 192.168.5.79:80, protocole chiffré vérifié paquet par paquet) ; sa prise Shelly
+// (GET http://192.168.5.251/status) mesure la consommation.
+struct RoomModel {
+    float initialC;                 // Température au lancement
+    float outsideC;                 // Température autour de la salle
+    float heatLoadW;                // Chaleur dégagée par les équipements
+    float coolingW;                 // Froid produit par le compresseur
+    float heatCapacityJK;           // Capacité thermique (air, baies)
+    float leakWK;                   // Échanges avec l'extérieur par degré d'écart
+    unsigned long powerLagMs;       // Après une commande, délai avant que la prise mesure le nouvel état
+    unsigned long compressorDelayMs;// Après la mise en marche, délai avant le démarrage du compresseur
+    float upperC;                   // Seuils de la régulation attendue, pour le bilan (temps de réaction)
+    float lowerC;
+};
+
+struct ClimateStats {
+    unsigned long irCommands;       // Commandes IR émises par le Broadlink
+    unsigned long irLost;           // Commandes émises mais pas reçues par le climatiseur
+    unsigned long toggles;          // Changements d'état du climatiseur
+    unsigned long powerReads;       // Requêtes /status reçues par la prise
+    unsigned long rejected;         // Paquets refusés par le Broadlink (somme, session, clé)
+    unsigned long authentications;  // Sessions ouvertes sur le Broadlink
+    float minC;
+    float maxC;
+    uint64_t aboveUpperMicros;      // Durée au-dessus du seuil haut
+    uint64_t compressorMicros;      // Durée de fonctionnement du compresseur
+    std::vector<uint64_t> reactions;// Du franchissement d'un seuil au changement d'état du climatiseur
+};
+
+// Salle de 3 kW refroidie par un climatiseur de 5 kW, seuils de regulationtemp.py
+RoomModel defaultRoom();
+// Activer la salle : le capteur DHT lit désormais sa température
+void setRoom(const RoomModel& room);
+// Probabilité qu'une commande IR émise n'atteigne pas le climatiseur
+void setIrLossRate(double rate);
+// Broadlink éteint : aucune réponse ; au retour, les sessions ouvertes sont perdues
+void setBroadlinkUp(bool up);
+// Commande IR émise hors du firmware (régulation côté serveur simulée)
+void sendIrCommand();
+float roomTemperature();
+// Consommation mesurée par la prise (W)
+float acPower();
+const ClimateStats& climateStats();
+
+// ------------------- FLOTTE ------------------------
+// Plusieurs cartes dans un même processus : chacune a sa MAC (24:0a:c4:00:xx:yy, index + 1), sa NVS,
+// son état Wi-Fi et sa propre horloge, qui part de l'instant de sa création. Le broker, le point
+// d'accès et le capteur simulé sont partagés. selectDevice() rend la carte indiquée courante
+// (créée au premier appel) : horloge, NVS et Wi-Fi désignent ensuite les siens.
+// Sans appel, le programme ne simule qu'une carte, la carte 0.
+void selectDevice(size_t index);
+size_t currentDevice();
+
+// ------------------- PORT SERIE ------------------------
+void setSerialQuiet(bool quiet);
+// Débit de l'UART simulée (0 par défaut : écriture instantanée). Avec un débit, la FIFO
+// d'émission de 128 octets se vide à baud/10 octets par seconde et une écriture qui n'y tient
+// pas bloque l'appelant sur l'horloge simulée, comme Serial sans tampon logiciel sur ESP32.
+void setSerialBaud(unsigned long baud);
+struct SerialStats {
+    unsigned long bytes;        // Octets écrits
+    uint64_t blockedMicros;     // Temps passé bloqué dans une écriture, FIFO pleine
+};
+const SerialStats& serialStats();
+
+// ------------------- ALLOCATIONS ------------------------
+// Nombre d'appels à operator new/new[] faits par le code du firmware.
+// Les allocations internes des remplaçants (NVS, broker simulés) ne sont pas comptées.
+unsigned long allocationCount();
+
+// Suspendre le comptage dans la portée courante (utilisé par les remplaçants)
+class AllocationPause {
+public:
+    AllocationPause();
+    ~AllocationPause();
+};
+
+} // namespace hostsim
+
+#endif // HOST_SIM_H
@@ -0,0 +1,26 @@
+// Preferences.h (hôte) - NVS simulée en mémoire, optionnellement persistée dans un fichier
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+
+class Preferences {
+private:
+    // Espace de noms ouvert (vide si aucun)
+    std::string ns;
+    bool readOnly = true;
+    bool opened = false;
+
+public:
+    bool begin(const char* name, bool readOnly = false);
+    void end();
+
+    size_t putBytes(const char* key, const void* value, size_t len);
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+    bool isKey(const char* key);
+    bool remove(const char* key);
+    bool clear();
+};
+
+#endif // HOST_PREFERENCES_H
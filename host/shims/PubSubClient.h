@@ -0,0 +1,58 @@
+// PubSubClient.h (hôte) - Client MQTT relié au broker simulé de HostSim
+#ifndef HOST_PUBSUBCLIENT_H
+#define HOST_PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <functional>
+
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient {
+private:
+    Client* transport;
+    std::string host;
+    uint16_t port = 0;
+    int currentState = MQTT_DISCONNECTED;
+    // Génération de la session côté broker, pour détecter les coupures
+    unsigned long session = 0;
+    uint64_t sessionStartMicros = 0;
+    // Perte de session constatée, en attente de reconnexion (0 : aucune)
+    uint64_t lostAtMicros = 0;
+    std::string clientId;
+    // Taille maximale d'un paquet (en-tête, topic et contenu), 256 par défaut comme PubSubClient
+    uint16_t bufferSize = 256;
+    // Comme PubSubClient : PINGREQ après keepAlive secondes sans paquet émis
+    uint16_t keepAliveSeconds = 15;
+    unsigned long lastOutActivity = 0;
+    MQTT_CALLBACK_SIGNATURE;
+
+    void writePacket(const uint8_t* data, size_t len);
+    void loseSession();
+
+public:
+    explicit PubSubClient(Client& client) : transport(&client) {}
+
+    PubSubClient& setServer(const char* domain, uint16_t port);
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+    bool setBufferSize(uint16_t size) { bufferSize = size; return true; }
+    uint16_t getBufferSize() const { return bufferSize; }
+    PubSubClient& setKeepAlive(uint16_t seconds) { keepAliveSeconds = seconds; return *this; }
+    bool connect(const char* id, const char* user, const char* pass);
+    void disconnect();
+    bool connected();
+    bool publish(const char* topic, const char* payload);
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained = false);
+    bool subscribe(const char* topic);
+    bool loop();
+    int state() const { return currentState; }
+};
+
+#endif // HOST_PUBSUBCLIENT_H
@@ -0,0 +1,53 @@
+// ResumableTlsClient.h (hôte) - Même interface que src/ResumableTlsClient.h, sur la poignée de
+// main simulée de HostSim : le cache de session contient le ticket remis par le broker simulé
+#ifndef HOST_RESUMABLE_TLS_CLIENT_H
+#define HOST_RESUMABLE_TLS_CLIENT_H
+
+#include <WiFiClientSecure.h>
+#include "TlsSession.h"
+#include "Metrics.h"
+
+class ResumableTlsClient : public WiFiClientSecure {
+private:
+    TlsSessionCache* cache = nullptr;
+    HandshakeStats stats = {};
+    unsigned long lastWriteAt = 0;
+
+public:
+    void setSessionCache(TlsSessionCache* sessionCache) { cache = sessionCache; }
+    void setHandshakeTimeout(unsigned long ms) { (void)ms; }
+    void setWriteTimeout(unsigned long ms) { (void)ms; }
+    const HandshakeStats& handshakeStats() const { return stats; }
+    unsigned long lastWriteMs() const { return lastWriteAt; }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        lastWriteAt = millis();
+        return WiFiClientSecure::write(buf, size);
+    }
+
+    // Attente d'un message entrant, livré à la balise DTIM suivante en économie d'énergie
+    bool waitForData(unsigned long timeoutMs) { return hostsim::waitForInbound(timeoutMs); }
+
+    int connect(const char* host, uint16_t port) override {
+        uint32_t ticket = 0;
+        if (cache && cache->matches(host, port) && cache->length == sizeof(ticket)) {
+            memcpy(&ticket, cache->data, sizeof(ticket));
+        }
+
+        unsigned long start = millis();
+        bool resumed = false;
+        uint32_t issued = hostsim::tlsHandshake(ticket, resumed);
+        if (!issued) {
+            stats.failed++;
+            return opened(false);
+        }
+        stats.record(resumed, millis() - start);
+        METRIC_RECORD(METRIC_TLS_HANDSHAKE, (millis() - start) * 1000UL);
+        if (cache) {
+            cache->store(host, port, (const uint8_t*)&issued, sizeof(issued));
+        }
+        return opened(true);
+    }
+};
+
+#endif // HOST_RESUMABLE_TLS_CLIENT_H
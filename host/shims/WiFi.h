@@ -0,0 +1,41 @@
+// WiFi.h (hôte) - Point d'accès simulé : balayage, association et DHCP avec des délais réglables
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+#include <esp_wifi.h>
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+class WiFiClass {
+public:
+    void persistent(bool enabled) { (void)enabled; }
+    // channel et bssid : rejoindre directement ce point d'accès, sans balayer les canaux
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr, int32_t channel = 0,
+                      const uint8_t* bssid = nullptr, bool connect = true);
+    // Adresse statique (pas de DHCP) ; une adresse nulle rétablit le DHCP
+    bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet,
+                IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+    bool disconnect(bool wifiOff = false);
+    wl_status_t status();
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress subnetMask();
+    IPAddress dnsIP(uint8_t dns_no = 0);
+    uint8_t* BSSID();
+    int32_t channel();
+    // Économie d'énergie du modem (WIFI_PS_MIN_MODEM par défaut, comme Arduino-ESP32)
+    bool setSleep(bool enabled);
+    bool setSleep(wifi_ps_type_t sleepType);
+};
+
+extern WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,67 @@
+// WiFiClientSecure.h (hôte) - Client TLS factice : la poignée de main est simulée par HostSim
+// Après la poignée de main, les octets écrits vont au broker simulé, qui lit les paquets MQTT
+// (client MQTT du firmware) et renvoie ses réponses ; ceux du PubSubClient simulé sont ignorés.
+#ifndef HOST_WIFI_CLIENT_SECURE_H
+#define HOST_WIFI_CLIENT_SECURE_H
+
+#include <Arduino.h>
+#include "HostSim.h"
+
+class Client {
+public:
+    virtual ~Client() {}
+    virtual int connect(const char* host, uint16_t port) = 0;
+    // Sans connexion au broker simulé, les paquets ne transitent pas : seule l'activité compte
+    virtual size_t write(const uint8_t* buf, size_t size) { (void)buf; return size; }
+    virtual int available() { return 0; }
+    virtual int read(uint8_t* buf, size_t size) { (void)buf; (void)size; return -1; }
+    virtual int read() {
+        uint8_t b;
+        return read(&b, 1) == 1 ? b : -1;
+    }
+    virtual uint8_t connected() { return 0; }
+    virtual void stop() {}
+};
+
+class WiFiClientSecure : public Client {
+private:
+    const char* caCert = nullptr;
+    size_t connection = 0;   // Connexion au broker simulé (0 : aucune)
+
+protected:
+    // Ouvrir la connexion au broker après une poignée de main réussie
+    int opened(bool handshakeDone) {
+        stop();
+        if (handshakeDone) {
+            connection = hostsim::transportOpen();
+        }
+        return handshakeDone;
+    }
+
+public:
+    void setCACert(const char* rootCA) { caCert = rootCA; }
+    bool hasCACert() const { return caCert != nullptr; }
+
+    // Poignée de main complète à chaque connexion, comme WiFiClientSecure
+    int connect(const char* host, uint16_t port) override {
+        (void)host;
+        (void)port;
+        bool resumed;
+        return opened(hostsim::tlsHandshake(0, resumed) != 0);
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override { return hostsim::transportWrite(connection, buf, size); }
+    int available() override { return hostsim::transportAvailable(connection); }
+    int read(uint8_t* buf, size_t size) override { return hostsim::transportRead(connection, buf, size); }
+    uint8_t connected() override { return hostsim::transportConnected(connection); }
+    void stop() override {
+        if (connection) {
+            hostsim::transportClose(connection);
+            connection = 0;
+        }
+    }
+
+    using Client::read;
+};
+
+#endif // HOST_WIFI_CLIENT_SECURE_H
@@ -0,0 +1,32 @@
+// WiFiUdp.h (hôte) - Datagrammes UDP vers les appareils simulés du réseau local (Broadlink RM)
+#ifndef HOST_WIFIUDP_H
+#define HOST_WIFIUDP_H
+
+#include <Arduino.h>
+#include <vector>
+
+class WiFiUDP {
+private:
+    uint16_t localPort = 0;
+    IPAddress destination;
+    uint16_t destinationPort = 0;
+    std::vector<uint8_t> outgoing;
+    std::vector<uint8_t> incoming;
+    // Réponse de l'appareil, lisible à partir de pendingAt (latence du réseau local)
+    std::vector<uint8_t> pending;
+    uint64_t pendingAt = 0;
+    IPAddress source;
+
+public:
+    uint8_t begin(uint16_t port) { localPort = port; return 1; }
+    void stop() { localPort = 0; }
+    int beginPacket(IPAddress ip, uint16_t port);
+    size_t write(const uint8_t* buffer, size_t size);
+    int endPacket();
+    // Taille du prochain datagramme arrivé (0 : aucun)
+    int parsePacket();
+    int read(uint8_t* buffer, size_t len);
+    IPAddress remoteIP() { return source; }
+};
+
+#endif // HOST_WIFIUDP_H
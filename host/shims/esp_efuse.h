@@ -0,0 +1,26 @@
+// esp_efuse.h (hôte) - eFuses simulés : MAC de base (celle de HostSim) et blocs utilisateur vierges
+#ifndef HOST_ESP_EFUSE_H
+#define HOST_ESP_EFUSE_H
+
+#include <stddef.h>
+#include <esp_wifi.h>
+
+typedef enum {
+    ESP_MAC_WIFI_STA = 0,
+    ESP_MAC_WIFI_SOFTAP = 1,
+} esp_mac_type_t;
+
+typedef enum {
+    EFUSE_BLK0 = 0,
+    EFUSE_BLK1 = 1,
+    EFUSE_BLK2 = 2,
+    EFUSE_BLK3 = 3,
+} esp_efuse_block_t;
+
+// Sur ESP32, déclarée par esp_system.h : lisible avant l'initialisation du Wi-Fi
+esp_err_t esp_read_mac(uint8_t mac[6], esp_mac_type_t type);
+
+// Aucun bloc n'est programmé sur l'hôte : la lecture renvoie des zéros
+esp_err_t esp_efuse_read_block(esp_efuse_block_t blk, void* dst_key, size_t offset_in_bits, size_t size_bits);
+
+#endif // HOST_ESP_EFUSE_H
@@ -0,0 +1,16 @@
+// esp_pm.h (hôte) - Gestion d'énergie simulée : esp_pm_configure() active le sommeil léger
+// automatique, compté par HostSim pendant les attentes bloquées (ResumableTlsClient::waitForData)
+#ifndef HOST_ESP_PM_H
+#define HOST_ESP_PM_H
+
+#include <esp_wifi.h>
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+esp_err_t esp_pm_configure(const void* config);
+
+#endif // HOST_ESP_PM_H
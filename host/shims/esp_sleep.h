@@ -0,0 +1,18 @@
+// esp_sleep.h (hôte) - Sommeil profond simulé : esp_deep_sleep_start() avance l'horloge de la
+// durée programmée puis redémarre la carte (sketch_main rappelle setup())
+#ifndef HOST_ESP_SLEEP_H
+#define HOST_ESP_SLEEP_H
+
+#include <stdint.h>
+#include <esp_wifi.h>
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED = 0,
+    ESP_SLEEP_WAKEUP_TIMER = 4,
+} esp_sleep_wakeup_cause_t;
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+[[noreturn]] void esp_deep_sleep_start();
+
+#endif // HOST_ESP_SLEEP_H
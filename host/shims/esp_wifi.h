@@ -0,0 +1,27 @@
+// esp_wifi.h (hôte) - Adresse MAC simulée, réglable via HostSim
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum {
+    WIFI_IF_STA = 0,
+    WIFI_IF_AP = 1,
+} wifi_interface_t;
+
+// Économie d'énergie du modem : réveil à chaque balise DTIM (MIN, défaut d'Arduino-ESP32)
+// ou toutes les listen_interval balises (MAX, 3 par défaut)
+typedef enum {
+    WIFI_PS_NONE = 0,
+    WIFI_PS_MIN_MODEM = 1,
+    WIFI_PS_MAX_MODEM = 2,
+} wifi_ps_type_t;
+
+esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]);
+
+#endif // HOST_ESP_WIFI_H
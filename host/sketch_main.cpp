@@ -0,0 +1,348 @@
+// sketch_main.cpp - Point d'entrée hôte : exécute setup() puis loop() sur l'horloge virtuelle
+// Les instants (durée, coupures) sont comptés depuis le lancement, sommeils profonds compris.
+//
+// Usage : <programme> [--duration ms] [--nvs fichier] [--quiet]
+//                     [--wifi-outage debut-fin] [--broker-outage debut-fin]
+//                     [--sensor-failure taux] [--handshake ms] [--resumed-handshake ms]
+//                     [--persistent-tickets] [--ap-channel instant:canal] [--realtime]
+//                     [--ping-interval ms] [--dtim ms] [--sensor-trace fichier.csv]
+//                     [--sensor-bias broche:dT:dH] [--room] [--room-remote]
+//                     [--ir-loss taux] [--broadlink-outage debut-fin] [--uart-baud bauds]
+// --ping-interval envoie "device/ping" à intervalles irréguliers autour de cette période et mesure
+// le délai jusqu'au "device/pong" de la carte (latence de réveil pour un message entrant).
+// --sensor-bias décale les valeurs du capteur d'une broche (sondes d'entrée/sortie d'air).
+// --room simule la salle serveur et son climatiseur (Broadlink, prise Shelly) : le capteur lit la
+// température de la salle. --room-remote y ajoute la régulation de regulationtemp.py, alimentée par
+// les températures publiées sur le broker (référence pour un firmware sans OAR_LOCAL_CONTROL).
+// --uart-baud simule le débit du port série (FIFO de 128 octets) : une écriture qui ne tient pas
+// dans la FIFO bloque l'appelant ; le bilan donne alors la durée des itérations de loop().
+// L'adresse MAC simulée se règle avec la variable d'environnement OAR_HOST_MAC.
+#include <Arduino.h>
+#include "HostSim.h"
+#include <algorithm>
+#include <random>
+
+void setup();
+void loop();
+
+namespace {
+
+struct Outage {
+    unsigned long start;
+    unsigned long end;
+};
+
+bool parseOutage(const char* text, Outage& outage) {
+    return sscanf(text, "%lu-%lu", &outage.start, &outage.end) == 2 && outage.start < outage.end;
+}
+
+struct ChannelChange {
+    unsigned long at;
+    unsigned int channel;
+};
+
+unsigned long elapsedMs() {
+    return (unsigned long)(hostsim::nowMicros() / 1000);
+}
+
+bool inOutage(const std::vector<Outage>& outages, unsigned long now) {
+    for (const auto& outage : outages) {
+        if (now >= outage.start && now < outage.end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Régulation côté serveur, comme regulationtemp.py : consommation relevée toutes les secondes,
+// hystérésis appliquée à chaque température reçue du broker
+struct RemoteControl {
+    size_t nextMessage;
+    uint64_t nextPollAt;
+    float consumption;
+};
+
+void remoteControlStep(RemoteControl& remote, const hostsim::RoomModel& room) {
+    uint64_t now = hostsim::nowMicros();
+    if (now >= remote.nextPollAt) {
+        remote.consumption = hostsim::acPower();
+        remote.nextPollAt = now + 1000000;
+    }
+    const std::vector<hostsim::Message>& messages = hostsim::publishedMessages();
+    for (; remote.nextMessage < messages.size(); remote.nextMessage++) {
+        const hostsim::Message& message = messages[remote.nextMessage];
+        if (message.deliveredMicros > now) {
+            break;
+        }
+        if (message.topic != "sensors/temperature") {
+            continue;
+        }
+        std::string text(message.payload.begin(), message.payload.end());
+        float temperature = strtof(text.c_str(), nullptr);
+        const float CONSUMPTION_THRESHOLD = 5.0f;
+        if ((temperature > room.upperC && remote.consumption < CONSUMPTION_THRESHOLD) ||
+            (temperature < room.lowerC && remote.consumption >= CONSUMPTION_THRESHOLD)) {
+            hostsim::sendIrCommand();
+        }
+    }
+}
+
+double percentile(std::vector<uint64_t> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))] / 1e6;
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "Usage : %s [--duration ms] [--nvs fichier] [--quiet]\n"
+            "          [--wifi-outage debut-fin] [--broker-outage debut-fin]\n"
+            "          [--sensor-failure taux] [--handshake ms] [--resumed-handshake ms]\n"
+            "          [--persistent-tickets] [--ap-channel instant:canal] [--realtime]\n"
+            "          [--ping-interval ms] [--dtim ms] [--sensor-trace fichier.csv]\n"
+            "          [--sensor-bias broche:dT:dH] [--room] [--room-remote]\n"
+            "          [--ir-loss taux] [--broadlink-outage debut-fin] [--uart-baud bauds]\n"
+            "          [--link-latency ms] [--tls-write us:us_par_ko]\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned long duration = 60000;
+    std::vector<Outage> wifiOutages;
+    std::vector<Outage> brokerOutages;
+    std::vector<ChannelChange> channelChanges;
+    std::vector<Outage> broadlinkOutages;
+    unsigned long pingInterval = 0;
+    bool room = false;
+    bool roomRemote = false;
+    unsigned long uartBaud = 0;
+    unsigned long recordMicros;
+    unsigned long perKiloByteMicros;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        Outage outage;
+        ChannelChange change;
+        unsigned pin;
+        float dt;
+        float dh;
+
+        if (strcmp(arg, "--quiet") == 0) {
+            hostsim::setSerialQuiet(true);
+            continue;
+        }
+        if (strcmp(arg, "--realtime") == 0) {
+            hostsim::setRealTime(true);
+            continue;
+        }
+        if (strcmp(arg, "--persistent-tickets") == 0) {
+            hostsim::setTicketKeyPersistent(true);
+            continue;
+        }
+        if (strcmp(arg, "--room") == 0 || strcmp(arg, "--room-remote") == 0) {
+            room = true;
+            roomRemote = roomRemote || strcmp(arg, "--room-remote") == 0;
+            continue;
+        }
+        if (!value) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(arg, "--duration") == 0) {
+            duration = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--nvs") == 0) {
+            hostsim::setNvsFile(value);
+        } else if (strcmp(arg, "--wifi-outage") == 0 && parseOutage(value, outage)) {
+            wifiOutages.push_back(outage);
+        } else if (strcmp(arg, "--broker-outage") == 0 && parseOutage(value, outage)) {
+            brokerOutages.push_back(outage);
+        } else if (strcmp(arg, "--ap-channel") == 0 &&
+                   sscanf(value, "%lu:%u", &change.at, &change.channel) == 2) {
+            channelChanges.push_back(change);
+        } else if (strcmp(arg, "--sensor-trace") == 0) {
+            std::vector<hostsim::TraceSample> trace;
+            if (!hostsim::loadSensorTrace(value, trace)) {
+                fprintf(stderr, "Trace illisible : %s\n", value);
+                return 2;
+            }
+            hostsim::setSensorTrace(trace);
+        } else if (strcmp(arg, "--sensor-bias") == 0 && sscanf(value, "%u:%f:%f", &pin, &dt, &dh) == 3) {
+            hostsim::setSensorBias(pin, dt, dh);
+        } else if (strcmp(arg, "--sensor-failure") == 0) {
+            hostsim::setSensorFailureRate(atof(value));
+        } else if (strcmp(arg, "--handshake") == 0) {
+            hostsim::setHandshakeDelay(strtoul(value, nullptr, 10));
+        } else if (strcmp(arg, "--ping-interval") == 0) {
+            pingInterval = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--dtim") == 0) {
+            hostsim::setDtimPeriod(strtoul(value, nullptr, 10));
+        } else if (strcmp(arg, "--resumed-handshake") == 0) {
+            hostsim::setResumedHandshakeDelay(strtoul(value, nullptr, 10));
+        } else if (strcmp(arg, "--ir-loss") == 0) {
+            hostsim::setIrLossRate(atof(value));
+        } else if (strcmp(arg, "--broadlink-outage") == 0 && parseOutage(value, outage)) {
+            broadlinkOutages.push_back(outage);
+        } else if (strcmp(arg, "--uart-baud") == 0 && (uartBaud = strtoul(value, nullptr, 10)) > 0) {
+            hostsim::setSerialBaud(uartBaud);
+        } else if (strcmp(arg, "--link-latency") == 0) {
+            hostsim::setLinkLatency(strtoul(value, nullptr, 10) * 1000);
+        } else if (strcmp(arg, "--tls-write") == 0 &&
+                   sscanf(value, "%lu:%lu", &recordMicros, &perKiloByteMicros) == 2) {
+            hostsim::setTlsWriteCost(recordMicros, perKiloByteMicros);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    // Pings programmés d'avance, à un instant tiré au hasard dans chaque période
+    std::vector<uint64_t> pings;
+    std::mt19937 pingRng(3);
+    for (unsigned long start = pingInterval; pingInterval && start < duration; start += pingInterval) {
+        uint64_t at = (uint64_t)(start + pingRng() % pingInterval) * 1000;
+        char payload[16];
+        int len = snprintf(payload, sizeof(payload), "%lu", (unsigned long)pings.size());
+        hostsim::injectMessageAt("device/ping", (const uint8_t*)payload, len, at);
+        pings.push_back(at);
+    }
+
+    hostsim::RoomModel roomModel = hostsim::defaultRoom();
+    if (room) {
+        hostsim::setRoom(roomModel);
+    }
+    RemoteControl remote = {0, 0, 0.0f};
+
+    unsigned long loops = 0;
+    std::vector<uint64_t> loopMicros;
+    unsigned long blockedLoops = 0;
+    uint64_t maxBlockedMicros = 0;
+    bool booting = true;
+    while (elapsedMs() < duration) {
+        unsigned long now = elapsedMs();
+        hostsim::setAccessPointUp(!inOutage(wifiOutages, now));
+        hostsim::setBrokerUp(!inOutage(brokerOutages, now));
+        hostsim::setBroadlinkUp(!inOutage(broadlinkOutages, now));
+        for (size_t c = 0; c < channelChanges.size(); c++) {
+            if (now >= channelChanges[c].at) {
+                hostsim::setAccessPointChannel(channelChanges[c].channel);
+                channelChanges.erase(channelChanges.begin() + c--);
+            }
+        }
+
+        uint64_t before = hostsim::nowMicros();
+        try {
+            if (booting) {
+                booting = false;
+                setup();
+            } else {
+                uint64_t blockedBefore = hostsim::serialStats().blockedMicros;
+                loop();
+                loops++;
+                if (uartBaud) {
+                    loopMicros.push_back(hostsim::nowMicros() - before);
+                    uint64_t blocked = hostsim::serialStats().blockedMicros - blockedBefore;
+                    blockedLoops += blocked > 0;
+                    maxBlockedMicros = std::max(maxBlockedMicros, blocked);
+                }
+            }
+        } catch (const hostsim::DeepSleep&) {
+            // Réveil du sommeil profond : la carte redémarre dans setup()
+            booting = true;
+            continue;
+        }
+        if (roomRemote) {
+            remoteControlStep(remote, roomModel);
+        }
+        // Une itération qui ne consomme pas de temps avance l'horloge d'une milliseconde
+        if (!hostsim::realTime() && hostsim::nowMicros() == before) {
+            hostsim::advance(1);
+        }
+    }
+
+    const hostsim::NvsStats& nvs = hostsim::nvsStats();
+    const hostsim::WifiStats& wifi = hostsim::wifiStats();
+    const hostsim::BrokerStats& broker = hostsim::brokerStats();
+    const hostsim::TlsStats& tls = hostsim::tlsStats();
+    const hostsim::SleepStats& sleep = hostsim::sleepStats();
+    const hostsim::SensorStats& sensors = hostsim::sensorStats();
+    fprintf(stderr, "\n=== Bilan de la simulation (%lu ms, %lu itérations de loop) ===\n", elapsedMs(), loops);
+    fprintf(stderr, "NVS     : %lu ouvertures, %lu lectures, %lu écritures (%lu octets)\n",
+            nvs.opens, nvs.reads, nvs.writes, nvs.bytesWritten);
+    fprintf(stderr, "Wi-Fi   : %lu WiFi.begin(), %lu associations (%lu ms en moyenne), %lu balayages, %lu DHCP\n",
+            wifi.begins, wifi.associations,
+            wifi.associations ? (unsigned long)(wifi.connectMicros / 1000 / wifi.associations) : 0UL,
+            wifi.scans, wifi.dhcp);
+    fprintf(stderr, "Broker  : %lu connexions, %lu refus, %lu messages publiés, %lu PINGREQ, %lu sessions expirées\n",
+            broker.connects, broker.refused, broker.published, broker.pings, broker.expired);
+    if (broker.qos1) {
+        fprintf(stderr, "MQTT    : %lu messages QoS 1 reçus par le broker, dont %lu renvois après une perte de session\n",
+                broker.qos1, broker.duplicates);
+    }
+    if (sensors.pins > 1) {
+        fprintf(stderr, "Capteurs: %lu lectures sur %lu broches, %.1f ms au minimum entre deux sondes\n",
+                sensors.reads, sensors.pins, sensors.minSpacingMicros / 1000.0);
+    }
+    for (const auto& message : hostsim::publishedMessages()) {
+        if (message.topic.compare(0, 8, "sensors/") == 0) {
+            fprintf(stderr, "Mesures : première publication %lu ms après le démarrage\n",
+                    (unsigned long)(message.timeMicros / 1000));
+            break;
+        }
+    }
+    if (!pings.empty()) {
+        unsigned long answered = 0;
+        uint64_t totalMicros = 0;
+        uint64_t maxMicros = 0;
+        for (const auto& message : hostsim::publishedMessages()) {
+            unsigned long index;
+            std::string payload(message.payload.begin(), message.payload.end());
+            if (message.topic == "device/pong" && sscanf(payload.c_str(), "%lu", &index) == 1 &&
+                index < pings.size()) {
+                uint64_t latency = message.timeMicros - pings[index];
+                answered++;
+                totalMicros += latency;
+                maxMicros = std::max(maxMicros, latency);
+            }
+        }
+        fprintf(stderr, "Pings   : %lu/%lu réponses, latence moyenne %.1f ms, maximale %.1f ms\n",
+                answered, (unsigned long)pings.size(),
+                answered ? totalMicros / 1000.0 / answered : 0.0, maxMicros / 1000.0);
+    }
+    if (sleep.lightSleptMicros) {
+        fprintf(stderr, "Sommeil : CPU en sommeil léger %.1f %% du temps\n",
+                100.0 * sleep.lightSleptMicros / hostsim::nowMicros());
+    }
+    if (sleep.wakeups) {
+        fprintf(stderr, "Sommeil : %lu réveils, éveillé %.1f %% du temps\n", sleep.wakeups,
+                100.0 * (hostsim::nowMicros() - sleep.sleptMicros) / hostsim::nowMicros());
+    }
+    if (uartBaud) {
+        const hostsim::SerialStats& serial = hostsim::serialStats();
+        fprintf(stderr, "Série   : %lu octets à %lu bauds, appelant bloqué %.1f ms au total\n",
+                serial.bytes, uartBaud, serial.blockedMicros / 1000.0);
+        fprintf(stderr, "Loop    : p50 %.3f ms, p99 %.3f ms, max %.3f ms ; %lu itérations retardées par le port série "
+                "(jusqu'à %.3f ms)\n", percentile(loopMicros, 0.5) * 1000, percentile(loopMicros, 0.99) * 1000,
+                percentile(loopMicros, 1.0) * 1000, blockedLoops, maxBlockedMicros / 1000.0);
+    }
+    fprintf(stderr, "TLS     : %lu poignées de main complètes, %lu sessions reprises\n", tls.full, tls.resumed);
+    if (room) {
+        const hostsim::ClimateStats& climate = hostsim::climateStats();
+        fprintf(stderr, "Salle   : %.2f à %.2f °C, %.1f %% du temps au-dessus de %.1f °C, compresseur %.1f %% du temps\n",
+                climate.minC, climate.maxC, 100.0 * climate.aboveUpperMicros / hostsim::nowMicros(), roomModel.upperC,
+                100.0 * climate.compressorMicros / hostsim::nowMicros());
+        fprintf(stderr, "Clim    : %lu commandes IR (%lu perdues), %lu changements d'état, %lu lectures de la prise, "
+                "%lu sessions Broadlink, %lu paquets refusés\n",
+                climate.irCommands, climate.irLost, climate.toggles, climate.powerReads, climate.authentications,
+                climate.rejected);
+        fprintf(stderr, "Réaction: %lu franchissements de seuil, p50 %.1f s, p90 %.1f s, max %.1f s\n",
+                (unsigned long)climate.reactions.size(), percentile(climate.reactions, 0.5),
+                percentile(climate.reactions, 0.9), percentile(climate.reactions, 1.0));
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+// alloc_check.cpp - Vérifie que les chemins store*/retrieve* de SecureStorage et l'encodage
+// des mesures n'allouent pas sur le tas
+//
+// Usage : oar_alloc_check   (code de sortie 1 si un appel alloue)
+#include <Arduino.h>
+#include "HostSim.h"
+#include "SecureStorage.h"
+#include "TelemetryEncoder.h"
+
+namespace {
+
+int failures = 0;
+
+// Exécuter un appel et compter les allocations qu'il a provoquées
+template <typename Call>
+void check(const char* label, Call call) {
+    unsigned long before = hostsim::allocationCount();
+    bool ok = call();
+    unsigned long allocated = hostsim::allocationCount() - before;
+    printf("%-34s %-5s %lu allocation(s)\n", label, ok ? "ok" : "ECHEC", allocated);
+    if (!ok || allocated != 0) {
+        failures++;
+    }
+}
+
+} // namespace
+
+int main() {
+    SecureStorage storage;
+    char value[64];
+    int number = 0;
+
+    DeviceConfig config = {};
+    snprintf(config.wifi_ssid, sizeof(config.wifi_ssid), "%s", "tp link oar");
+    snprintf(config.wifi_pass, sizeof(config.wifi_pass), "%s", "cielnewton");
+    snprintf(config.mqtt_server, sizeof(config.mqtt_server), "%s", "10.0.20.2");
+    config.mqtt_port = 8883;
+    snprintf(config.mqtt_user, sizeof(config.mqtt_user), "%s", "userclient");
+    snprintf(config.mqtt_pass, sizeof(config.mqtt_pass), "%s", "ciel");
+
+    // Premier appel : expansion de la clé AES (allocation unique du contexte mbedTLS)
+    storage.storeSecret("warmup", "x");
+
+    check("storeSecret", [&] { return storage.storeSecret("wifi_pass", "cielnewton"); });
+    check("storeInt", [&] { return storage.storeInt("mqtt_port", 8883); });
+    check("retrieveSecret", [&] { return storage.retrieveSecret("wifi_pass", value, sizeof(value)); });
+    check("retrieveInt", [&] { return storage.retrieveInt("mqtt_port", &number) && number == 8883; });
+    check("retrieveSecret (clé absente)", [&] { return !storage.retrieveSecret("absent", value, sizeof(value)); });
+    check("retrieveSecret (buffer trop petit)", [&] { return !storage.retrieveSecret("wifi_pass", value, 4); });
+    check("storeConfig", [&] { return storage.storeConfig(config); });
+    check("loadConfig", [&] { DeviceConfig loaded; return storage.loadConfig(loaded); });
+
+    Reading reading = {3600000, 360, 21.3f, 45.6f, 0};
+    Reading probe = {3600000, 361, 24.8f, 38.2f, 3};
+    uint8_t payload[TELEMETRY_MAX_SIZE];
+    check("encodeTextValue", [&] { return encodeTextValue(reading.temperature, value, sizeof(value)) == 5; });
+    check("encodePacked", [&] { return encodePacked(reading, payload, sizeof(payload)) == TELEMETRY_PACKED_SIZE; });
+    check("encodeCbor", [&] { return encodeCbor(reading, payload, sizeof(payload)) != 0; });
+    check("encodePacked (sonde 3)", [&] { return encodePacked(probe, payload, sizeof(payload)) == TELEMETRY_PACKED_PROBE_SIZE; });
+    check("encodeCbor (sonde 3)", [&] { return encodeCbor(probe, payload, sizeof(payload)) != 0; });
+
+    if (failures) {
+        printf("%d appel(s) en échec ou avec allocation\n", failures);
+        return 1;
+    }
+    printf("Aucune allocation sur le tas\n");
+    return 0;
+}
@@ -0,0 +1,95 @@
+// batch_check.cpp - Vérifie que storeBatch est tout ou rien : une écriture NVS en échec au milieu
+// du lot rétablit les identifiants existants et supprime les clés nouvelles
+//
+// Usage : oar_batch_check   (code de sortie 1 si un cas échoue)
+#include <Arduino.h>
+#include "HostSim.h"
+#include "SecureStorage.h"
+
+namespace {
+
+int failures = 0;
+
+void report(const char* label, bool ok) {
+    printf("%-44s %s\n", label, ok ? "ok" : "ECHEC");
+    if (!ok) {
+        failures++;
+    }
+}
+
+bool hasSecret(SecureStorage& storage, const char* key, const char* expected) {
+    char value[64];
+    return storage.retrieveSecret(key, value, sizeof(value)) && strcmp(value, expected) == 0;
+}
+
+// Identifiants en place avant chaque cas
+bool storeInitial(SecureStorage& storage) {
+    storage.clearAllSecrets();
+    const SecretValue values[] = {
+        {"wifi_ssid", "ancien ssid", 0},
+        {"wifi_pass", "ancien pass", 0},
+        {"mqtt_port", nullptr, 8883},
+    };
+    return storage.storeBatch(values, sizeof(values) / sizeof(values[0]));
+}
+
+bool initialKept(SecureStorage& storage) {
+    int port = 0;
+    return hasSecret(storage, "wifi_ssid", "ancien ssid") && hasSecret(storage, "wifi_pass", "ancien pass") &&
+           storage.retrieveInt("mqtt_port", &port) && port == 8883 && !storage.secretExists("mqtt_user");
+}
+
+const SecretValue update[] = {
+    {"wifi_ssid", "nouveau ssid", 0},
+    {"wifi_pass", "nouveau pass", 0},
+    {"mqtt_port", nullptr, 1883},
+    {"mqtt_user", "nouvel utilisateur", 0},
+};
+const size_t UPDATE_COUNT = sizeof(update) / sizeof(update[0]);
+
+} // namespace
+
+int main() {
+    hostsim::setSerialQuiet(true);
+    SecureStorage storage;
+
+    // Échec à chaque position du lot : ni valeur du nouveau lot, ni identifiant perdu
+    for (long failAt = 0; failAt < (long)UPDATE_COUNT; failAt++) {
+        bool ready = storeInitial(storage);
+        hostsim::failNvsWriteAfter(failAt);
+        bool refused = !storage.storeBatch(update, UPDATE_COUNT);
+        hostsim::failNvsWriteAfter(-1);
+        char label[64];
+        snprintf(label, sizeof(label), "échec de l'écriture %ld sur %lu", failAt + 1, (unsigned long)UPDATE_COUNT);
+        report(label, ready && refused && initialKept(storage));
+    }
+
+    // Valeur trop longue : refusée avant la première écriture
+    char tooLong[200];
+    memset(tooLong, 'x', sizeof(tooLong) - 1);
+    tooLong[sizeof(tooLong) - 1] = '\0';
+    const SecretValue oversized[] = {
+        {"wifi_ssid", "nouveau ssid", 0},
+        {"wifi_pass", tooLong, 0},
+    };
+    bool ready = storeInitial(storage);
+    unsigned long writes = hostsim::nvsStats().writes;
+    bool refused = !storage.storeBatch(oversized, sizeof(oversized) / sizeof(oversized[0]));
+    report("valeur trop longue, aucune écriture", ready && refused && hostsim::nvsStats().writes == writes &&
+                                                      initialKept(storage));
+
+    // Lot complet
+    int port = 0;
+    ready = storeInitial(storage);
+    report("lot écrit en entier", ready && storage.storeBatch(update, UPDATE_COUNT) &&
+                                      hasSecret(storage, "wifi_ssid", "nouveau ssid") &&
+                                      hasSecret(storage, "mqtt_user", "nouvel utilisateur") &&
+                                      storage.retrieveInt("mqtt_port", &port) && port == 1883);
+
+    if (failures) {
+        printf("%d cas en échec\n", failures);
+        return 1;
+    }
+    printf("storeBatch tout ou rien vérifié\n");
+    return 0;
+}
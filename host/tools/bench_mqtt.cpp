@@ -0,0 +1,220 @@
+// bench_mqtt.cpp - Débit et latence de la publication MQTT, synchrone (PubSubClient, QoS 0) ou par
+// la file de QueuedMqttClient (QoS 1, fenêtre de 1 à 8 messages en vol), contre le broker simulé
+// Une rafale de messages est déposée aussi vite que le client l'accepte (ou un message toutes les
+// --interval ms, pour la latence à charge modérée) ; le banc mesure le débit
+// jusqu'au dernier message reçu (et acquitté en QoS 1), le délai appel -> broker, le délai
+// dépôt -> PUBACK et le temps passé par l'appelant dans publish() et loop().
+//
+// Usage : oar_bench_mqtt [--messages N] [--payload octets] [--interval ms] [--tls-write us:us_par_ko]
+//                        [--latency ms]...   (défaut : 5, 25 et 100 ms aller simple)
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <PubSubClient.h>
+#include "HostSim.h"
+#include "MqttClient.h"
+#include "QueuedMqttClient.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const size_t OUTBOX_BYTES = 4096;
+const size_t OUTBOX_SLOTS = 32;
+typedef MqttOutbox<OUTBOX_BYTES, OUTBOX_SLOTS> BenchOutbox;
+BenchOutbox outbox;
+unsigned long intervalMs = 0;
+
+struct Result {
+    double messagesPerSecond;
+    double brokerMeanMs;        // Appel publish() -> réception par le broker
+    double brokerMaxMs;
+    double ackMeanMs;           // Dépôt -> PUBACK (QoS 1)
+    double ackMaxMs;
+    double publishMeanMicros;   // Durée d'un appel publish()
+    double loopMaxMs;           // Appel loop() le plus long
+};
+
+unsigned long benchClock() { return millis(); }
+
+// Publier messages messages sur le client connecté ; false si tous ne sont pas arrivés à temps
+bool run(MqttClient& client, size_t messages, size_t payloadLength, Result& result) {
+    std::vector<uint64_t> calledAt;
+    std::vector<uint8_t> payload(payloadLength, 'x');
+    size_t logStart = hostsim::publishedMessages().size();
+    uint64_t publishMicros = 0;
+    uint64_t loopMaxMicros = 0;
+    uint64_t start = hostsim::nowMicros();
+    uint64_t deadline = start + 600000000ULL;
+
+    while ((calledAt.size() < messages || !client.idle()) && hostsim::nowMicros() < deadline) {
+        // Déposer tant que le client accepte (à l'échéance de chaque message avec --interval)
+        while (calledAt.size() < messages &&
+               hostsim::nowMicros() >= start + (uint64_t)calledAt.size() * intervalMs * 1000) {
+            snprintf((char*)payload.data(), payloadLength, "%lu;", (unsigned long)calledAt.size());
+            uint64_t before = hostsim::nowMicros();
+            if (!client.publish("bench/mqtt", payload.data(), payloadLength, 1)) {
+                break;
+            }
+            publishMicros += hostsim::nowMicros() - before;
+            calledAt.push_back(before);
+        }
+        uint64_t before = hostsim::nowMicros();
+        if (!client.loop()) {
+            return false;
+        }
+        loopMaxMicros = std::max(loopMaxMicros, hostsim::nowMicros() - before);
+        if (calledAt.size() == messages && client.idle()) {
+            break;
+        }
+        hostsim::waitForInbound(1);
+    }
+    if (calledAt.size() < messages || !client.idle()) {
+        return false;
+    }
+
+    // Délais jusqu'au broker, d'après le numéro en tête de chaque message
+    const std::vector<hostsim::Message>& log = hostsim::publishedMessages();
+    uint64_t totalMicros = 0;
+    uint64_t maxMicros = 0;
+    uint64_t lastMicros = start;
+    size_t received = 0;
+    for (size_t i = logStart; i < log.size(); i++) {
+        unsigned long index;
+        std::string text(log[i].payload.begin(), log[i].payload.end());
+        if (log[i].topic != "bench/mqtt" || sscanf(text.c_str(), "%lu;", &index) != 1 || index >= messages) {
+            continue;
+        }
+        uint64_t latency = log[i].deliveredMicros - calledAt[index];
+        totalMicros += latency;
+        maxMicros = std::max(maxMicros, latency);
+        lastMicros = std::max(lastMicros, log[i].deliveredMicros);
+        received++;
+    }
+    // En QoS 1, le dernier PUBACK termine la rafale
+    lastMicros = std::max(lastMicros, hostsim::nowMicros());
+    result.messagesPerSecond = received * 1e6 / std::max<uint64_t>(1, lastMicros - start);
+    result.brokerMeanMs = received ? totalMicros / 1000.0 / received : 0;
+    result.brokerMaxMs = maxMicros / 1000.0;
+    result.publishMeanMicros = (double)publishMicros / messages;
+    result.loopMaxMs = loopMaxMicros / 1000.0;
+    return received == messages;
+}
+
+void print(const char* label, const Result& result, bool acked) {
+    if (acked) {
+        printf("  %-22s %8.1f msg/s  broker %7.1f ms (max %7.1f)  PUBACK %7.1f ms (max %7.1f)  "
+               "publish %7.1f µs  loop max %6.1f ms\n",
+               label, result.messagesPerSecond, result.brokerMeanMs, result.brokerMaxMs, result.ackMeanMs,
+               result.ackMaxMs, result.publishMeanMicros, result.loopMaxMs);
+    } else {
+        printf("  %-22s %8.1f msg/s  broker %7.1f ms (max %7.1f)  PUBACK       -               "
+               "publish %7.1f µs  loop max %6.1f ms\n",
+               label, result.messagesPerSecond, result.brokerMeanMs, result.brokerMaxMs,
+               result.publishMeanMicros, result.loopMaxMs);
+    }
+}
+
+bool benchSync(size_t messages, size_t payloadLength, Result& result) {
+    WiFiClientSecure transport;
+    PubSubClient pubSub(transport);
+    PubSubMqttClient client(pubSub);
+    pubSub.setBufferSize(1024);
+    client.setServer("broker", 8883);
+    if (!client.connect("bench", nullptr, nullptr)) {
+        return false;
+    }
+    bool ok = run(client, messages, payloadLength, result);
+    client.disconnect();
+    return ok;
+}
+
+bool benchQueued(uint8_t window, size_t messages, size_t payloadLength, Result& result) {
+    WiFiClientSecure transport;
+    const QueuedMqttConfig config = {window, 60000, 1024, 15000};
+    outbox = BenchOutbox();
+    QueuedMqttClient<OUTBOX_BYTES, OUTBOX_SLOTS, 1024> client(transport, outbox, config, benchClock);
+    client.setServer("broker", 8883);
+    if (!client.connect("bench", nullptr, nullptr)) {
+        return false;
+    }
+    outbox.stats = MqttOutboxStats();
+    bool ok = run(client, messages, payloadLength, result);
+    const MqttOutboxStats& stats = client.stats();
+    result.ackMeanMs = stats.acked ? (double)stats.ackTotalMs / stats.acked : 0;
+    result.ackMaxMs = stats.ackMaxMs;
+    client.disconnect();
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t messages = 200;
+    size_t payloadLength = 64;
+    unsigned long recordMicros = 1200;     // Chiffrement AES-GCM et remise à lwIP d'un petit enregistrement
+    unsigned long perKiloByteMicros = 400;
+    std::vector<unsigned long> latencies;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--messages") == 0) {
+            messages = strtoul(argv[i + 1], nullptr, 10);
+        } else if (strcmp(argv[i], "--payload") == 0) {
+            payloadLength = std::max<size_t>(8, strtoul(argv[i + 1], nullptr, 10));
+        } else if (strcmp(argv[i], "--interval") == 0) {
+            intervalMs = strtoul(argv[i + 1], nullptr, 10);
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            latencies.push_back(strtoul(argv[i + 1], nullptr, 10));
+        } else if (strcmp(argv[i], "--tls-write") != 0 ||
+                   sscanf(argv[i + 1], "%lu:%lu", &recordMicros, &perKiloByteMicros) != 2) {
+            fprintf(stderr,
+                    "Usage : %s [--messages N] [--payload octets] [--interval ms] [--tls-write us:us_par_ko] "
+                    "[--latency ms]...\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (latencies.empty()) {
+        latencies = {5, 25, 100};
+    }
+
+    hostsim::setSerialQuiet(true);
+    hostsim::setTlsWriteCost(recordMicros, perKiloByteMicros);
+    WiFi.setSleep(false);
+    WiFi.begin("bench", "bench");
+    while (WiFi.status() != WL_CONNECTED) {
+        delay(10);
+    }
+
+    char pace[48] = "en rafale";
+    if (intervalMs) {
+        snprintf(pace, sizeof(pace), "un toutes les %lu ms", intervalMs);
+    }
+    printf("%lu messages de %lu octets %s, écriture TLS %lu µs + %lu µs/Ko\n", (unsigned long)messages,
+           (unsigned long)payloadLength, pace, recordMicros, perKiloByteMicros);
+    int failures = 0;
+    for (unsigned long latency : latencies) {
+        hostsim::setLinkLatency(latency * 1000);
+        printf("Latence du lien : %lu ms aller simple\n", latency);
+        Result result = {};
+        if (benchSync(messages, payloadLength, result)) {
+            print("PubSubClient QoS 0", result, false);
+        } else {
+            printf("  PubSubClient QoS 0     ECHEC\n");
+            failures++;
+        }
+        for (uint8_t window : {1, 2, 4, 8}) {
+            char label[32];
+            snprintf(label, sizeof(label), "file QoS 1, fenêtre %u", (unsigned)window);
+            result = Result();
+            if (benchQueued(window, messages, payloadLength, result)) {
+                print(label, result, true);
+            } else {
+                printf("  %-22s ECHEC\n", label);
+                failures++;
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
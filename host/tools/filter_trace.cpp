@@ -0,0 +1,84 @@
+// filter_trace.cpp - Rejoue des traces DHT22 enregistrées dans le filtre des mesures du firmware
+// Compare lectures brutes et filtrées : lectures écartées, écart maximal, et nombre de passages
+// au-dessus de 22 °C ou sous 20 °C, chacun déclenchant une commande IR dans regulationtemp.py.
+//
+// Usage : oar_filter_trace trace.csv [...]   (code de sortie 1 si le filtre ajoute des passages)
+#include <Arduino.h>
+#include "HostSim.h"
+#include "SensorFilter.h"
+
+namespace {
+
+const float TEMP_UPPER_THRESHOLD = 22.0f;
+const float TEMP_LOWER_THRESHOLD = 20.0f;
+
+// Compte les entrées dans les zones "trop chaud" et "trop froid" de la régulation
+struct CrossingCounter {
+    int zone = 0;        // 1 : au-dessus du seuil haut, -1 : sous le seuil bas, 0 : entre les deux
+    bool primed = false;
+    unsigned long commands = 0;
+
+    void add(float temperature) {
+        int next = temperature > TEMP_UPPER_THRESHOLD ? 1 : temperature < TEMP_LOWER_THRESHOLD ? -1 : 0;
+        if (primed && next != 0 && next != zone) {
+            commands++;
+        }
+        zone = next;
+        primed = true;
+    }
+};
+
+// Le firmware écarte les lectures en échec ou hors de la plage du DHT22 avant le filtre
+bool valid(const hostsim::TraceSample& sample) {
+    return !isnan(sample.temperature) && !isnan(sample.humidity) &&
+           sample.temperature >= -40 && sample.temperature <= 80 &&
+           sample.humidity >= 0 && sample.humidity <= 100;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage : %s trace.csv [...]\n", argv[0]);
+        return 2;
+    }
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++) {
+        std::vector<hostsim::TraceSample> trace;
+        if (!hostsim::loadSensorTrace(argv[i], trace)) {
+            fprintf(stderr, "Trace illisible : %s\n", argv[i]);
+            return 2;
+        }
+
+        MedianEmaFilter<5, 2> temperatureFilter = {};
+        MedianEmaFilter<5, 2> humidityFilter = {};
+        CrossingCounter raw;
+        CrossingCounter filtered;
+        unsigned long rejected = 0;
+        float maxTemperatureGap = 0;
+        float maxHumidityGap = 0;
+
+        for (const auto& sample : trace) {
+            if (!valid(sample)) {
+                rejected++;
+                continue;
+            }
+            float temperature = temperatureFilter.update(sample.temperature);
+            float humidity = humidityFilter.update(sample.humidity);
+            raw.add(sample.temperature);
+            filtered.add(temperature);
+            maxTemperatureGap = std::max(maxTemperatureGap, fabsf(temperature - sample.temperature));
+            maxHumidityGap = std::max(maxHumidityGap, fabsf(humidity - sample.humidity));
+        }
+
+        printf("%s\n", argv[i]);
+        printf("  lectures            %lu (%lu écartées avant filtrage)\n", (unsigned long)trace.size(), rejected);
+        printf("  écart brut/filtré   %.2f °C, %.2f %% au maximum\n", maxTemperatureGap, maxHumidityGap);
+        printf("  commandes IR        %lu brutes, %lu filtrées\n", raw.commands, filtered.commands);
+        if (filtered.commands > raw.commands) {
+            failures++;
+        }
+    }
+    return failures ? 1 : 0;
+}
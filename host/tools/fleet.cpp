@@ -0,0 +1,411 @@
+// fleet.cpp - Générateur de charge : N cartes simulées exécutent le firmware contre le broker simulé
+// Le firmware (main.cpp) est compilé en module chargeable ; chaque carte charge sa propre copie
+// du module, donc ses propres variables globales (client MQTT, réserve, filtres...), et reçoit
+// sa MAC, sa NVS provisionnée et son horloge (voir hostsim::selectDevice). La carte exécutée est
+// toujours celle dont l'horloge est la plus en retard : une poignée de main TLS bloquante n'arrête
+// pas les autres, et le broker voit les demandes dans l'ordre où elles lui parviennent.
+//
+// Usage : oar_fleet [--devices N] [--duration ms] [--module nom|fichier.so]... [--boot-spread ms]
+//                   [--broker-outage debut-fin]... [--outage-every periode:duree]
+//                   [--broker-cost publication:complete:reprise] [--sensor-noise ecart]
+//                   [--handshake ms] [--resumed-handshake ms] [--tick ms]
+// Modules construits avec l'outil : text (défaut), packed, cbor, packed_2s (mesure toutes les 2 s).
+// Plusieurs --module : les cartes sont réparties entre les modules à tour de rôle.
+// --sensor-noise ajoute un bruit gaussien aux lectures : au-delà de la bande morte, chaque
+// mesure est publiée (sinon le capteur simulé varie trop lentement et seul le battement passe).
+#include <Arduino.h>
+#include "HostSim.h"
+#include "SecureStorage.h"
+#include "TelemetryEncoder.h"
+
+#include <dlfcn.h>
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+
+namespace {
+
+typedef void (*SketchFunction)();
+
+struct Device {
+    SketchFunction setup;
+    SketchFunction loop;
+    uint64_t bootAt;          // Mise sous tension (µs depuis le lancement)
+    uint64_t bootMicros;      // Origine de millis() de la carte
+    bool booted;
+};
+
+struct Outage {
+    unsigned long start;
+    unsigned long end;
+};
+
+bool parseOutage(const char* text, Outage& outage) {
+    return sscanf(text, "%lu-%lu", &outage.start, &outage.end) == 2 && outage.start < outage.end;
+}
+
+// Chemin d'un module : nom court (oar_device_<nom>.so à côté de l'exécutable) ou fichier
+std::string modulePath(const char* name) {
+    if (strchr(name, '/') || strstr(name, ".so")) {
+        return name;
+    }
+    char self[4096];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    std::string dir = ".";
+    if (len > 0) {
+        self[len] = '\0';
+        dir = self;
+        dir = dir.substr(0, dir.rfind('/'));
+    }
+    return dir + "/oar_device_" + name + ".so";
+}
+
+bool readFile(const std::string& path, std::vector<char>& content) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.insert(content.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return true;
+}
+
+// dlopen() ne charge qu'une fois un même fichier : chaque carte charge une copie distincte,
+// supprimée dès le chargement (le code reste projeté en mémoire)
+void* loadCopy(const std::vector<char>& image, const std::string& dir, size_t index) {
+    std::string path = dir + "/device_" + std::to_string(index) + ".so";
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return nullptr;
+    }
+    bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+    fclose(file);
+    void* handle = written ? dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL) : nullptr;
+    if (!handle) {
+        fprintf(stderr, "%s\n", dlerror());
+    }
+    unlink(path.c_str());
+    return handle;
+}
+
+uint32_t readLittle32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Lire un entier CBOR (type majeur 0) ou un flottant simple précision ; false si autre chose
+bool readCborValue(const uint8_t*& p, const uint8_t* end, uint32_t& value) {
+    if (p >= end) {
+        return false;
+    }
+    uint8_t head = *p++;
+    size_t size = head < 24 ? 0 : head == 0x18 ? 1 : head == 0x19 ? 2 : head == 0x1A || head == 0xFA ? 4 : 9;
+    if (size > 4 || (size_t)(end - p) < size) {
+        return false;
+    }
+    value = head < 24 ? head : 0;
+    for (size_t i = 0; i < size; i++) {
+        value = (value << 8) | *p++;
+    }
+    return true;
+}
+
+// Horodatages (ms depuis le démarrage de la carte) des enregistrements d'un message
+// "sensors/telemetry" : enregistrements binaires fixes ou suite de maps CBOR
+void telemetryTimestamps(const std::vector<uint8_t>& payload, std::vector<uint32_t>& timestamps) {
+    const uint8_t* p = payload.data();
+    const uint8_t* end = p + payload.size();
+    while (p < end) {
+        if (*p == TELEMETRY_PACKED_VERSION || *p == TELEMETRY_PACKED_PROBE_VERSION) {
+            size_t size = *p == TELEMETRY_PACKED_VERSION ? TELEMETRY_PACKED_SIZE : TELEMETRY_PACKED_PROBE_SIZE;
+            if ((size_t)(end - p) < size) {
+                return;
+            }
+            timestamps.push_back(readLittle32(p + 5));
+            p += size;
+        } else if ((*p & 0xE0) == 0xA0) {
+            size_t pairs = *p++ & 0x1F;
+            for (size_t i = 0; i < pairs; i++) {
+                uint32_t key;
+                uint32_t value;
+                if (!readCborValue(p, end, key) || !readCborValue(p, end, value)) {
+                    return;
+                }
+                if (key == TELEMETRY_KEY_TIMESTAMP) {
+                    timestamps.push_back(value);
+                }
+            }
+        } else {
+            return;
+        }
+    }
+}
+
+// Centiles d'une série en millisecondes
+struct Percentiles {
+    size_t count;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+Percentiles percentiles(std::vector<uint64_t>& micros) {
+    Percentiles result = {micros.size(), 0, 0, 0, 0};
+    if (micros.empty()) {
+        return result;
+    }
+    std::sort(micros.begin(), micros.end());
+    auto at = [&](double q) { return micros[(size_t)(q * (micros.size() - 1) + 0.5)] / 1000.0; };
+    result.p50 = at(0.50);
+    result.p90 = at(0.90);
+    result.p99 = at(0.99);
+    result.max = micros.back() / 1000.0;
+    return result;
+}
+
+void printPercentiles(const char* label, std::vector<uint64_t>& micros) {
+    Percentiles p = percentiles(micros);
+    if (p.count == 0) {
+        printf("%s : aucune mesure\n", label);
+        return;
+    }
+    printf("%s : %lu mesures, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+           label, (unsigned long)p.count, p.p50, p.p90, p.p99, p.max);
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "Usage : %s [--devices N] [--duration ms] [--module nom|fichier.so]... [--boot-spread ms]\n"
+            "          [--broker-outage debut-fin]... [--outage-every periode:duree]\n"
+            "          [--broker-cost publication:complete:reprise] [--sensor-noise ecart]\n"
+            "          [--handshake ms] [--resumed-handshake ms] [--tick ms]\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t deviceCount = 100;
+    unsigned long duration = 600000;
+    unsigned long bootSpread = 10000;
+    unsigned long tick = 10;
+    std::vector<std::string> modules;
+    std::vector<Outage> outages;
+    // Broker sur un petit serveur : 30 µs par message, 4 ms de CPU par poignée de main RSA complète
+    unsigned long publishCost = 30;
+    unsigned long fullCost = 4000;
+    unsigned long resumedCost = 300;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        Outage outage;
+        unsigned long period;
+        unsigned long length;
+        float noise;
+        if (!value) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(arg, "--devices") == 0) {
+            deviceCount = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--duration") == 0) {
+            duration = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--module") == 0) {
+            modules.push_back(modulePath(value));
+        } else if (strcmp(arg, "--boot-spread") == 0) {
+            bootSpread = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--broker-outage") == 0 && parseOutage(value, outage)) {
+            outages.push_back(outage);
+        } else if (strcmp(arg, "--outage-every") == 0 &&
+                   sscanf(value, "%lu:%lu", &period, &length) == 2 && length < period) {
+            for (unsigned long start = period; start < duration; start += period) {
+                outages.push_back({start, start + length});
+            }
+        } else if (strcmp(arg, "--broker-cost") == 0 &&
+                   sscanf(value, "%lu:%lu:%lu", &publishCost, &fullCost, &resumedCost) == 3) {
+        } else if (strcmp(arg, "--sensor-noise") == 0 && sscanf(value, "%f", &noise) == 1) {
+            hostsim::setSensorNoise(noise, noise * 2);
+        } else if (strcmp(arg, "--handshake") == 0) {
+            hostsim::setHandshakeDelay(strtoul(value, nullptr, 10));
+        } else if (strcmp(arg, "--resumed-handshake") == 0) {
+            hostsim::setResumedHandshakeDelay(strtoul(value, nullptr, 10));
+        } else if (strcmp(arg, "--tick") == 0 && strtoul(value, nullptr, 10) > 0) {
+            tick = strtoul(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (deviceCount == 0 || deviceCount > 65535) {
+        fprintf(stderr, "Nombre de cartes invalide (1 à 65535)\n");
+        return 2;
+    }
+    if (modules.empty()) {
+        modules.push_back(modulePath("text"));
+    }
+
+    hostsim::setSerialQuiet(true);
+    hostsim::setBrokerCosts(publishCost, fullCost, resumedCost);
+    for (const auto& outage : outages) {
+        hostsim::addBrokerOutage(outage.start, outage.end);
+    }
+
+    std::vector<std::vector<char>> images(modules.size());
+    for (size_t m = 0; m < modules.size(); m++) {
+        if (!readFile(modules[m], images[m])) {
+            fprintf(stderr, "Module introuvable : %s\n", modules[m].c_str());
+            return 2;
+        }
+    }
+    char dirTemplate[] = "/tmp/oar_fleet.XXXXXX";
+    const char* dir = mkdtemp(dirTemplate);
+    if (!dir) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    // Identifiants identiques pour toutes les cartes, chiffrés avec la clé dérivée de chaque MAC
+    DeviceConfig config = {};
+    snprintf(config.wifi_ssid, sizeof(config.wifi_ssid), "oar-salle-serveur");
+    snprintf(config.wifi_pass, sizeof(config.wifi_pass), "flotte-de-test");
+    snprintf(config.mqtt_server, sizeof(config.mqtt_server), "192.168.1.10");
+    config.mqtt_port = 8883;
+    snprintf(config.mqtt_user, sizeof(config.mqtt_user), "capteur");
+    snprintf(config.mqtt_pass, sizeof(config.mqtt_pass), "flotte");
+
+    std::mt19937 bootRng(11);
+    std::vector<Device> devices(deviceCount);
+    for (size_t i = 0; i < deviceCount; i++) {
+        hostsim::selectDevice(i);
+        {
+            SecureStorage storage;
+            if (!storage.storeConfig(config)) {
+                fprintf(stderr, "Provisionnement impossible pour la carte %lu\n", (unsigned long)i);
+                return 1;
+            }
+        }
+        // Le module est chargé après selectDevice() : son SecureStorage dérive la clé de cette MAC
+        void* handle = loadCopy(images[i % images.size()], dir, i);
+        Device& device = devices[i];
+        device.setup = handle ? (SketchFunction)dlsym(handle, "_Z5setupv") : nullptr;
+        device.loop = handle ? (SketchFunction)dlsym(handle, "_Z4loopv") : nullptr;
+        if (!device.setup || !device.loop) {
+            fprintf(stderr, "Module inutilisable : %s\n", modules[i % modules.size()].c_str());
+            return 1;
+        }
+        device.bootAt = bootSpread ? (uint64_t)(bootRng() % bootSpread) * 1000 : 0;
+        device.booted = false;
+    }
+    rmdir(dir);
+
+    // File des cartes par horloge croissante
+    typedef std::pair<uint64_t, size_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (size_t i = 0; i < deviceCount; i++) {
+        queue.push(Entry(devices[i].bootAt, i));
+    }
+    const uint64_t end = (uint64_t)duration * 1000;
+    unsigned long long loops = 0;
+    while (!queue.empty()) {
+        size_t i = queue.top().second;
+        queue.pop();
+        hostsim::selectDevice(i);
+        Device& device = devices[i];
+        uint64_t before = hostsim::nowMicros();
+        try {
+            if (!device.booted) {
+                hostsim::advanceMicros(device.bootAt - before);
+                device.bootMicros = hostsim::nowMicros() - micros();
+                device.booted = true;
+                device.setup();
+            } else {
+                device.loop();
+                loops++;
+            }
+        } catch (const hostsim::DeepSleep&) {
+            fprintf(stderr, "Le sommeil profond n'est pas pris en charge par la flotte\n");
+            return 2;
+        }
+        // Une itération qui ne consomme pas de temps avance l'horloge de la carte d'un pas
+        if (hostsim::nowMicros() == before) {
+            hostsim::advance(tick);
+        }
+        if (hostsim::nowMicros() < end) {
+            queue.push(Entry(hostsim::nowMicros(), i));
+        }
+    }
+
+    // ------------------- BILAN ------------------------
+    const std::vector<hostsim::Message>& messages = hostsim::publishedMessages();
+    std::map<uint64_t, unsigned long> perSecond;
+    unsigned long long bytes = 0;
+    std::vector<uint64_t> queueing;
+    std::vector<uint64_t> live;
+    std::vector<uint64_t> replayed;
+    std::vector<uint32_t> timestamps;
+    unsigned long untimed = 0;
+    for (const auto& message : messages) {
+        perSecond[message.timeMicros / 1000000]++;
+        bytes += message.topic.size() + message.payload.size();
+        queueing.push_back(message.deliveredMicros - message.timeMicros);
+        uint64_t boot = devices[message.device].bootMicros;
+        if (message.topic == "sensors/telemetry") {
+            timestamps.clear();
+            telemetryTimestamps(message.payload, timestamps);
+            for (uint32_t ts : timestamps) {
+                live.push_back(message.deliveredMicros - (boot + (uint64_t)ts * 1000));
+            }
+        } else if (message.topic == "sensors/backlog") {
+            // Une ligne par mesure : "seq;age_ms;..." (âge au moment de l'envoi)
+            std::string text(message.payload.begin(), message.payload.end());
+            size_t pos = 0;
+            unsigned long seq;
+            unsigned long age;
+            while (pos < text.size()) {
+                if (sscanf(text.c_str() + pos, "%lu;%lu;", &seq, &age) == 2) {
+                    replayed.push_back(message.deliveredMicros - message.timeMicros + (uint64_t)age * 1000);
+                }
+                size_t next = text.find('\n', pos);
+                pos = next == std::string::npos ? text.size() : next + 1;
+            }
+        } else if (message.topic.compare(0, 19, "sensors/temperature") == 0) {
+            untimed++;
+        }
+    }
+    unsigned long peak = 0;
+    for (const auto& second : perSecond) {
+        peak = std::max(peak, second.second);
+    }
+
+    const hostsim::BrokerStats& broker = hostsim::brokerStats();
+    const hostsim::TlsStats& tls = hostsim::tlsStats();
+    std::vector<uint64_t> reconnects = hostsim::reconnectDurations();
+    double seconds = duration / 1000.0;
+    printf("=== Flotte : %lu cartes, %lu ms, %llu itérations de loop ===\n",
+           (unsigned long)deviceCount, duration, loops);
+    for (size_t m = 0; m < modules.size(); m++) {
+        printf("Module   : %s\n", modules[m].c_str());
+    }
+    printf("Broker   : %lu connexions, %lu refus, %lu sessions reprises par un autre client, %lu expirées\n",
+           broker.connects, broker.refused, broker.takeovers, broker.expired);
+    printf("TLS      : %lu poignées de main complètes, %lu reprises\n", tls.full, tls.resumed);
+    printf("Débit    : %lu messages, %.1f msg/s en moyenne, %lu msg/s au pic (1 s), %.1f ko/s\n",
+           (unsigned long)messages.size(), messages.size() / seconds, peak, bytes / seconds / 1000.0);
+    printPercentiles("File du broker       ", queueing);
+    printPercentiles("Mesure -> broker     ", live);
+    printPercentiles("Mesure rejouée       ", replayed);
+    if (untimed) {
+        printf("(%lu publications texte sans horodatage, hors latence de bout en bout)\n", untimed);
+    }
+    printPercentiles("Reconnexion          ", reconnects);
+    return 0;
+}
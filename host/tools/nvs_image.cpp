@@ -0,0 +1,543 @@
+// nvs_image.cpp - Images de partition NVS prêtes à flasher, une par carte
+// Remplace le programme de stockage (sketch_apr3a) : au lieu de flasher ce programme, démarrer,
+// puis reflasher le firmware, la partition NVS de chaque carte est écrite avec le firmware, en un
+// seul passage d'esptool. L'enregistrement "config" est produit par SecureStorage lui-même, avec la
+// MAC de la carte (clé dérivée, nonce | chiffré | tag) : seul le format de la partition est propre
+// à cet outil.
+//
+// Format ESP-IDF NVS (version 2) : pages de 4096 octets, en-tête de 32 octets (état, numéro de
+// séquence, version, CRC), bitmap d'état des entrées, puis 126 entrées de 32 octets (espace de
+// noms, type, nombre d'entrées occupées, index de fragment, CRC, clé, données). Un blob occupe une
+// ou plusieurs entrées BLOB_DATA (taille, CRC et données sur les entrées suivantes) suivies d'une
+// entrée BLOB_IDX. Les CRC sont des CRC-32 (polynôme 0xEDB88320) de valeur initiale 0xFFFFFFFF.
+//
+// Usage : oar_nvs_image [--size octets] <cartes.csv> <dossier>
+//         oar_nvs_image --verify <image.bin> <mac> [nvs_simulee]
+// cartes.csv : une carte par ligne, "mac,ssid,wifi_pass,mqtt_server,mqtt_port,mqtt_user,mqtt_pass"
+// (lignes vides et commençant par # ignorées, pas de virgule dans les valeurs). Chaque image est
+// relue et déchiffrée avant d'être écrite. --verify relit une image existante avec la MAC de la
+// carte et peut la convertir en NVS simulée pour oar_firmware --nvs.
+#include <Arduino.h>
+#include <Preferences.h>
+#include "HostSim.h"
+#include "SecureStorage.h"
+#include <algorithm>
+#include <random>
+
+namespace {
+
+const size_t PAGE_SIZE = 4096;
+const size_t ENTRY_SIZE = 32;
+const size_t ENTRIES_PER_PAGE = 126;
+const size_t FIRST_ENTRY_OFFSET = 64;
+const size_t DEFAULT_PARTITION_SIZE = 0x5000;   // Partition "nvs" des tables Arduino-ESP32 par défaut
+const unsigned long NVS_OFFSET = 0x9000;        // Adresse de cette partition
+const size_t MAX_BLOB_SIZE = 4000;              // Un blob de configuration tient largement dans une page
+
+const uint32_t PAGE_ACTIVE = 0xFFFFFFFE;
+const uint32_t PAGE_FULL = 0xFFFFFFFC;
+const uint8_t PAGE_VERSION_2 = 0xFE;
+const uint8_t ENTRY_WRITTEN = 0x2;              // Deux bits par entrée : 11 libre, 10 écrite, 00 effacée
+
+const uint8_t TYPE_U8 = 0x01;
+const uint8_t TYPE_BLOB_DATA = 0x42;
+const uint8_t TYPE_BLOB_IDX = 0x48;
+const uint8_t CHUNK_ANY = 0xFF;
+
+// CRC-32 au sens d'ESP-IDF (esp_rom_crc32_le) : prolonge un CRC déjà calculé
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+void putLe16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+void putLe32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+uint32_t getLe32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// CRC d'une entrée : ses 4 premiers octets, puis la clé et les données (le champ CRC est exclu)
+uint32_t entryCrc(const uint8_t* entry) {
+    return crc32(crc32(0xFFFFFFFF, entry, 4), entry + 8, ENTRY_SIZE - 8);
+}
+
+// ------------------- ECRITURE ------------------------
+class NvsImageWriter {
+private:
+    std::vector<uint8_t> image;
+    size_t page = 0;
+    size_t entry = 0;      // Prochaine entrée libre de la page courante
+    uint8_t nextNamespace = 1;
+
+    uint8_t* pageAt(size_t index) { return image.data() + index * PAGE_SIZE; }
+
+    void setPageState(size_t index, uint32_t state) {
+        uint8_t* header = pageAt(index);
+        putLe32(header, state);
+        putLe32(header + 4, (uint32_t)index);   // Numéro de séquence
+        header[8] = PAGE_VERSION_2;
+        putLe32(header + 28, crc32(0xFFFFFFFF, header + 4, 24));
+    }
+
+    // Passer à la page suivante si la courante n'a plus `count` entrées libres
+    bool reserve(size_t count) {
+        if (entry + count <= ENTRIES_PER_PAGE) {
+            return true;
+        }
+        setPageState(page, PAGE_FULL);
+        page++;
+        entry = 0;
+        // La dernière page reste libre : ESP-IDF en a besoin pour réorganiser la partition
+        if (page + 1 >= image.size() / PAGE_SIZE) {
+            return false;
+        }
+        setPageState(page, PAGE_ACTIVE);
+        return true;
+    }
+
+    uint8_t* takeEntry() {
+        uint8_t* bitmap = pageAt(page) + 32;
+        bitmap[entry / 4] &= (uint8_t)~(0x3 << ((entry % 4) * 2));
+        bitmap[entry / 4] |= (uint8_t)(ENTRY_WRITTEN << ((entry % 4) * 2));
+        return pageAt(page) + FIRST_ENTRY_OFFSET + (entry++) * ENTRY_SIZE;
+    }
+
+    // En-tête d'entrée : clé complétée de zéros, données à 0xFF
+    uint8_t* writeHeader(uint8_t ns, uint8_t type, uint8_t span, uint8_t chunk, const std::string& key) {
+        uint8_t* item = takeEntry();
+        item[0] = ns;
+        item[1] = type;
+        item[2] = span;
+        item[3] = chunk;
+        memset(item + 8, 0, 16);
+        memcpy(item + 8, key.data(), key.size());
+        return item;
+    }
+
+public:
+    explicit NvsImageWriter(size_t size) : image(size, 0xFF) {
+        setPageState(0, PAGE_ACTIVE);
+    }
+
+    const std::vector<uint8_t>& data() const { return image; }
+
+    // Déclarer un espace de noms ; renvoie son index (0 en cas d'échec)
+    uint8_t addNamespace(const std::string& name) {
+        if (name.empty() || name.size() > 15 || nextNamespace == 0xFF || !reserve(1)) {
+            return 0;
+        }
+        uint8_t* item = writeHeader(0, TYPE_U8, 1, CHUNK_ANY, name);
+        item[24] = nextNamespace;
+        putLe32(item + 4, entryCrc(item));
+        return nextNamespace++;
+    }
+
+    // Écrire un blob en fragments BLOB_DATA, suivis de l'entrée BLOB_IDX
+    bool addBlob(uint8_t ns, const std::string& key, const std::vector<uint8_t>& value) {
+        if (ns == 0 || key.empty() || key.size() > 15 || value.size() > MAX_BLOB_SIZE) {
+            return false;
+        }
+        size_t offset = 0;
+        uint8_t chunks = 0;
+        do {
+            if (ENTRIES_PER_PAGE - entry < 2 && !reserve(ENTRIES_PER_PAGE)) {
+                return false;
+            }
+            size_t room = (ENTRIES_PER_PAGE - entry - 1) * ENTRY_SIZE;
+            size_t length = std::min(room, value.size() - offset);
+            size_t dataEntries = (length + ENTRY_SIZE - 1) / ENTRY_SIZE;
+            uint8_t* item = writeHeader(ns, TYPE_BLOB_DATA, (uint8_t)(1 + dataEntries), chunks, key);
+            putLe16(item + 24, (uint16_t)length);
+            putLe32(item + 28, crc32(0xFFFFFFFF, value.data() + offset, length));
+            putLe32(item + 4, entryCrc(item));
+            for (size_t i = 0; i < dataEntries; i++) {
+                uint8_t* raw = takeEntry();
+                size_t n = std::min(ENTRY_SIZE, length - i * ENTRY_SIZE);
+                memcpy(raw, value.data() + offset + i * ENTRY_SIZE, n);
+            }
+            offset += length;
+            chunks++;
+        } while (offset < value.size());
+
+        if (!reserve(1)) {
+            return false;
+        }
+        uint8_t* index = writeHeader(ns, TYPE_BLOB_IDX, 1, CHUNK_ANY, key);
+        putLe32(index + 24, (uint32_t)value.size());
+        index[28] = chunks;
+        index[29] = 0;   // Premier index de fragment (version 0)
+        putLe32(index + 4, entryCrc(index));
+        return true;
+    }
+};
+
+// ------------------- RELECTURE ------------------------
+// Relire les blobs d'une image (pages, entrées et fragments vérifiés par leurs CRC)
+bool readNvsImage(const std::vector<uint8_t>& image, hostsim::NvsContents& contents, std::string& error) {
+    if (image.empty() || image.size() % PAGE_SIZE != 0) {
+        error = "taille qui n'est pas un multiple de 4096 octets";
+        return false;
+    }
+    std::map<uint8_t, std::string> namespaces;
+    struct Chunk {
+        uint8_t ns;
+        std::string key;
+        uint8_t index;
+        std::vector<uint8_t> data;
+    };
+    std::vector<Chunk> chunks;
+    struct Index {
+        uint8_t ns;
+        std::string key;
+        uint32_t size;
+        uint8_t count;
+    };
+    std::vector<Index> indexes;
+
+    for (size_t p = 0; p < image.size() / PAGE_SIZE; p++) {
+        const uint8_t* page = image.data() + p * PAGE_SIZE;
+        uint32_t state = getLe32(page);
+        if (state == 0xFFFFFFFF) {
+            continue;   // Page vierge
+        }
+        if ((state != PAGE_ACTIVE && state != PAGE_FULL) || page[8] != PAGE_VERSION_2 ||
+            getLe32(page + 28) != crc32(0xFFFFFFFF, page + 4, 24)) {
+            error = "en-tête de page " + std::to_string(p) + " invalide";
+            return false;
+        }
+        for (size_t e = 0; e < ENTRIES_PER_PAGE;) {
+            uint8_t bits = (page[32 + e / 4] >> ((e % 4) * 2)) & 0x3;
+            const uint8_t* item = page + FIRST_ENTRY_OFFSET + e * ENTRY_SIZE;
+            if (bits != ENTRY_WRITTEN) {
+                e++;
+                continue;
+            }
+            if (getLe32(item + 4) != entryCrc(item) || item[2] == 0 || e + item[2] > ENTRIES_PER_PAGE) {
+                error = "entrée " + std::to_string(e) + " de la page " + std::to_string(p) + " invalide";
+                return false;
+            }
+            std::string key((const char*)item + 8, strnlen((const char*)item + 8, 16));
+            if (item[0] == 0 && item[1] == TYPE_U8) {
+                namespaces[item[24]] = key;
+            } else if (item[1] == TYPE_BLOB_DATA) {
+                size_t length = item[24] | (item[25] << 8);
+                if (length > (size_t)(item[2] - 1) * ENTRY_SIZE) {
+                    error = "fragment de blob trop long";
+                    return false;
+                }
+                const uint8_t* raw = item + ENTRY_SIZE;
+                if (getLe32(item + 28) != crc32(0xFFFFFFFF, raw, length)) {
+                    error = "CRC du blob " + key + " invalide";
+                    return false;
+                }
+                chunks.push_back({item[0], key, item[3], std::vector<uint8_t>(raw, raw + length)});
+            } else if (item[1] == TYPE_BLOB_IDX) {
+                indexes.push_back({item[0], key, getLe32(item + 24), item[28]});
+            }
+            e += item[2];
+        }
+    }
+
+    for (const auto& index : indexes) {
+        auto ns = namespaces.find(index.ns);
+        if (ns == namespaces.end()) {
+            error = "espace de noms inconnu pour " + index.key;
+            return false;
+        }
+        std::vector<uint8_t> value;
+        for (uint8_t c = 0; c < index.count; c++) {
+            auto chunk = std::find_if(chunks.begin(), chunks.end(), [&](const Chunk& k) {
+                return k.ns == index.ns && k.key == index.key && k.index == c;
+            });
+            if (chunk == chunks.end()) {
+                error = "fragment manquant pour " + index.key;
+                return false;
+            }
+            value.insert(value.end(), chunk->data.begin(), chunk->data.end());
+        }
+        if (value.size() != index.size) {
+            error = "taille du blob " + index.key + " incohérente";
+            return false;
+        }
+        contents[ns->second][index.key] = value;
+    }
+    return true;
+}
+
+// Charger des blobs dans la NVS simulée (celle de la carte courante)
+bool loadIntoSimulatedNvs(const hostsim::NvsContents& contents) {
+    for (const auto& ns : contents) {
+        Preferences preferences;
+        if (!preferences.begin(ns.first.c_str(), false)) {
+            return false;
+        }
+        for (const auto& blob : ns.second) {
+            if (preferences.putBytes(blob.first.c_str(), blob.second.data(), blob.second.size()) != blob.second.size()) {
+                preferences.end();
+                return false;
+            }
+        }
+        preferences.end();
+    }
+    return true;
+}
+
+// Déchiffrer la configuration avec la MAC courante, comme le firmware au démarrage
+bool decryptConfig(DeviceConfig& config) {
+    SecureStorage storage;
+    return storage.loadConfig(config);
+}
+
+// Vider la NVS simulée entre deux cartes
+void clearSimulatedNvs() {
+    std::vector<std::string> names;
+    for (const auto& ns : hostsim::nvsContents()) {
+        names.push_back(ns.first);
+    }
+    for (const auto& name : names) {
+        Preferences preferences;
+        if (preferences.begin(name.c_str(), false)) {
+            preferences.clear();
+            preferences.end();
+        }
+    }
+}
+
+bool readFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return true;
+}
+
+bool writeFile(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
+
+// Découper une ligne "a,b,c" (sans guillemets)
+std::vector<std::string> splitCsv(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (;;) {
+        size_t comma = line.find(',', start);
+        fields.push_back(line.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        if (comma == std::string::npos) {
+            return fields;
+        }
+        start = comma + 1;
+    }
+}
+
+bool copyField(char* out, size_t size, const std::string& value) {
+    if (value.size() >= size) {
+        return false;
+    }
+    memcpy(out, value.c_str(), value.size() + 1);
+    return true;
+}
+
+bool parseDevice(const std::vector<std::string>& fields, uint8_t mac[6], DeviceConfig& config) {
+    char* end;
+    unsigned long port = fields.size() == 7 ? strtoul(fields[4].c_str(), &end, 10) : 0;
+    memset(&config, 0, sizeof(config));
+    return fields.size() == 7 && hostsim::parseMac(fields[0].c_str(), mac) && port > 0 && port <= 0xFFFF &&
+           *end == '\0' && copyField(config.wifi_ssid, sizeof(config.wifi_ssid), fields[1]) &&
+           copyField(config.wifi_pass, sizeof(config.wifi_pass), fields[2]) &&
+           copyField(config.mqtt_server, sizeof(config.mqtt_server), fields[3]) &&
+           copyField(config.mqtt_user, sizeof(config.mqtt_user), fields[5]) &&
+           copyField(config.mqtt_pass, sizeof(config.mqtt_pass), fields[6]) &&
+           (config.mqtt_port = (uint16_t)port) != 0;
+}
+
+bool sameConfig(const DeviceConfig& a, const DeviceConfig& b) {
+    return strcmp(a.wifi_ssid, b.wifi_ssid) == 0 && strcmp(a.wifi_pass, b.wifi_pass) == 0 &&
+           strcmp(a.mqtt_server, b.mqtt_server) == 0 && a.mqtt_port == b.mqtt_port &&
+           strcmp(a.mqtt_user, b.mqtt_user) == 0 && strcmp(a.mqtt_pass, b.mqtt_pass) == 0;
+}
+
+// Image d'une carte : enregistrement produit par SecureStorage avec sa MAC, puis relu
+bool buildImage(const uint8_t mac[6], const DeviceConfig& config, size_t size, std::vector<uint8_t>& image,
+                std::string& error) {
+    hostsim::setMac(mac);
+    clearSimulatedNvs();
+    {
+        SecureStorage storage;   // Clé dérivée de la MAC courante
+        if (!storage.storeConfig(config)) {
+            error = "chiffrement de la configuration impossible";
+            return false;
+        }
+    }
+
+    NvsImageWriter writer(size);
+    for (const auto& ns : hostsim::nvsContents()) {
+        uint8_t index = writer.addNamespace(ns.first);
+        if (index == 0) {
+            error = "espace de noms " + ns.first + " impossible à écrire";
+            return false;
+        }
+        for (const auto& blob : ns.second) {
+            if (!writer.addBlob(index, blob.first, blob.second)) {
+                error = "partition trop petite pour " + blob.first;
+                return false;
+            }
+        }
+    }
+    image = writer.data();
+
+    // Relecture : format de la partition, puis déchiffrement avec la MAC de la carte
+    hostsim::NvsContents contents;
+    DeviceConfig check;
+    clearSimulatedNvs();
+    if (!readNvsImage(image, contents, error) || !loadIntoSimulatedNvs(contents) || !decryptConfig(check) ||
+        !sameConfig(config, check)) {
+        error = "relecture de l'image en échec" + (error.empty() ? "" : " (" + error + ")");
+        return false;
+    }
+    mbedtls_platform_zeroize(&check, sizeof(check));
+    return true;
+}
+
+std::string macName(const uint8_t mac[6]) {
+    char name[16];
+    snprintf(name, sizeof(name), "%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return name;
+}
+
+int verify(const char* path, const char* macText, const char* simulatedNvs) {
+    uint8_t mac[6];
+    std::vector<uint8_t> image;
+    if (!hostsim::parseMac(macText, mac) || !readFile(path, image)) {
+        fprintf(stderr, "Image illisible ou MAC invalide\n");
+        return 2;
+    }
+    hostsim::setMac(mac);
+    if (simulatedNvs) {
+        remove(simulatedNvs);
+        hostsim::setNvsFile(simulatedNvs);
+    }
+    hostsim::NvsContents contents;
+    std::string error;
+    DeviceConfig config;
+    if (!readNvsImage(image, contents, error) || !loadIntoSimulatedNvs(contents)) {
+        fprintf(stderr, "Image NVS invalide : %s\n", error.c_str());
+        return 1;
+    }
+    if (!decryptConfig(config)) {
+        fprintf(stderr, "Configuration indéchiffrable avec la MAC %s\n", macText);
+        return 1;
+    }
+    // Les mots de passe ne sont pas affichés
+    printf("%s : SSID %s, broker %s:%u, utilisateur %s\n", path, config.wifi_ssid, config.mqtt_server,
+           (unsigned)config.mqtt_port, config.mqtt_user);
+    mbedtls_platform_zeroize(&config, sizeof(config));
+    return 0;
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "Usage : %s [--size octets] <cartes.csv> <dossier>\n"
+            "        %s --verify <image.bin> <mac> [nvs_simulee]\n",
+            program, program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    hostsim::setSerialQuiet(true);
+    if (argc >= 4 && argc <= 5 && strcmp(argv[1], "--verify") == 0) {
+        return verify(argv[2], argv[3], argc == 5 ? argv[4] : nullptr);
+    }
+
+    size_t size = DEFAULT_PARTITION_SIZE;
+    int arg = 1;
+    if (argc == 5 && strcmp(argv[1], "--size") == 0) {
+        size = strtoul(argv[2], nullptr, 0);
+        arg = 3;
+    }
+    if (argc - arg != 2 || size < 3 * PAGE_SIZE || size % PAGE_SIZE != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE* csv = fopen(argv[arg], "r");
+    if (!csv) {
+        fprintf(stderr, "Fichier illisible : %s\n", argv[arg]);
+        return 2;
+    }
+    std::string dir = argv[arg + 1];
+
+    // Nonces tirés du générateur du système : deux images d'une même carte ne réutilisent pas
+    // le même nonce (le générateur simulé est reproductible d'un lancement à l'autre)
+    std::random_device entropy;
+    hostsim::seedHardwareRandom(entropy());
+
+    char line[512];
+    unsigned long lineNumber = 0;
+    unsigned long written = 0;
+    unsigned long failed = 0;
+    while (fgets(line, sizeof(line), csv)) {
+        lineNumber++;
+        std::string text(line);
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+            text.pop_back();
+        }
+        if (text.empty() || text[0] == '#') {
+            continue;
+        }
+
+        uint8_t mac[6];
+        DeviceConfig config;
+        std::vector<uint8_t> image;
+        std::string error;
+        if (!parseDevice(splitCsv(text), mac, config)) {
+            error = "ligne mal formée";
+        } else if (buildImage(mac, config, size, image, error)) {
+            std::string path = dir + "/nvs-" + macName(mac) + ".bin";
+            if (writeFile(path, image)) {
+                printf("%s\n", path.c_str());
+                written++;
+            } else {
+                error = "écriture de " + path + " impossible";
+            }
+        }
+        mbedtls_platform_zeroize(&config, sizeof(config));
+        if (!error.empty()) {
+            fprintf(stderr, "Ligne %lu : %s\n", lineNumber, error.c_str());
+            failed++;
+        }
+    }
+    fclose(csv);
+
+    fprintf(stderr, "%lu image(s) de %u octets écrite(s), %lu erreur(s)\n", written, (unsigned)size, failed);
+    fprintf(stderr, "Flasher firmware et identifiants en un passage :\n"
+                    "  esptool.py --chip esp32 write_flash 0x%lx %s/nvs-<mac>.bin 0x10000 firmware.bin\n",
+            NVS_OFFSET, dir.c_str());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+// provision.cpp - Stockage des identifiants Wi-Fi et MQTT dans une NVS simulée (fichier)
+// Équivalent hôte du programme de stockage : prépare la NVS lue ensuite par oar_firmware
+//
+// Usage : oar_provision [--legacy] <nvs> <mac> <ssid> <wifi_pass> <mqtt_server> <mqtt_port> <mqtt_user> <mqtt_pass>
+#include <Arduino.h>
+#include "HostSim.h"
+#include "SecureStorage.h"
+
+int main(int argc, char** argv) {
+    const char* program = argv[0];
+    bool legacy = argc > 1 && strcmp(argv[1], "--legacy") == 0;
+    if (legacy) {
+        argv++;
+        argc--;
+    }
+    if (argc != 9) {
+        fprintf(stderr, "Usage : %s [--legacy] <nvs> <mac> <ssid> <wifi_pass> <mqtt_server> <mqtt_port> "
+                        "<mqtt_user> <mqtt_pass>\n", program);
+        return 2;
+    }
+
+    uint8_t mac[6];
+    if (!hostsim::parseMac(argv[2], mac)) {
+        fprintf(stderr, "Adresse MAC invalide : %s\n", argv[2]);
+        return 2;
+    }
+    hostsim::setMac(mac);
+    hostsim::setNvsFile(argv[1]);
+
+    // La clé dépend de la MAC : l'instance doit être créée après setMac()
+    SecureStorage storage;
+    storage.clearAllSecrets();
+
+    DeviceConfig config = {};
+    snprintf(config.wifi_ssid, sizeof(config.wifi_ssid), "%s", argv[3]);
+    snprintf(config.wifi_pass, sizeof(config.wifi_pass), "%s", argv[4]);
+    snprintf(config.mqtt_server, sizeof(config.mqtt_server), "%s", argv[5]);
+    config.mqtt_port = (uint16_t)atoi(argv[6]);
+    snprintf(config.mqtt_user, sizeof(config.mqtt_user), "%s", argv[7]);
+    snprintf(config.mqtt_pass, sizeof(config.mqtt_pass), "%s", argv[8]);
+
+    // Le bundle est écrit en un seul enregistrement ; --legacy conserve une clé par identifiant
+    bool ok;
+    if (legacy) {
+        SecretValue values[] = {
+            {"wifi_ssid", config.wifi_ssid, 0},
+            {"wifi_pass", config.wifi_pass, 0},
+            {"mqtt_server", config.mqtt_server, 0},
+            {"mqtt_port", nullptr, config.mqtt_port},
+            {"mqtt_user", config.mqtt_user, 0},
+            {"mqtt_pass", config.mqtt_pass, 0},
+        };
+        ok = storage.storeBatch(values, sizeof(values) / sizeof(values[0]));
+    } else {
+        ok = storage.storeConfig(config);
+    }
+
+    if (!ok) {
+        fprintf(stderr, "Erreur lors du stockage des identifiants dans %s\n", argv[1]);
+        return 1;
+    }
+    printf("Identifiants stockés dans %s pour %s\n", argv[1], argv[2]);
+    return 0;
+}
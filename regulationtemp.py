@@ -20,6 +20,14 @@ TEMP_UPPER_THRESHOLD = 22.0  # Seuil supérieur (active le système de refroidis
 TEMP_LOWER_THRESHOLD = 20.0  # Seuil inférieur (désactive le système de refroidissement si < 18°C)
 CONSUMPTION_THRESHOLD = 5.0  # Seuil de consommation minimale (W) pour considérer que la prise est allumée
 
+# === Supervision (firmware compilé avec OAR_LOCAL_CONTROL) ===
+# Avec --supervision, la carte régule elle-même : le script n'envoie aucune commande IR et ne fait que
+# surveiller les messages control/command et control/state de la carte
+SUPERVISION = "--supervision" in sys.argv
+MQTT_TOPIC_CONTROL = "control/#"  # Commandes et état de la régulation locale
+HOT_ALERT_DELAY = 600  # Durée (s) au-dessus du seuil supérieur avant une alerte
+STATE_TIMEOUT = 180  # Silence maximal (s) de control/state (publié toutes les minutes)
+
 # === Classe de contrôle du serveur ===
 class ServerRoomControlApp:
     def __init__(self):
@@ -28,9 +36,12 @@ class ServerRoomControlApp:
         self.temperature = None
         self.humidity = None
         self.consumption = None  # Valeur de consommation
+        self.hot_since = None  # Début du dépassement du seuil supérieur (supervision)
+        self.last_state = time.time()  # Dernier message control/state (supervision)
 
-        # Connexion au Broadlink et au MQTT
-        self.connect_broadlink()
+        # Connexion au Broadlink et au MQTT (en supervision, seule la carte commande le climatiseur)
+        if not SUPERVISION:
+            self.connect_broadlink()
         self.connect_mqtt()
 
         # Timer pour rafraîchir les données de température, d'humidité et de consommation
@@ -70,18 +81,41 @@ class ServerRoomControlApp:
         print(f"Connecté au broker MQTT avec code {rc}")
         client.subscribe(MQTT_TOPIC_TEMP)
         client.subscribe(MQTT_TOPIC_HUMID)
+        if SUPERVISION:
+            client.subscribe(MQTT_TOPIC_CONTROL)
 
     def on_message(self, client, userdata, msg):
         """Gestion des messages MQTT"""
         if msg.topic == MQTT_TOPIC_TEMP:
             self.temperature = float(msg.payload.decode())
             print(f"Température : {self.temperature:.2f}°C")
-            self.control_air_conditioner()  # Gère l'activation/désactivation du système de refroidissement
+            if SUPERVISION:
+                self.supervise_temperature()
+            else:
+                self.control_air_conditioner()  # Gère l'activation/désactivation du système de refroidissement
 
         elif msg.topic == MQTT_TOPIC_HUMID:
             self.humidity = float(msg.payload.decode())
             print(f"Humidité : {self.humidity:.2f}%")
 
+        elif msg.topic == "control/command":
+            print(f"Commande IR envoyée par la carte : {msg.payload.decode()}")
+
+        elif msg.topic == "control/state":
+            self.last_state = time.time()
+            print(f"État de la régulation locale : {msg.payload.decode()}")
+
+    def supervise_temperature(self):
+        """Alerte si la salle reste au-dessus du seuil supérieur malgré la régulation de la carte"""
+        if self.temperature > TEMP_UPPER_THRESHOLD:
+            if self.hot_since is None:
+                self.hot_since = time.time()
+            elif time.time() - self.hot_since > HOT_ALERT_DELAY:
+                print(f"ALERTE : température au-dessus de {TEMP_UPPER_THRESHOLD}°C depuis "
+                      f"{int(time.time() - self.hot_since)} s, vérifier le climatiseur.")
+        else:
+            self.hot_since = None
+
     def control_air_conditioner(self):
         """Logique d'hystérésis pour contrôler le climatiseur, avec vérification de la consommation"""
         if self.consumption is None:
@@ -133,7 +167,12 @@ class ServerRoomControlApp:
                 if self.humidity is not None:
                     print(f"Humidité actuelle : {self.humidity:.2f}%")
 
-                self.update_consumption()  # Mettre à jour la consommation toutes les secondes
+                if SUPERVISION:
+                    # La carte lit elle-même la prise ; vérifier seulement qu'elle publie son état
+                    if time.time() - self.last_state > STATE_TIMEOUT:
+                        print(f"ALERTE : aucun état de la régulation locale depuis {int(time.time() - self.last_state)} s.")
+                else:
+                    self.update_consumption()  # Mettre à jour la consommation toutes les secondes
 
                 # Attendre 1 seconde avant la prochaine mise à jour
                 time.sleep(1)
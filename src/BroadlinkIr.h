@@ -0,0 +1,238 @@
+// BroadlinkIr.h - Commandes IR envoyées directement à un Broadlink RM (protocole UDP local, port 80)
+// Même échange que python-broadlink dans regulationtemp.py : découverte (type d'appareil et MAC),
+// authentification (clé AES-128 de session), puis commande "send_data".
+// Paquet : en-tête de 0x38 octets (somme de contrôle, type d'appareil, type de paquet, compteur,
+// MAC, identifiant de session, somme de la charge utile), puis charge utile chiffrée en AES-128-CBC.
+// Chaque échange attend la réponse au plus BROADLINK_TIMEOUT_MS (boucle bloquée, comme la
+// poignée de main TLS).
+#ifndef BROADLINK_IR_H
+#define BROADLINK_IR_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "mbedtls/aes.h"
+#include "ClimateControl.h"
+
+const uint16_t BROADLINK_PORT = 80;
+const uint16_t BROADLINK_LOCAL_PORT = 40080;  // Port local des échanges (l'appareil répond à l'émetteur)
+const unsigned long BROADLINK_TIMEOUT_MS = 500;
+const size_t BROADLINK_HEADER_SIZE = 0x38;
+const size_t BROADLINK_MAX_PAYLOAD = 256;     // Code IR et en-tête de commande, complétés à 16 octets
+const uint16_t BROADLINK_CMD_HELLO = 0x06;
+const uint16_t BROADLINK_CMD_AUTH = 0x65;
+const uint16_t BROADLINK_CMD_COMMAND = 0x6a;
+
+// Clé et vecteur d'initialisation communs à tous les appareils, avant authentification
+const uint8_t BROADLINK_INITIAL_KEY[16] = {
+    0x09, 0x76, 0x28, 0x34, 0x3f, 0xe9, 0x9e, 0x23, 0x76, 0x5c, 0x15, 0x13, 0xac, 0xcf, 0x8b, 0x02
+};
+const uint8_t BROADLINK_IV[16] = {
+    0x56, 0x2e, 0x17, 0x99, 0x6d, 0x09, 0x3d, 0x28, 0xdd, 0xb3, 0xba, 0x69, 0x5a, 0x2e, 0x6f, 0x58
+};
+
+// Somme de contrôle Broadlink : somme des octets à partir de 0xBEAF, sur 16 bits
+inline uint16_t broadlinkChecksum(const uint8_t* data, size_t length) {
+    uint32_t sum = 0xBEAF;
+    for (size_t i = 0; i < length; i++) {
+        sum += data[i];
+    }
+    return (uint16_t)sum;
+}
+
+// AES-128-CBC sur un multiple de 16 octets, le vecteur d'initialisation est toujours BROADLINK_IV
+inline bool broadlinkCrypt(const uint8_t key[16], bool encrypt, const uint8_t* input, uint8_t* output,
+                           size_t length) {
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    uint8_t iv[16];
+    memcpy(iv, BROADLINK_IV, sizeof(iv));
+    int ret = encrypt ? mbedtls_aes_setkey_enc(&aes, key, 128) : mbedtls_aes_setkey_dec(&aes, key, 128);
+    if (ret == 0) {
+        ret = mbedtls_aes_crypt_cbc(&aes, encrypt ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT, length, iv,
+                                    input, output);
+    }
+    mbedtls_aes_free(&aes);
+    return ret == 0;
+}
+
+class BroadlinkIrTransport : public IrTransport {
+private:
+    WiFiUDP udp;
+    IPAddress address;
+    // Les RM4 préfixent le code de sa longueur ; RM mini 3 et RM Pro non
+    bool rm4;
+    bool discovered = false;
+    bool authenticated = false;
+    uint16_t deviceType = 0;
+    uint8_t mac[6] = {};
+    uint8_t key[16];
+    uint32_t sessionId = 0;
+    uint16_t count = 0;
+    uint8_t packet[BROADLINK_HEADER_SIZE + BROADLINK_MAX_PAYLOAD];
+
+    // Attendre une réponse de l'appareil ; renvoie sa longueur (0 : délai dépassé)
+    size_t receive(unsigned long start) {
+        while (millis() - start < BROADLINK_TIMEOUT_MS) {
+            int size = udp.parsePacket();
+            if (size > 0) {
+                if (!(udp.remoteIP() == address)) {
+                    udp.read(packet, sizeof(packet));  // Paquet d'un autre appareil : ignoré
+                    continue;
+                }
+                return udp.read(packet, sizeof(packet));
+            }
+            delay(1);
+        }
+        return 0;
+    }
+
+    // Découverte : type d'appareil et MAC, nécessaires aux en-têtes des paquets suivants
+    bool hello() {
+        memset(packet, 0, 0x30);
+        IPAddress local = WiFi.localIP();
+        for (int i = 0; i < 4; i++) {
+            packet[0x18 + i] = local[3 - i];
+        }
+        packet[0x1c] = (uint8_t)(BROADLINK_LOCAL_PORT & 0xFF);
+        packet[0x1d] = (uint8_t)(BROADLINK_LOCAL_PORT >> 8);
+        packet[0x26] = BROADLINK_CMD_HELLO;
+        uint16_t checksum = broadlinkChecksum(packet, 0x30);
+        packet[0x20] = (uint8_t)checksum;
+        packet[0x21] = (uint8_t)(checksum >> 8);
+
+        unsigned long start = millis();
+        if (!udp.beginPacket(address, BROADLINK_PORT) || udp.write(packet, 0x30) != 0x30 || !udp.endPacket()) {
+            return false;
+        }
+        size_t length = receive(start);
+        if (length < 0x40) {
+            return false;
+        }
+        deviceType = packet[0x34] | (packet[0x35] << 8);
+        for (int i = 0; i < 6; i++) {
+            mac[i] = packet[0x3f - i];
+        }
+        discovered = true;
+        return true;
+    }
+
+    // Envoyer un paquet chiffré et déchiffrer la charge utile de la réponse dans response.
+    // Renvoie la longueur de la réponse déchiffrée, -1 en cas d'échec.
+    int exchange(uint16_t type, const uint8_t* payload, size_t length, uint8_t* response, size_t responseSize) {
+        size_t padded = (length + 15) / 16 * 16;
+        if (padded == 0 || padded > BROADLINK_MAX_PAYLOAD) {
+            return -1;
+        }
+        count = (uint16_t)((count + 1) | 0x8000);
+        memset(packet, 0, BROADLINK_HEADER_SIZE + padded);
+        static const uint8_t magic[8] = {0x5a, 0xa5, 0xaa, 0x55, 0x5a, 0xa5, 0xaa, 0x55};
+        memcpy(packet, magic, sizeof(magic));
+        packet[0x24] = (uint8_t)deviceType;
+        packet[0x25] = (uint8_t)(deviceType >> 8);
+        packet[0x26] = (uint8_t)type;
+        packet[0x27] = (uint8_t)(type >> 8);
+        packet[0x28] = (uint8_t)count;
+        packet[0x29] = (uint8_t)(count >> 8);
+        for (int i = 0; i < 6; i++) {
+            packet[0x2a + i] = mac[5 - i];
+        }
+        for (int i = 0; i < 4; i++) {
+            packet[0x30 + i] = (uint8_t)(sessionId >> (8 * i));
+        }
+        uint16_t payloadChecksum = broadlinkChecksum(payload, length);
+        packet[0x34] = (uint8_t)payloadChecksum;
+        packet[0x35] = (uint8_t)(payloadChecksum >> 8);
+
+        uint8_t plain[BROADLINK_MAX_PAYLOAD] = {};
+        memcpy(plain, payload, length);
+        if (!broadlinkCrypt(key, true, plain, packet + BROADLINK_HEADER_SIZE, padded)) {
+            return -1;
+        }
+        uint16_t checksum = broadlinkChecksum(packet, BROADLINK_HEADER_SIZE + padded);
+        packet[0x20] = (uint8_t)checksum;
+        packet[0x21] = (uint8_t)(checksum >> 8);
+
+        unsigned long start = millis();
+        if (!udp.beginPacket(address, BROADLINK_PORT) ||
+            udp.write(packet, BROADLINK_HEADER_SIZE + padded) != BROADLINK_HEADER_SIZE + padded ||
+            !udp.endPacket()) {
+            return -1;
+        }
+        size_t received = receive(start);
+        // Code d'erreur de l'appareil en 0x22 (0 : succès)
+        if (received < BROADLINK_HEADER_SIZE || packet[0x22] != 0 || packet[0x23] != 0) {
+            return -1;
+        }
+        size_t encrypted = (received - BROADLINK_HEADER_SIZE) / 16 * 16;
+        if (encrypted > responseSize) {
+            encrypted = responseSize / 16 * 16;
+        }
+        if (encrypted && !broadlinkCrypt(key, false, packet + BROADLINK_HEADER_SIZE, response, encrypted)) {
+            return -1;
+        }
+        return (int)encrypted;
+    }
+
+    // Authentification : l'appareil renvoie l'identifiant et la clé de la session
+    bool authenticate() {
+        memcpy(key, BROADLINK_INITIAL_KEY, sizeof(key));
+        sessionId = 0;
+        uint8_t payload[0x50] = {};
+        memset(payload + 0x04, 0x31, 16);
+        payload[0x1e] = 0x01;
+        payload[0x2d] = 0x01;
+        memcpy(payload + 0x30, "Test 1", 6);
+        uint8_t response[0x20];
+        if (exchange(BROADLINK_CMD_AUTH, payload, sizeof(payload), response, sizeof(response)) < 0x14) {
+            return false;
+        }
+        sessionId = response[0] | (response[1] << 8) | (response[2] << 16) | ((uint32_t)response[3] << 24);
+        memcpy(key, response + 0x04, sizeof(key));
+        authenticated = true;
+        return true;
+    }
+
+    bool sendData(const uint8_t* code, size_t length) {
+        uint8_t payload[BROADLINK_MAX_PAYLOAD];
+        size_t header = rm4 ? 6 : 4;
+        if (header + length > sizeof(payload)) {
+            return false;
+        }
+        size_t len = 0;
+        if (rm4) {
+            payload[len++] = (uint8_t)(length + 4);
+            payload[len++] = (uint8_t)((length + 4) >> 8);
+        }
+        static const uint8_t sendCommand[4] = {0x02, 0x00, 0x00, 0x00};
+        memcpy(payload + len, sendCommand, sizeof(sendCommand));
+        len += sizeof(sendCommand);
+        memcpy(payload + len, code, length);
+        uint8_t response[16];
+        return exchange(BROADLINK_CMD_COMMAND, payload, len + length, response, sizeof(response)) >= 0;
+    }
+
+public:
+    explicit BroadlinkIrTransport(IPAddress address, bool rm4 = false) : address(address), rm4(rm4) {
+        memcpy(key, BROADLINK_INITIAL_KEY, sizeof(key));
+    }
+
+    // Méthode pour envoyer une commande IR ; après un échec, la session est renégociée une fois
+    bool send(const uint8_t* code, size_t length) override {
+        if (!discovered) {
+            udp.begin(BROADLINK_LOCAL_PORT);
+            if (!hello()) {
+                return false;
+            }
+        }
+        if (authenticated && sendData(code, length)) {
+            return true;
+        }
+        authenticated = false;
+        return authenticate() && sendData(code, length);
+    }
+
+    uint16_t type() const { return deviceType; }
+};
+
+#endif // BROADLINK_IR_H
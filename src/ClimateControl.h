@@ -0,0 +1,92 @@
+// ClimateControl.h - Régulation du climatiseur par hystérésis, sur la carte
+// Même logique que control_air_conditioner() de regulationtemp.py : au-dessus du seuil haut avec
+// un climatiseur arrêté, ou sous le seuil bas avec un climatiseur en marche, la commande IR est
+// envoyée. La télécommande n'a qu'une touche marche/arrêt : l'état du climatiseur est déduit de
+// la consommation de sa prise (au-dessous de powerThresholdW, il est arrêté) et, consommation
+// inconnue, rien n'est envoyé.
+// En plus du script : après une commande, la consommation mesurée ne suit qu'après le démarrage
+// du compresseur ; pendant guardMs, aucune nouvelle commande (elle rééteindrait le climatiseur).
+// Commande et mesure de la consommation passent par des interfaces (IrTransport, PowerMeter)
+// pour changer de matériel sans toucher à la décision.
+// HysteresisControl est une structure sans constructeur : une instance mise à zéro n'a encore
+// rien commandé.
+#ifndef CLIMATE_CONTROL_H
+#define CLIMATE_CONTROL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Envoi d'une commande IR brute (format Broadlink : 0x26 pour l'infrarouge, durées, fin 0x0d05)
+class IrTransport {
+public:
+    virtual ~IrTransport() {}
+    virtual bool send(const uint8_t* code, size_t length) = 0;
+};
+
+// Consommation instantanée de la prise du climatiseur
+class PowerMeter {
+public:
+    virtual ~PowerMeter() {}
+    virtual bool readPower(float& watts) = 0;
+};
+
+struct ControlConfig {
+    float upperC;           // Au-dessus : refroidir
+    float lowerC;           // Au-dessous : arrêter
+    float powerThresholdW;  // Consommation à partir de laquelle le climatiseur est en marche
+    uint32_t guardMs;       // Délai minimal entre deux commandes
+};
+
+enum ControlAction {
+    CONTROL_NONE,           // Température entre les seuils, ou climatiseur déjà dans le bon état
+    CONTROL_COOL_ON,        // Commande envoyée pour démarrer le climatiseur
+    CONTROL_COOL_OFF,       // Commande envoyée pour l'arrêter
+    CONTROL_NO_POWER,       // Consommation inconnue : décision impossible
+    CONTROL_GUARD,          // Commande récente : état de la prise pas encore à jour
+    CONTROL_SEND_FAILED     // Commande décidée, envoi IR en échec
+};
+
+struct HysteresisControl {
+    uint32_t lastCommandAt;   // Instant de la dernière commande envoyée (ms)
+    bool commanded;           // Une commande a déjà été envoyée
+    uint32_t commands;        // Commandes envoyées
+    uint32_t sendFailures;    // Envois IR en échec
+    uint32_t powerFailures;   // Consommation illisible alors qu'une décision était nécessaire
+
+    // Méthode pour appliquer l'hystérésis à une nouvelle température. La consommation n'est
+    // lue que hors de la bande [lowerC, upperC], où une commande peut être nécessaire.
+    ControlAction update(const ControlConfig& config, float temperature, PowerMeter& meter,
+                         IrTransport& transport, const uint8_t* code, size_t length, uint32_t now,
+                         float* watts = nullptr) {
+        bool tooHot = temperature > config.upperC;
+        bool tooCold = temperature < config.lowerC;
+        if (!tooHot && !tooCold) {
+            return CONTROL_NONE;
+        }
+        if (commanded && now - lastCommandAt < config.guardMs) {
+            return CONTROL_GUARD;
+        }
+        float power;
+        if (!meter.readPower(power)) {
+            powerFailures++;
+            return CONTROL_NO_POWER;
+        }
+        if (watts) {
+            *watts = power;
+        }
+        bool running = power >= config.powerThresholdW;
+        if (tooHot == running) {
+            return CONTROL_NONE;  // Déjà en marche s'il fait trop chaud, déjà arrêté s'il fait trop froid
+        }
+        if (!transport.send(code, length)) {
+            sendFailures++;
+            return CONTROL_SEND_FAILED;
+        }
+        commands++;
+        commanded = true;
+        lastCommandAt = now;
+        return tooHot ? CONTROL_COOL_ON : CONTROL_COOL_OFF;
+    }
+};
+
+#endif // CLIMATE_CONTROL_H
@@ -0,0 +1,74 @@
+// Deadband.h - Publication par exception (bande morte) avec battement de cœur
+// Une mesure n'est publiée que si l'une de ses grandeurs s'écarte assez de la dernière valeur
+// publiée, ou si aucune mesure n'a été publiée depuis trop longtemps : le consommateur peut
+// ainsi distinguer un capteur stable d'une carte muette.
+// Structure sans constructeur : une instance mise à zéro n'a encore rien publié, ce qui permet
+// de la placer en mémoire RTC (RTC_DATA_ATTR) pour le sommeil profond.
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+// Seuil d'une grandeur : écart absolu (unité de la grandeur) ou relatif à la dernière valeur
+// publiée (0.01 = 1 %). Le plus grand des deux s'applique ; deux seuils nuls publient tout.
+struct DeadbandConfig {
+    float absolute;
+    float relative;
+
+    float threshold(float reference) const {
+        float scaled = relative * fabsf(reference);
+        return scaled > absolute ? scaled : absolute;
+    }
+};
+
+enum ReportReason {
+    REPORT_NONE,       // Écart dans la bande morte : rien à publier
+    REPORT_FIRST,      // Première mesure depuis le démarrage à froid
+    REPORT_CHANGE,     // Au moins une grandeur est sortie de sa bande morte
+    REPORT_HEARTBEAT   // Silence trop long : valeurs inchangées republiées
+};
+
+template <size_t N>
+struct ReportFilter {
+    float reported[N];    // Dernières valeurs publiées
+    uint32_t reportedAt;  // Instant de la dernière publication (ms)
+    bool primed;          // Une mesure a déjà été publiée
+    uint32_t suppressed;  // Mesures filtrées
+    uint32_t heartbeats;  // Mesures publiées par le seul battement de cœur
+
+    // Méthode pour décider si une mesure est publiée ; les valeurs retenues deviennent la
+    // nouvelle référence
+    ReportReason admit(const DeadbandConfig* config, const float* values, uint32_t now,
+                       uint32_t heartbeatMs) {
+        ReportReason reason = REPORT_NONE;
+        if (!primed) {
+            reason = REPORT_FIRST;
+        } else {
+            for (size_t i = 0; i < N; i++) {
+                if (fabsf(values[i] - reported[i]) >= config[i].threshold(reported[i])) {
+                    reason = REPORT_CHANGE;
+                    break;
+                }
+            }
+            if (reason == REPORT_NONE && now - reportedAt >= heartbeatMs) {
+                reason = REPORT_HEARTBEAT;
+                heartbeats++;
+            }
+        }
+
+        if (reason == REPORT_NONE) {
+            suppressed++;
+            return reason;
+        }
+        for (size_t i = 0; i < N; i++) {
+            reported[i] = values[i];
+        }
+        reportedAt = now;
+        primed = true;
+        return reason;
+    }
+};
+
+#endif // DEADBAND_H
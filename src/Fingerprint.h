@@ -0,0 +1,21 @@
+// Fingerprint.h - Empreinte FNV-1a 32 bits (non cryptographique)
+// Sert à reconnaître un broker ou un réseau mis en cache et à détecter une mémoire RTC incohérente
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+inline uint32_t fingerprint(const uint8_t* data, size_t len, uint32_t hash = 2166136261u) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+inline uint32_t fingerprint(const char* text) {
+    return fingerprint((const uint8_t*)text, strlen(text));
+}
+
+#endif // FINGERPRINT_H
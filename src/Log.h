@@ -0,0 +1,224 @@
+// Log.h - Journal par niveaux, formaté dans une file circulaire et vidé sans bloquer la boucle
+// À 115200 bauds, l'UART émet 11,5 octets par milliseconde et sa FIFO n'en garde que 128 : au-delà,
+// Serial.print() bloque la tâche appelante jusqu'à ce que la place se libère. Les messages sont
+// donc formatés dans une file de lignes, puis écrits sur le port série :
+//   - par une tâche de basse priorité en mode double cœur (logFlush(), elle seule attend l'UART) ;
+//   - sinon, à chaque tour de loop(), autant d'octets que la FIFO de l'UART en prend sans attendre
+//     (logDrain()) ; une ligne longue est finie aux tours suivants.
+// La file accepte plusieurs producteurs (tâches capteur et réseau) sans verrou : une ligne est
+// réservée par compare-and-swap sur l'index d'écriture, puis publiée par son numéro de séquence.
+// File pleine : la ligne est perdue et comptée, le nombre de pertes est écrit avec la ligne suivante.
+//
+// Niveaux filtrés à la compilation : OAR_LOG_LEVEL (LOG_LEVEL_INFO par défaut) ; au-dessus, les
+// macros LOG_* ne produisent aucun code et leurs arguments ne sont pas évalués.
+// OAR_LOG_SYNC écrit directement sur le port série, comme avant (comparaison, débogage).
+//
+// Secrets : mots de passe et clés ne sont jamais formatés. LOG_SECRET(valeur) les remplace par
+// "<masqué>" (ou "<vide>"), quel que soit le niveau.
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef OAR_LOG_LEVEL
+#define OAR_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+const size_t LOG_LINES = 32;            // Puissance de 2 (8 Ko de RAM statique)
+const size_t LOG_LINE_SIZE = 256;       // Au-delà, le message est tronqué
+const int LOG_REPORT_ROOM = 64;         // Place libre dans la FIFO de l'UART pour signaler des pertes
+const unsigned long LOG_DRAIN_MS = 20;  // Période de la tâche de journal
+
+struct LogLine {
+    // Séquence décalée de l'index de la ligne : une file mise à zéro est une file vide
+    std::atomic<uint32_t> sequence;
+    uint16_t length;
+    char text[LOG_LINE_SIZE];
+};
+
+struct LogRing {
+    static_assert((LOG_LINES & (LOG_LINES - 1)) == 0, "LOG_LINES doit être une puissance de 2");
+
+    LogLine lines[LOG_LINES];
+    std::atomic<uint32_t> writeIndex;   // Prochaine ligne à réserver (producteurs)
+    uint32_t readIndex;                 // Prochaine ligne à écrire (consommateur unique)
+    uint16_t readOffset;                // Octets déjà écrits de cette ligne
+    std::atomic<uint32_t> dropped;      // Lignes perdues, file pleine
+    uint32_t droppedReported;
+
+    // Réserver une ligne ; nullptr si la file est pleine
+    LogLine* reserve(uint32_t& position) {
+        uint32_t pos = writeIndex.load(std::memory_order_relaxed);
+        for (;;) {
+            LogLine& line = lines[pos & (LOG_LINES - 1)];
+            int32_t diff = (int32_t)(line.sequence.load(std::memory_order_acquire) + (pos & (LOG_LINES - 1)) - pos);
+            if (diff == 0) {
+                if (writeIndex.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    position = pos;
+                    return &line;
+                }
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            } else {
+                pos = writeIndex.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Rendre la ligne visible au consommateur
+    void publish(LogLine& line, uint32_t position) {
+        line.sequence.store(position + 1 - (position & (LOG_LINES - 1)), std::memory_order_release);
+    }
+
+    // Ligne suivante prête à écrire, nullptr si aucune
+    LogLine* peek() {
+        LogLine& line = lines[readIndex & (LOG_LINES - 1)];
+        uint32_t expected = readIndex + 1 - (readIndex & (LOG_LINES - 1));
+        return line.sequence.load(std::memory_order_acquire) == expected ? &line : nullptr;
+    }
+
+    // Libérer la ligne écrite pour le tour suivant de la file
+    void release(LogLine& line) {
+        line.sequence.store(readIndex + LOG_LINES - (readIndex & (LOG_LINES - 1)), std::memory_order_release);
+        readIndex++;
+        readOffset = 0;
+    }
+};
+
+// Instance unique, mise à zéro au démarrage (pas de constructeur à exécuter)
+inline LogRing& logRing() {
+    static LogRing ring;
+    return ring;
+}
+
+inline char logLevelLetter(int level) {
+    static const char letters[] = "-EWID";
+    return level >= 0 && level <= LOG_LEVEL_DEBUG ? letters[level] : '?';
+}
+
+// Formater une ligne "[secondes.millièmes] N message" dans buffer ; renvoie sa longueur
+inline size_t logFormat(char* buffer, int level, const char* format, va_list args) {
+    unsigned long now = millis();
+    int prefix = snprintf(buffer, LOG_LINE_SIZE, "[%6lu.%03lu] %c ", now / 1000, now % 1000, logLevelLetter(level));
+    int body = vsnprintf(buffer + prefix, LOG_LINE_SIZE - prefix - 1, format, args);
+    size_t length = prefix + (body < 0 ? 0 : body);
+    if (length > LOG_LINE_SIZE - 2) {
+        length = LOG_LINE_SIZE - 2;   // Message tronqué
+    }
+    buffer[length++] = '\n';
+    buffer[length] = '\0';
+    return length;
+}
+
+inline void logWrite(int level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+inline void logWrite(int level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+#ifdef OAR_LOG_SYNC
+    char text[LOG_LINE_SIZE];
+    size_t length = logFormat(text, level, format, args);
+    Serial.write((const uint8_t*)text, length);
+#else
+    LogRing& ring = logRing();
+    uint32_t position;
+    LogLine* line = ring.reserve(position);
+    if (line) {
+        line->length = (uint16_t)logFormat(line->text, level, format, args);
+        ring.publish(*line, position);
+    }
+#endif
+    va_end(args);
+}
+
+// Signaler les lignes perdues depuis le dernier signalement
+inline void logReportDropped(LogRing& ring) {
+    uint32_t dropped = ring.dropped.load(std::memory_order_relaxed);
+    if (dropped != ring.droppedReported) {
+        Serial.printf("[journal] %lu ligne(s) perdue(s), file pleine\n", (unsigned long)(dropped - ring.droppedReported));
+        ring.droppedReported = dropped;
+    }
+}
+
+// Écrire ce que la FIFO de l'UART prend sans attendre (consommateur unique : boucle coopérative).
+// Renvoie le nombre de lignes terminées.
+inline size_t logDrain() {
+    LogRing& ring = logRing();
+    size_t written = 0;
+    LogLine* line;
+    while ((line = ring.peek()) != nullptr) {
+        int room = Serial.availableForWrite();
+        if (room <= 0) {
+            break;
+        }
+        size_t chunk = line->length - ring.readOffset;
+        if (chunk > (size_t)room) {
+            chunk = room;
+        }
+        Serial.write((const uint8_t*)line->text + ring.readOffset, chunk);
+        ring.readOffset += chunk;
+        if (ring.readOffset < line->length) {
+            break;
+        }
+        ring.release(*line);
+        written++;
+    }
+    if (ring.readOffset == 0 && Serial.availableForWrite() >= LOG_REPORT_ROOM) {
+        logReportDropped(ring);
+    }
+    return written;
+}
+
+// Écrire toutes les lignes en attente, en attendant l'UART (tâche de journal, avant un sommeil profond)
+inline void logFlush() {
+    LogRing& ring = logRing();
+    LogLine* line;
+    while ((line = ring.peek()) != nullptr) {
+        Serial.write((const uint8_t*)line->text + ring.readOffset, line->length - ring.readOffset);
+        ring.release(*line);
+    }
+    logReportDropped(ring);
+}
+
+// Valeur secrète à journaliser : jamais son contenu
+inline const char* logSecret(const char* value) {
+    return value && value[0] ? "<masqué>" : "<vide>";
+}
+
+#define LOG_SECRET(value) logSecret(value)
+
+#if OAR_LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logWrite(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if OAR_LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logWrite(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if OAR_LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logWrite(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if OAR_LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logWrite(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#endif // LOG_H
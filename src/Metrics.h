@@ -0,0 +1,125 @@
+// Metrics.h - Durées des chemins critiques et niveaux bas du tas, publiés sur "device/metrics"
+// Chemins mesurés : lecture DHT, publication MQTT, reconnexion, association Wi-Fi, déchiffrement
+// SecureStorage et poignée de main TLS. Pour chacun : nombre, minimum, moyenne, maximum et
+// histogramme par décades (µs).
+// Activé par OAR_METRICS ; sans lui, les macros METRIC_* ne produisent aucun code.
+//
+// Les durées sont lues sur micros() (esp_timer, 1 µs) plutôt que sur le compteur de cycles du
+// CPU : celui-ci change de rythme avec la fréquence (40 MHz pendant les attentes en mode sommeil
+// léger) et reboucle après 18 s à 240 MHz, moins que certaines associations Wi-Fi.
+// Cumuls depuis le démarrage, jamais remis à zéro : chaque statistique n'a qu'un écrivain
+// (tâche capteur ou tâche réseau), le lecteur calcule les écarts entre deux publications.
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum MetricId {
+    METRIC_DHT_READ,          // dht.readHumidity() + dht.readTemperature()
+    METRIC_PUBLISH,           // client.publish()
+    METRIC_RECONNECT,         // reconnect() : TCP, TLS, CONNECT, souscriptions
+    METRIC_WIFI_JOIN,         // WiFi.begin() -> WL_CONNECTED (résolution : 1 ms)
+    METRIC_STORAGE_DECRYPT,   // SecureStorage::decryptData()
+    METRIC_TLS_HANDSHAKE,     // Poignée de main TLS réussie (résolution : 1 ms)
+    METRIC_COUNT
+};
+
+#ifdef OAR_METRICS
+
+// Bornes supérieures des classes de l'histogramme : < 100 µs, < 1 ms, < 10 ms, < 100 ms, < 1 s, le reste
+const size_t METRIC_BUCKETS = 6;
+
+inline const char* metricName(MetricId id) {
+    static const char* const names[METRIC_COUNT] = {
+        "dht_read", "publish", "reconnect", "wifi_join", "storage_decrypt", "tls_handshake"
+    };
+    return id < METRIC_COUNT ? names[id] : "?";
+}
+
+struct TimingStats {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+    uint32_t buckets[METRIC_BUCKETS];
+
+    void add(uint32_t us) {
+        if (count == 0 || us < minUs) {
+            minUs = us;
+        }
+        if (us > maxUs) {
+            maxUs = us;
+        }
+        count++;
+        totalUs += us;
+        size_t bucket = 0;
+        for (uint32_t bound = 100; bucket < METRIC_BUCKETS - 1 && us >= bound; bound *= 10) {
+            bucket++;
+        }
+        buckets[bucket]++;
+    }
+
+    uint32_t averageUs() const { return count ? (uint32_t)(totalUs / count) : 0; }
+};
+
+// Plus petit bloc libre maximal observé : la fragmentation fait échouer une allocation TLS
+// bien avant que le tas soit plein (le minimum du tas libre est suivi par l'allocateur)
+struct HeapWatermarks {
+    uint32_t minMaxBlock;
+    bool sampled;
+
+    void sample(uint32_t maxBlock) {
+        if (!sampled || maxBlock < minMaxBlock) {
+            minMaxBlock = maxBlock;
+        }
+        sampled = true;
+    }
+};
+
+struct MetricsRegistry {
+    TimingStats timings[METRIC_COUNT];
+    HeapWatermarks heap;
+};
+
+// Instance unique, mise à zéro au démarrage (pas de constructeur à exécuter)
+inline MetricsRegistry& metrics() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+inline void metricsRecord(MetricId id, uint32_t us) {
+    metrics().timings[id].add(us);
+}
+
+inline void metricsSampleHeap() {
+    metrics().heap.sample(ESP.getMaxAllocHeap());
+}
+
+// Mesure la durée de la portée où elle est déclarée
+class MetricScope {
+private:
+    MetricId id;
+    unsigned long start;
+
+public:
+    explicit MetricScope(MetricId id) : id(id), start(micros()) {}
+    ~MetricScope() { metricsRecord(id, micros() - start); }
+};
+
+#define METRIC_CONCAT_(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_(a, b)
+#define METRIC_SCOPE(id) MetricScope METRIC_CONCAT(metricScope, __LINE__)(id)
+#define METRIC_RECORD(id, us) metricsRecord(id, us)
+#define METRIC_HEAP() metricsSampleHeap()
+
+#else
+
+#define METRIC_SCOPE(id) do {} while (0)
+#define METRIC_RECORD(id, us) do {} while (0)
+#define METRIC_HEAP() do {} while (0)
+
+#endif // OAR_METRICS
+
+#endif // METRICS_H
@@ -0,0 +1,75 @@
+// MqttClient.h - Interface de la couche MQTT du firmware
+// Le firmware ne voit que cette interface : PubSubMqttClient garde PubSubClient (publication QoS 0
+// synchrone, écrite sur le transport TLS pendant l'appel) ; QueuedMqttClient (QueuedMqttClient.h)
+// dépose les messages dans une file et les écrit depuis loop(), en QoS 1 avec une fenêtre
+// d'envois non acquittés. Les codes de state() sont ceux de PubSubClient.
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include <PubSubClient.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Message reçu sur un topic souscrit (topic terminé par un zéro, contenu non terminé)
+typedef void (*MqttMessageHandler)(char* topic, uint8_t* payload, unsigned int length);
+
+class MqttClient {
+public:
+    virtual ~MqttClient() {}
+    virtual void setServer(const char* host, uint16_t port) = 0;
+    virtual void setCallback(MqttMessageHandler handler) = 0;
+    virtual void setKeepAlive(uint16_t seconds) = 0;
+    // Ouvrir la session (bloquant : poignée de main TLS et CONNACK)
+    virtual bool connect(const char* id, const char* user, const char* pass) = 0;
+    virtual void disconnect() = 0;
+    virtual bool connected() = 0;
+    // Servir la session : messages entrants, keepalive et, selon le client, messages en file
+    virtual bool loop() = 0;
+    virtual bool subscribe(const char* topic) = 0;
+    // Publier, ou déposer dans la file ; false si le message est refusé (session fermée,
+    // file pleine, paquet trop grand). qos est ignoré par les clients QoS 0.
+    virtual bool publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos) = 0;
+    virtual int state() = 0;
+    // Messages déposés pas encore écrits, et file vide (plus rien à écrire ni à acquitter)
+    virtual size_t pending() const = 0;
+    virtual bool idle() const = 0;
+
+    bool publish(const char* topic, const char* payload, uint8_t qos = 0) {
+        return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, qos);
+    }
+    bool publish(const char* topic, const uint8_t* payload, size_t length) {
+        return publish(topic, payload, length, 0);
+    }
+};
+
+// PubSubClient derrière l'interface : chaque publication part en QoS 0 pendant l'appel
+class PubSubMqttClient : public MqttClient {
+private:
+    PubSubClient& client;
+
+public:
+    explicit PubSubMqttClient(PubSubClient& pubSubClient) : client(pubSubClient) {}
+
+    void setServer(const char* host, uint16_t port) override { client.setServer(host, port); }
+    void setCallback(MqttMessageHandler handler) override { client.setCallback(handler); }
+    void setKeepAlive(uint16_t seconds) override { client.setKeepAlive(seconds); }
+    bool connect(const char* id, const char* user, const char* pass) override {
+        return client.connect(id, user, pass);
+    }
+    void disconnect() override { client.disconnect(); }
+    bool connected() override { return client.connected(); }
+    bool loop() override { return client.loop(); }
+    bool subscribe(const char* topic) override { return client.subscribe(topic); }
+    bool publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos) override {
+        (void)qos;
+        return client.publish(topic, payload, (unsigned int)length);
+    }
+    int state() override { return client.state(); }
+    size_t pending() const override { return 0; }
+    bool idle() const override { return true; }
+
+    using MqttClient::publish;
+};
+
+#endif // MQTT_CLIENT_H
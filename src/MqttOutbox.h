@@ -0,0 +1,244 @@
+// MqttOutbox.h - File des messages MQTT sortants et fenêtre des envois QoS 1 non acquittés
+// Le topic et le contenu de chaque message sont copiés à la suite dans un tampon circulaire ; une
+// table d'entrées garde l'ordre de dépôt. Les messages partent dans cet ordre. Un message QoS 1
+// garde son identifiant de paquet et reste dans la file jusqu'à son PUBACK ; au plus `window`
+// messages QoS 1 sont en vol à la fois (le broker acquitte dans l'ordre de réception, MQTT 3.1.1
+// 4.6). Quand la session est perdue, les messages en vol redeviennent en attente : ils repartent
+// en tête à la connexion suivante, avec le même identifiant et le drapeau DUP (MQTT 3.1.1 4.4).
+// Structure sans constructeur : une instance mise à zéro est une file vide, ce qui permet de la
+// placer en mémoire RTC (RTC_DATA_ATTR) pour garder les messages non acquittés pendant le sommeil
+// profond.
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Drapeaux d'une entrée
+const uint8_t OUTBOX_QOS1 = 0x01;   // Attend un PUBACK
+const uint8_t OUTBOX_SENT = 0x02;   // Écrit sur la session courante
+const uint8_t OUTBOX_DONE = 0x04;   // Acquitté (ou QoS 0 envoyé) : retiré quand il arrive en tête
+const uint8_t OUTBOX_DUP = 0x08;    // Déjà envoyé sur une session précédente
+
+struct MqttOutboxEntry {
+    uint16_t offset;          // Début du topic dans le tampon, suivi du contenu
+    uint16_t topicLength;
+    uint16_t payloadLength;
+    uint16_t packetId;        // QoS 1 : identifiant attribué au dépôt
+    uint8_t flags;
+    uint32_t queuedAt;        // Instant du dépôt (ms)
+    uint32_t sentAt;          // Instant du dernier envoi (ms)
+};
+
+struct MqttOutboxStats {
+    uint32_t queued;          // Messages déposés
+    uint32_t rejected;        // Messages refusés, file pleine
+    uint32_t sent;            // Paquets PUBLISH écrits, renvois compris
+    uint32_t retransmits;     // Renvois après une perte de session
+    uint32_t acked;           // PUBACK reçus
+    uint32_t ackTotalMs;      // Somme des délais dépôt -> PUBACK
+    uint32_t ackMaxMs;
+    uint16_t highWater;       // Occupation maximale de la table (entrées)
+};
+
+template <size_t Capacity, size_t Slots>
+struct MqttOutbox {
+    static_assert(Capacity <= 65535, "Tampon de la file limité à 64 Ko (offsets sur 16 bits)");
+
+    MqttOutboxEntry entries[Slots];
+    uint8_t data[Capacity];
+    uint16_t first;           // Index de l'entrée la plus ancienne
+    uint16_t count;           // Entrées dans la file
+    uint16_t lastPacketId;
+    MqttOutboxStats stats;
+
+    // Remettre la file dans un état cohérent (mémoire RTC non initialisée ou corrompue)
+    void sanitize() {
+        bool valid = first < Slots && count <= Slots;
+        for (size_t i = 0; valid && i < count; i++) {
+            const MqttOutboxEntry& entry = at(i);
+            valid = entry.topicLength > 0 &&
+                    (size_t)entry.offset + entry.topicLength + entry.payloadLength <= Capacity;
+        }
+        if (!valid) {
+            first = 0;
+            count = 0;
+        }
+    }
+
+    MqttOutboxEntry& at(size_t index) { return entries[(first + index) % Slots]; }
+    const MqttOutboxEntry& at(size_t index) const { return entries[(first + index) % Slots]; }
+    const char* topic(const MqttOutboxEntry& entry) const { return (const char*)data + entry.offset; }
+    const uint8_t* payload(const MqttOutboxEntry& entry) const {
+        return data + entry.offset + entry.topicLength;
+    }
+
+    // Méthode pour attribuer un identifiant de paquet libre (jamais 0, absent de la file)
+    uint16_t allocatePacketId() {
+        for (;;) {
+            if (++lastPacketId == 0) {
+                lastPacketId = 1;
+            }
+            bool used = false;
+            for (size_t i = 0; i < count && !used; i++) {
+                used = (at(i).flags & OUTBOX_QOS1) && at(i).packetId == lastPacketId;
+            }
+            if (!used) {
+                return lastPacketId;
+            }
+        }
+    }
+
+    // Emplacement de length octets contigus dans le tampon, -1 s'il n'y en a pas
+    int32_t allocate(size_t length) const {
+        if (count == 0) {
+            return length <= Capacity ? 0 : -1;
+        }
+        const MqttOutboxEntry& oldest = at(0);
+        const MqttOutboxEntry& newest = at(count - 1);
+        size_t start = oldest.offset;
+        size_t end = (size_t)newest.offset + newest.topicLength + newest.payloadLength;
+        if (newest.offset >= oldest.offset) {
+            // Occupé de start à end : place à la suite, sinon au début du tampon
+            if (end + length <= Capacity) {
+                return end;
+            }
+            return length <= start ? 0 : -1;
+        }
+        // Occupé de start à la fin puis du début à end
+        return end + length <= start ? (int32_t)end : -1;
+    }
+
+    // Méthode pour déposer un message ; false si la file est pleine (rien n'est copié)
+    bool push(const char* topicName, const uint8_t* content, size_t length, bool qos1, uint32_t now) {
+        size_t topicLength = strlen(topicName);
+        int32_t offset = count < Slots && topicLength > 0 ? allocate(topicLength + length) : -1;
+        if (offset < 0) {
+            stats.rejected++;
+            return false;
+        }
+        MqttOutboxEntry& entry = entries[(first + count) % Slots];
+        entry.offset = (uint16_t)offset;
+        entry.topicLength = (uint16_t)topicLength;
+        entry.payloadLength = (uint16_t)length;
+        entry.packetId = qos1 ? allocatePacketId() : 0;
+        entry.flags = qos1 ? OUTBOX_QOS1 : 0;
+        entry.queuedAt = now;
+        entry.sentAt = 0;
+        memcpy(data + offset, topicName, topicLength);
+        if (length > 0) {
+            memcpy(data + offset + topicLength, content, length);
+        }
+        count++;
+        stats.queued++;
+        if (count > stats.highWater) {
+            stats.highWater = count;
+        }
+        return true;
+    }
+
+    // Méthode pour trouver le prochain message à écrire ; nullptr si tout est parti ou si la
+    // fenêtre QoS 1 est pleine (l'ordre de dépôt est conservé)
+    MqttOutboxEntry* nextToSend(size_t window) {
+        size_t inFlight = 0;
+        for (size_t i = 0; i < count; i++) {
+            MqttOutboxEntry& entry = at(i);
+            if (entry.flags & OUTBOX_SENT) {
+                inFlight += (entry.flags & (OUTBOX_QOS1 | OUTBOX_DONE)) == OUTBOX_QOS1;
+                continue;
+            }
+            if ((entry.flags & OUTBOX_QOS1) && inFlight >= window) {
+                return nullptr;
+            }
+            return &entry;
+        }
+        return nullptr;
+    }
+
+    // Méthode pour noter l'écriture d'un message : un QoS 0 est terminé, un QoS 1 attend son PUBACK
+    void markSent(MqttOutboxEntry& entry, uint32_t now) {
+        if (entry.flags & OUTBOX_DUP) {
+            stats.retransmits++;
+        }
+        entry.flags |= OUTBOX_SENT;
+        if (!(entry.flags & OUTBOX_QOS1)) {
+            entry.flags |= OUTBOX_DONE;
+        }
+        entry.sentAt = now;
+        stats.sent++;
+        collect();
+    }
+
+    // Méthode pour traiter un PUBACK ; false si l'identifiant n'est pas en vol
+    bool acknowledge(uint16_t packetId, uint32_t now) {
+        for (size_t i = 0; i < count; i++) {
+            MqttOutboxEntry& entry = at(i);
+            if ((entry.flags & (OUTBOX_QOS1 | OUTBOX_SENT | OUTBOX_DONE)) == (OUTBOX_QOS1 | OUTBOX_SENT) &&
+                entry.packetId == packetId) {
+                entry.flags |= OUTBOX_DONE;
+                uint32_t latency = now - entry.queuedAt;
+                stats.acked++;
+                stats.ackTotalMs += latency;
+                if (latency > stats.ackMaxMs) {
+                    stats.ackMaxMs = latency;
+                }
+                collect();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Méthode pour remettre en attente les messages en vol (session perdue ou fermée)
+    void requeueInFlight() {
+        for (size_t i = 0; i < count; i++) {
+            MqttOutboxEntry& entry = at(i);
+            if ((entry.flags & (OUTBOX_SENT | OUTBOX_DONE)) == OUTBOX_SENT) {
+                entry.flags = (entry.flags & ~OUTBOX_SENT) | OUTBOX_DUP;
+            }
+        }
+    }
+
+    // Plus ancien message QoS 1 en vol (délai d'acquittement), nullptr s'il n'y en a pas
+    const MqttOutboxEntry* oldestInFlight() const {
+        for (size_t i = 0; i < count; i++) {
+            const MqttOutboxEntry& entry = at(i);
+            if ((entry.flags & (OUTBOX_SENT | OUTBOX_DONE)) == OUTBOX_SENT) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // Messages pas encore écrits sur la session courante
+    size_t pending() const {
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            n += !(at(i).flags & OUTBOX_SENT);
+        }
+        return n;
+    }
+
+    // Messages QoS 1 écrits, en attente de leur PUBACK
+    size_t inFlight() const {
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            n += (at(i).flags & (OUTBOX_SENT | OUTBOX_DONE)) == OUTBOX_SENT;
+        }
+        return n;
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    // Retirer de la tête les messages terminés
+    void collect() {
+        while (count > 0 && (at(0).flags & OUTBOX_DONE)) {
+            first = (first + 1) % Slots;
+            count--;
+        }
+    }
+};
+
+#endif // MQTT_OUTBOX_H
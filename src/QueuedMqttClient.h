@@ -0,0 +1,390 @@
+// QueuedMqttClient.h - Client MQTT 3.1.1 à file d'envoi et fenêtre QoS 1, sur un transport Client
+// publish() ne fait que copier le message dans la file (MqttOutbox.h) : l'appelant ne touche
+// jamais le transport. Les messages sont écrits depuis loop(), dans l'ordre de dépôt, un paquet
+// par write() (un enregistrement TLS) et au plus sendBudget octets par appel, tant que la fenêtre
+// QoS 1 n'est pas pleine ; les PUBACK la font avancer. Session perdue : les messages en vol
+// repartent à la connexion suivante (CleanSession = 0, drapeau DUP, mêmes identifiants) ; un
+// PUBACK qui n'arrive pas en ackTimeoutMs ferme la session pour provoquer ces renvois.
+// Seule la connexion (poignée de main TLS, CONNACK) bloque, comme avec PubSubClient.
+// Horodatage des messages par la fonction clock : une horloge qui continue pendant le sommeil
+// profond (file en mémoire RTC) garde des délais d'acquittement justes.
+// Les messages entrants sont lus en QoS 0 ou 1 (PUBACK renvoyé), dans un tampon de PacketSize
+// octets ; au-delà, ils sont ignorés.
+#ifndef QUEUED_MQTT_CLIENT_H
+#define QUEUED_MQTT_CLIENT_H
+
+#include <Arduino.h>
+#include "MqttClient.h"
+#include "MqttOutbox.h"
+
+// Paramètres de la session et de l'envoi
+struct QueuedMqttConfig {
+    uint8_t window;             // Messages QoS 1 en vol au plus (1 : un PUBACK avant chaque envoi)
+    uint32_t ackTimeoutMs;      // Délai maximal d'un PUBACK avant de fermer la session
+    uint16_t sendBudget;        // Octets écrits au plus par loop() (au moins un paquet)
+    uint32_t connectTimeoutMs;  // Attente du CONNACK
+};
+
+template <size_t Capacity, size_t Slots, size_t PacketSize = 512>
+class QueuedMqttClient : public MqttClient {
+public:
+    typedef MqttOutbox<Capacity, Slots> Outbox;
+    typedef unsigned long (*Clock)();
+
+private:
+    // Types de paquets (octet d'en-tête fixe, sans les drapeaux)
+    static const uint8_t CONNECT = 0x10;
+    static const uint8_t CONNACK = 0x20;
+    static const uint8_t PUBLISH = 0x30;
+    static const uint8_t PUBACK = 0x40;
+    static const uint8_t SUBSCRIBE = 0x82;
+    static const uint8_t PINGREQ = 0xC0;
+    static const uint8_t PINGRESP = 0xD0;
+    static const uint8_t DISCONNECT = 0xE0;
+    static const size_t HEADER_MAX = 5;   // Octet de type et longueur restante sur 4 octets au plus
+
+    // Lecture d'un paquet entrant, octet par octet
+    enum RxStage { RX_TYPE, RX_LENGTH, RX_BODY };
+
+    Client& transport;
+    Outbox& outbox;
+    Clock clock;
+    QueuedMqttConfig config;
+    const char* host;
+    uint16_t port;
+    uint16_t keepAliveSeconds;
+    MqttMessageHandler handler;
+    int currentState;
+    unsigned long lastOutAt;      // Dernier paquet écrit (keepalive)
+    unsigned long pingSentAt;
+    bool pingOutstanding;
+    bool connackReceived;
+    uint8_t connackCode;
+
+    uint8_t rxStage;
+    uint8_t rxType;
+    uint32_t rxLength;
+    uint32_t rxMultiplier;
+    uint32_t rxFill;
+    uint8_t rx[PacketSize + 1];   // Un octet de plus pour terminer le topic
+    uint8_t tx[PacketSize];
+
+    // Méthode pour écrire l'en-tête fixe ; renvoie sa longueur
+    static size_t writeHeader(uint8_t* out, uint8_t type, size_t remaining) {
+        size_t len = 0;
+        out[len++] = type;
+        do {
+            uint8_t digit = remaining % 128;
+            remaining /= 128;
+            out[len++] = remaining > 0 ? digit | 0x80 : digit;
+        } while (remaining > 0);
+        return len;
+    }
+
+    static size_t writeString(uint8_t* out, const char* text, size_t length) {
+        out[0] = length >> 8;
+        out[1] = length & 0xFF;
+        memcpy(out + 2, text, length);
+        return 2 + length;
+    }
+
+    // Taille d'un paquet : en-tête fixe placé à la fin de la réserve HEADER_MAX, décalé ensuite
+    size_t finishPacket(uint8_t type, size_t bodyLength) {
+        uint8_t header[HEADER_MAX];
+        size_t headerLength = writeHeader(header, type, bodyLength);
+        memmove(tx + headerLength, tx + HEADER_MAX, bodyLength);
+        memcpy(tx, header, headerLength);
+        return headerLength + bodyLength;
+    }
+
+    bool writePacket(size_t length) {
+        if (transport.write(tx, length) != length) {
+            loseSession();
+            return false;
+        }
+        lastOutAt = millis();
+        return true;
+    }
+
+    bool writeShort(uint8_t type, uint16_t packetId, bool withId) {
+        tx[0] = type;
+        tx[1] = withId ? 2 : 0;
+        tx[2] = packetId >> 8;
+        tx[3] = packetId & 0xFF;
+        return writePacket(withId ? 4 : 2);
+    }
+
+    void loseSession() {
+        transport.stop();
+        currentState = MQTT_CONNECTION_LOST;
+        outbox.requeueInFlight();
+        rxStage = RX_TYPE;
+    }
+
+    // Méthode pour traiter un paquet complet reçu
+    void dispatch() {
+        uint8_t type = rxType & 0xF0;
+        if (type == CONNACK && rxLength >= 2) {
+            connackReceived = true;
+            connackCode = rx[1];
+        } else if (type == PUBACK && rxLength >= 2) {
+            outbox.acknowledge((rx[0] << 8) | rx[1], clock());
+        } else if (type == PINGRESP) {
+            pingOutstanding = false;
+        } else if (type == PUBLISH && rxLength >= 2) {
+            uint8_t qos = (rxType >> 1) & 0x03;
+            size_t topicLength = (rx[0] << 8) | rx[1];
+            size_t offset = 2 + topicLength + (qos ? 2 : 0);
+            if (offset > rxLength) {
+                return;
+            }
+            uint16_t packetId = qos ? (rx[2 + topicLength] << 8) | rx[3 + topicLength] : 0;
+            // Topic décalé d'un octet pour le terminer par un zéro, comme PubSubClient
+            memmove(rx + 1, rx + 2, topicLength);
+            rx[1 + topicLength] = '\0';
+            if (handler) {
+                handler((char*)rx + 1, rx + offset, rxLength - offset);
+            }
+            if (qos == 1) {
+                writeShort(PUBACK, packetId, true);
+            }
+        }
+    }
+
+    // Méthode pour lire les octets disponibles sans attendre
+    void receive() {
+        uint8_t chunk[64];
+        int available;
+        while (currentState == MQTT_CONNECTED && (available = transport.available()) > 0) {
+            int n = transport.read(chunk, (size_t)available < sizeof(chunk) ? available : sizeof(chunk));
+            if (n <= 0) {
+                break;
+            }
+            for (int i = 0; i < n; i++) {
+                feed(chunk[i]);
+            }
+        }
+    }
+
+    void feed(uint8_t byte) {
+        if (rxStage == RX_TYPE) {
+            rxType = byte;
+            rxLength = 0;
+            rxMultiplier = 1;
+            rxStage = RX_LENGTH;
+        } else if (rxStage == RX_LENGTH) {
+            rxLength += (byte & 0x7F) * rxMultiplier;
+            rxMultiplier *= 128;
+            if (byte & 0x80) {
+                if (rxMultiplier > 128UL * 128 * 128) {
+                    loseSession();  // Longueur sur plus de 4 octets : flux corrompu
+                }
+                return;
+            }
+            rxFill = 0;
+            rxStage = RX_BODY;
+            if (rxLength == 0) {
+                dispatch();
+                rxStage = RX_TYPE;
+            }
+        } else {
+            if (rxFill < PacketSize) {
+                rx[rxFill] = byte;
+            }
+            rxFill++;
+            if (rxFill == rxLength) {
+                if (rxLength <= PacketSize) {
+                    dispatch();   // Sinon, paquet trop grand ignoré
+                }
+                rxStage = RX_TYPE;
+            }
+        }
+    }
+
+    // Méthode pour écrire les messages en attente, dans la limite de la fenêtre et du budget
+    void flush() {
+        size_t written = 0;
+        MqttOutboxEntry* entry;
+        while (written < config.sendBudget && (entry = outbox.nextToSend(config.window)) != nullptr) {
+            bool qos1 = entry->flags & OUTBOX_QOS1;
+            uint8_t* body = tx + HEADER_MAX;
+            size_t len = writeString(body, outbox.topic(*entry), entry->topicLength);
+            if (qos1) {
+                body[len++] = entry->packetId >> 8;
+                body[len++] = entry->packetId & 0xFF;
+            }
+            memcpy(body + len, outbox.payload(*entry), entry->payloadLength);
+            len += entry->payloadLength;
+            uint8_t type = PUBLISH | (qos1 ? 0x02 : 0) | ((entry->flags & OUTBOX_DUP) ? 0x08 : 0);
+            size_t packetLength = finishPacket(type, len);
+            if (!writePacket(packetLength)) {
+                return;
+            }
+            outbox.markSent(*entry, clock());
+            written += packetLength;
+        }
+    }
+
+public:
+    QueuedMqttClient(Client& client, Outbox& messages, const QueuedMqttConfig& settings, Clock now = millis)
+        : transport(client), outbox(messages), clock(now), config(settings), host(nullptr), port(0),
+          keepAliveSeconds(15), handler(nullptr), currentState(MQTT_DISCONNECTED), lastOutAt(0),
+          pingSentAt(0), pingOutstanding(false), connackReceived(false), connackCode(0),
+          rxStage(RX_TYPE), rxType(0), rxLength(0), rxMultiplier(1), rxFill(0) {}
+
+    void setServer(const char* domain, uint16_t serverPort) override {
+        host = domain;
+        port = serverPort;
+    }
+    void setCallback(MqttMessageHandler callback) override { handler = callback; }
+    void setKeepAlive(uint16_t seconds) override { keepAliveSeconds = seconds; }
+    // Changer la fenêtre QoS 1 (1 à Slots)
+    void setWindow(uint8_t window) { config.window = window ? window : 1; }
+    const MqttOutboxStats& stats() const { return outbox.stats; }
+    size_t inFlight() const { return outbox.inFlight(); }
+
+    bool connect(const char* id, const char* user, const char* pass) override {
+        transport.stop();
+        outbox.requeueInFlight();
+        rxStage = RX_TYPE;
+        if (!host || !transport.connect(host, port)) {
+            currentState = MQTT_CONNECT_FAILED;
+            return false;
+        }
+
+        // CONNECT : protocole "MQTT" niveau 4, session conservée pour les renvois QoS 1
+        size_t idLength = strlen(id);
+        size_t userLength = user ? strlen(user) : 0;
+        size_t passLength = pass ? strlen(pass) : 0;
+        if (HEADER_MAX + 10 + 2 + idLength + 2 + userLength + 2 + passLength > PacketSize) {
+            transport.stop();
+            currentState = MQTT_CONNECT_FAILED;
+            return false;
+        }
+        uint8_t* body = tx + HEADER_MAX;
+        size_t len = writeString(body, "MQTT", 4);
+        body[len++] = 4;
+        body[len++] = (user ? 0x80 : 0) | (pass ? 0x40 : 0);
+        body[len++] = keepAliveSeconds >> 8;
+        body[len++] = keepAliveSeconds & 0xFF;
+        len += writeString(body + len, id, idLength);
+        if (user) {
+            len += writeString(body + len, user, userLength);
+        }
+        if (pass) {
+            len += writeString(body + len, pass, passLength);
+        }
+        currentState = MQTT_CONNECTED;   // Lecture du CONNACK par receive()
+        if (!writePacket(finishPacket(CONNECT, len))) {
+            currentState = MQTT_CONNECT_FAILED;
+            return false;
+        }
+
+        connackReceived = false;
+        unsigned long start = millis();
+        while (!connackReceived && currentState == MQTT_CONNECTED) {
+            if (millis() - start >= config.connectTimeoutMs) {
+                transport.stop();
+                currentState = MQTT_CONNECTION_TIMEOUT;
+                return false;
+            }
+            if (transport.available() > 0) {
+                receive();
+            } else {
+                delay(1);
+            }
+        }
+        if (!connackReceived || connackCode != 0) {
+            transport.stop();
+            currentState = connackReceived ? connackCode : MQTT_CONNECTION_LOST;
+            return false;
+        }
+        pingOutstanding = false;
+        return true;
+    }
+
+    void disconnect() override {
+        if (currentState == MQTT_CONNECTED) {
+            writeShort(DISCONNECT, 0, false);
+        }
+        transport.stop();
+        outbox.requeueInFlight();
+        currentState = MQTT_DISCONNECTED;
+    }
+
+    bool connected() override {
+        if (currentState != MQTT_CONNECTED) {
+            return false;
+        }
+        if (!transport.connected()) {
+            loseSession();
+            return false;
+        }
+        return true;
+    }
+
+    bool loop() override {
+        if (!connected()) {
+            return false;
+        }
+        receive();
+        if (currentState != MQTT_CONNECTED) {
+            return false;
+        }
+
+        unsigned long now = millis();
+        if (keepAliveSeconds) {
+            unsigned long keepAliveMs = keepAliveSeconds * 1000UL;
+            if (pingOutstanding && now - pingSentAt >= keepAliveMs) {
+                loseSession();  // Pas de PINGRESP : broker ou lien muet
+                return false;
+            }
+            if (!pingOutstanding && now - lastOutAt > keepAliveMs) {
+                if (!writeShort(PINGREQ, 0, false)) {
+                    return false;
+                }
+                pingOutstanding = true;
+                pingSentAt = now;
+            }
+        }
+        const MqttOutboxEntry* oldest = outbox.oldestInFlight();
+        if (oldest && (uint32_t)(clock() - oldest->sentAt) >= config.ackTimeoutMs) {
+            loseSession();  // Les messages en vol repartiront sur la session suivante
+            return false;
+        }
+
+        flush();
+        return currentState == MQTT_CONNECTED;
+    }
+
+    bool subscribe(const char* topic) override {
+        size_t topicLength = strlen(topic);
+        if (!connected() || HEADER_MAX + 2 + 2 + topicLength + 1 > PacketSize) {
+            return false;
+        }
+        uint8_t* body = tx + HEADER_MAX;
+        uint16_t packetId = outbox.allocatePacketId();
+        body[0] = packetId >> 8;
+        body[1] = packetId & 0xFF;
+        size_t len = 2 + writeString(body + 2, topic, topicLength);
+        body[len++] = 0;   // QoS 0 demandée
+        return writePacket(finishPacket(SUBSCRIBE, len));
+    }
+
+    bool publish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos) override {
+        // Comme PubSubClient : le paquet entier doit tenir dans le tampon
+        if (HEADER_MAX + 2 + strlen(topic) + 2 + length > PacketSize) {
+            outbox.stats.rejected++;
+            return false;
+        }
+        return outbox.push(topic, payload, length, qos > 0, clock());
+    }
+
+    int state() override { return currentState; }
+    size_t pending() const override { return outbox.pending(); }
+    bool idle() const override { return outbox.empty(); }
+
+    using MqttClient::publish;
+};
+
+#endif // QUEUED_MQTT_CLIENT_H
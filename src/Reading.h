@@ -0,0 +1,16 @@
+// Reading.h - Mesure horodatée échangée entre la tâche capteur et la tâche réseau
+#ifndef READING_H
+#define READING_H
+
+#include <stdint.h>
+
+struct Reading {
+    uint32_t timestamp;   // Temps depuis le démarrage à froid (uptimeMs()) au moment de la lecture
+    uint32_t seq;         // Numéro de séquence, incrémenté à chaque mesure à publier
+                          // (un trou signale une perte, pas une mesure filtrée par la bande morte)
+    float temperature;    // °C
+    float humidity;       // %
+    uint8_t sensor;       // Index de la sonde dans la table des capteurs (0 : sonde historique)
+};
+
+#endif // READING_H
@@ -0,0 +1,105 @@
+// ReconnectBackoff.h - Espacement des tentatives de connexion au broker MQTT
+// Délai exponentiel plafonné, tiré au hasard entre la moitié du plafond courant et ce plafond :
+// après un redémarrage du broker, les cartes d'une flotte ne reviennent pas toutes au même instant,
+// et la moitié garantie évite qu'une série de tirages courts ouvre le disjoncteur en quelques
+// secondes.
+// Disjoncteur : après failuresToOpen échecs consécutifs, plus aucune tentative pendant openMs
+// (plus une gigue), puis une seule tentative d'essai (semi-ouvert) ; un succès le referme, un
+// échec le rouvre.
+// Structure sans constructeur : une instance mise à zéro est fermée, sans tentative programmée,
+// ce qui permet de la placer en mémoire RTC (RTC_DATA_ATTR) pour le sommeil profond.
+#ifndef RECONNECT_BACKOFF_H
+#define RECONNECT_BACKOFF_H
+
+#include <stdint.h>
+
+struct BackoffPolicy {
+    uint32_t initialMs;       // Plafond du premier délai
+    uint32_t maxMs;           // Plafond du délai exponentiel
+    uint16_t failuresToOpen;  // Échecs consécutifs avant l'ouverture du disjoncteur (0 : jamais)
+    uint32_t openMs;          // Durée d'ouverture du disjoncteur, avant gigue (jusqu'à +25 %)
+};
+
+enum BreakerState {
+    BREAKER_CLOSED,     // Tentatives espacées par le délai exponentiel
+    BREAKER_OPEN,       // Aucune tentative avant l'échéance
+    BREAKER_HALF_OPEN   // Tentative d'essai en cours
+};
+
+struct ReconnectBackoff {
+    uint32_t nextAttemptAt;  // Échéance de la prochaine tentative (ms)
+    uint32_t lastDelayMs;    // Dernier délai tiré
+    uint16_t failures;       // Échecs consécutifs depuis la dernière connexion réussie
+    uint8_t breaker;         // BreakerState
+    bool scheduled;          // Échéance programmée (sinon, tentative immédiate)
+    uint32_t attempts;       // Tentatives depuis le démarrage à froid
+    uint32_t successes;      // Connexions réussies
+    uint32_t breakerOpens;   // Ouvertures du disjoncteur
+
+    // Méthode pour savoir si une tentative peut partir
+    bool due(uint32_t now) const {
+        return !scheduled || (int32_t)(now - nextAttemptAt) >= 0;
+    }
+
+    // Durée restante avant la prochaine tentative (0 si elle peut partir)
+    uint32_t remaining(uint32_t now) const {
+        return due(now) ? 0 : nextAttemptAt - now;
+    }
+
+    // Une tentative part : à la fin de l'ouverture, c'est la tentative d'essai
+    void onAttempt() {
+        attempts++;
+        if (breaker == BREAKER_OPEN) {
+            breaker = BREAKER_HALF_OPEN;
+        }
+    }
+
+    void onSuccess() {
+        successes++;
+        failures = 0;
+        breaker = BREAKER_CLOSED;
+        scheduled = false;
+    }
+
+    // Méthode pour programmer la tentative suivante après un échec ; random : tirage propre à la
+    // carte (esp_random())
+    void onFailure(const BackoffPolicy& policy, uint32_t now, uint32_t random) {
+        if (failures < UINT16_MAX) {
+            failures++;
+        }
+        bool open = breaker == BREAKER_HALF_OPEN ||
+                    (breaker == BREAKER_CLOSED && policy.failuresToOpen && failures >= policy.failuresToOpen);
+        if (open) {
+            breaker = BREAKER_OPEN;
+            breakerOpens++;
+            schedule(now, policy.openMs + random % (policy.openMs / 4 + 1));
+        } else {
+            uint32_t limit = ceiling(policy);
+            schedule(now, limit / 2 + random % (limit - limit / 2 + 1));
+        }
+    }
+
+    // Session perdue alors qu'elle était ouverte : première tentative dans [0, initialMs]
+    void onDisconnect(const BackoffPolicy& policy, uint32_t now, uint32_t random) {
+        if (breaker == BREAKER_CLOSED) {
+            schedule(now, random % (policy.initialMs + 1));
+        }
+    }
+
+    // Plafond du délai après le nombre d'échecs courant : initialMs, doublé à chaque échec
+    uint32_t ceiling(const BackoffPolicy& policy) const {
+        uint32_t limit = policy.initialMs;
+        for (uint16_t i = 1; i < failures && limit < policy.maxMs; i++) {
+            limit *= 2;
+        }
+        return limit < policy.maxMs ? limit : policy.maxMs;
+    }
+
+    void schedule(uint32_t now, uint32_t delayMs) {
+        lastDelayMs = delayMs;
+        nextAttemptAt = now + delayMs;
+        scheduled = true;
+    }
+};
+
+#endif // RECONNECT_BACKOFF_H
@@ -0,0 +1,376 @@
+// ResumableTlsClient.h - Client TLS (mbedTLS sur WiFiClient) capable de reprendre une session
+// WiFiClientSecure refait une poignée de main complète à chaque connexion. Ce client propose au
+// broker la dernière session négociée (ticket ou identifiant de session) : une reprise évite
+// l'échange de certificats et la vérification de signature, soit l'essentiel du temps CPU.
+// Si le broker refuse la reprise, la poignée de main complète se fait dans le même échange.
+//
+// La cible hôte utilise host/shims/ResumableTlsClient.h, qui simule la même interface ; cet en-tête
+// y est seulement compilé (bibliothèque objet oar_device_headers).
+#ifndef RESUMABLE_TLS_CLIENT_H
+#define RESUMABLE_TLS_CLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <WiFiClient.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/version.h>
+#include <mbedtls/platform_util.h>
+#include <lwip/sockets.h>
+#include "TlsSession.h"
+#include "Metrics.h"
+
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+
+class ResumableTlsClient : public Client {
+private:
+    WiFiClient tcp;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_x509_crt ca;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+
+    const char* caCert = nullptr;
+    bool configured = false;     // conf, ca et drbg initialisés (une seule fois)
+    bool sslReady = false;       // ssl lié à conf (mbedtls_ssl_setup fait)
+    bool secured = false;        // Poignée de main terminée, connexion utilisable
+    int peeked = -1;             // Octet lu par peek() et pas encore rendu par read()
+
+    TlsSessionCache* cache = nullptr;
+    HandshakeStats stats = {};
+    unsigned long handshakeTimeoutMs = 10000;
+    unsigned long writeTimeoutMs = 5000;   // Attente maximale d'une socket pleine dans write()
+    unsigned long lastWriteAt = 0;  // Dernier envoi : sert à caler le keepalive MQTT
+
+    static const size_t MASTER_SIZE = 48;
+
+    // Entrées/sorties de mbedTLS sur la socket TCP, sans bloquer
+    static int bioSend(void* ctx, const unsigned char* buf, size_t len) {
+        WiFiClient* socket = static_cast<WiFiClient*>(ctx);
+        if (!socket->connected()) {
+            return MBEDTLS_ERR_NET_CONN_RESET;
+        }
+        size_t written = socket->write(buf, len);
+        return written > 0 ? (int)written : MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
+    static int bioRecv(void* ctx, unsigned char* buf, size_t len) {
+        WiFiClient* socket = static_cast<WiFiClient*>(ctx);
+        if (socket->available() <= 0) {
+            return socket->connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+        }
+        int received = socket->read(buf, len);
+        return received > 0 ? received : MBEDTLS_ERR_SSL_WANT_READ;
+    }
+
+    // Méthode pour préparer la configuration TLS (une fois pour toute la vie du client)
+    bool configure() {
+        if (configured) {
+            return true;
+        }
+        mbedtls_ssl_config_init(&conf);
+        mbedtls_x509_crt_init(&ca);
+        mbedtls_entropy_init(&entropy);
+        mbedtls_ctr_drbg_init(&drbg);
+        configured = true;
+
+        if (mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, NULL, 0) != 0 ||
+            mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                        MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+            return false;
+        }
+        if (caCert) {
+            // strlen + 1 : mbedTLS exige le zéro final pour un certificat PEM
+            if (mbedtls_x509_crt_parse(&ca, (const unsigned char*)caCert, strlen(caCert) + 1) != 0) {
+                return false;
+            }
+            mbedtls_ssl_conf_ca_chain(&conf, &ca, NULL);
+            mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        } else {
+            mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+        }
+        mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+
+        // TLS 1.2 : les tickets y sont reçus pendant la poignée de main (en TLS 1.3, ils
+        // arrivent après, ce qui compliquerait leur sauvegarde)
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+        mbedtls_ssl_conf_max_tls_version(&conf, MBEDTLS_SSL_VERSION_TLS1_2);
+#else
+        mbedtls_ssl_conf_max_version(&conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+        mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+        return true;
+    }
+
+    // Méthode pour proposer la session en cache ; copie son secret maître dans offeredMaster
+    bool offerSession(const char* host, uint16_t port, unsigned char* offeredMaster) {
+        if (!cache || !cache->matches(host, port)) {
+            return false;
+        }
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+        bool offered = mbedtls_ssl_session_load(&session, cache->data, cache->length) == 0 &&
+                       mbedtls_ssl_set_session(&ssl, &session) == 0;
+        if (offered) {
+            memcpy(offeredMaster, session.MBEDTLS_PRIVATE(master), MASTER_SIZE);
+        } else {
+            // Session illisible (version de mbedTLS différente, RTC corrompue) : l'oublier
+            cache->clear();
+        }
+        mbedtls_ssl_session_free(&session);
+        return offered;
+    }
+
+    // Méthode pour sauvegarder la session négociée et savoir si le broker a repris celle proposée :
+    // une reprise garde le secret maître, une poignée complète en négocie un nouveau (valable
+    // pour les tickets comme pour les identifiants de session). mbedTLS 3 n'autorise qu'un seul
+    // mbedtls_ssl_get_session par connexion, d'où les deux rôles dans la même méthode.
+    bool saveSession(const char* host, uint16_t port, const unsigned char* offeredMaster) {
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+        bool resumed = false;
+        if (mbedtls_ssl_get_session(&ssl, &session) == 0) {
+            resumed = offeredMaster &&
+                      memcmp(session.MBEDTLS_PRIVATE(master), offeredMaster, MASTER_SIZE) == 0;
+            size_t len = 0;
+            if (cache && mbedtls_ssl_session_save(&session, cache->data, sizeof(cache->data), &len) == 0) {
+                cache->store(host, port, cache->data, len);
+            } else if (cache) {
+                cache->clear();
+            }
+        }
+        mbedtls_ssl_session_free(&session);
+        return resumed;
+    }
+
+    // Méthode pour établir la session TLS sur la connexion TCP qui vient d'être ouverte
+    int connectTls(const char* host, uint16_t port, bool tcpConnected) {
+        if (!configure() || !tcpConnected) {
+            stats.failed++;
+            tcp.stop();
+            return 0;
+        }
+
+        unsigned long start = millis();
+        if (!sslReady) {
+            mbedtls_ssl_init(&ssl);
+            if (mbedtls_ssl_setup(&ssl, &conf) != 0) {
+                mbedtls_ssl_free(&ssl);
+                stats.failed++;
+                tcp.stop();
+                return 0;
+            }
+            sslReady = true;
+        } else {
+            mbedtls_ssl_session_reset(&ssl);
+        }
+        mbedtls_ssl_set_hostname(&ssl, host);
+        mbedtls_ssl_set_bio(&ssl, &tcp, bioSend, bioRecv, NULL);
+
+        unsigned char offeredMaster[MASTER_SIZE];
+        bool offered = offerSession(host, port, offeredMaster);
+
+        int ret;
+        while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+            if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+                millis() - start > handshakeTimeoutMs) {
+                // La session proposée a peut-être provoqué l'échec : repartir d'une poignée complète
+                if (offered) {
+                    cache->clear();
+                }
+                mbedtls_platform_zeroize(offeredMaster, sizeof(offeredMaster));
+                stats.failed++;
+                tcp.stop();
+                return 0;
+            }
+            delay(1);
+        }
+
+        bool resumed = saveSession(host, port, offered ? offeredMaster : NULL);
+        mbedtls_platform_zeroize(offeredMaster, sizeof(offeredMaster));
+        stats.record(resumed, millis() - start);
+        METRIC_RECORD(METRIC_TLS_HANDSHAKE, (millis() - start) * 1000UL);
+        secured = true;
+        return 1;
+    }
+
+public:
+    ResumableTlsClient() {}
+
+    ~ResumableTlsClient() {
+        stop();
+        if (sslReady) {
+            mbedtls_ssl_free(&ssl);
+        }
+        if (configured) {
+            mbedtls_ssl_config_free(&conf);
+            mbedtls_x509_crt_free(&ca);
+            mbedtls_ctr_drbg_free(&drbg);
+            mbedtls_entropy_free(&entropy);
+        }
+    }
+
+    ResumableTlsClient(const ResumableTlsClient&) = delete;
+    ResumableTlsClient& operator=(const ResumableTlsClient&) = delete;
+
+    // Certificat de l'autorité qui a signé celui du broker (PEM, doit rester valide)
+    void setCACert(const char* rootCA) { caCert = rootCA; }
+
+    // Emplacement de la session à reprendre (en mémoire RTC pour survivre au sommeil profond)
+    void setSessionCache(TlsSessionCache* sessionCache) { cache = sessionCache; }
+
+    void setHandshakeTimeout(unsigned long ms) { handshakeTimeoutMs = ms; }
+    void setWriteTimeout(unsigned long ms) { writeTimeoutMs = ms; }
+
+    const HandshakeStats& handshakeStats() const { return stats; }
+    unsigned long lastWriteMs() const { return lastWriteAt; }
+
+    int connect(IPAddress ip, uint16_t port) {
+        stop();
+        bool tcpConnected = tcp.connect(ip, port);
+        return connectTls(ip.toString().c_str(), port, tcpConnected);
+    }
+
+    int connect(const char* host, uint16_t port) {
+        stop();
+        bool tcpConnected = tcp.connect(host, port);
+        return connectTls(host, port, tcpConnected);
+    }
+
+    int connect(IPAddress ip, uint16_t port, int32_t timeout) {
+        stop();
+        bool tcpConnected = tcp.connect(ip, port, timeout);
+        return connectTls(ip.toString().c_str(), port, tcpConnected);
+    }
+
+    int connect(const char* host, uint16_t port, int32_t timeout) {
+        stop();
+        bool tcpConnected = tcp.connect(host, port, timeout);
+        return connectTls(host, port, tcpConnected);
+    }
+
+    size_t write(uint8_t b) { return write(&b, 1); }
+
+    // Méthode pour envoyer tout le buffer : si la socket reste pleine plus de writeTimeoutMs
+    // (broker qui ne lit plus, lien coupé sans RST), la connexion est fermée plutôt que de bloquer
+    size_t write(const uint8_t* buf, size_t size) {
+        size_t sent = 0;
+        unsigned long progressAt = millis();
+        while (secured && sent < size) {
+            int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+            if (ret > 0) {
+                sent += ret;
+                lastWriteAt = progressAt = millis();
+            } else if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+                       millis() - progressAt > writeTimeoutMs) {
+                stop();
+            } else {
+                delay(1);
+            }
+        }
+        return sent;
+    }
+
+    int available() {
+        if (!secured) {
+            return 0;
+        }
+        if (peeked >= 0) {
+            return 1 + mbedtls_ssl_get_bytes_avail(&ssl);
+        }
+        // Lecture vide : fait avancer mbedTLS pour déchiffrer l'enregistrement suivant
+        int ret = mbedtls_ssl_read(&ssl, NULL, 0);
+        if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            stop();
+            return 0;
+        }
+        return mbedtls_ssl_get_bytes_avail(&ssl);
+    }
+
+    int read() {
+        uint8_t b;
+        return read(&b, 1) == 1 ? b : -1;
+    }
+
+    int read(uint8_t* buf, size_t size) {
+        if (!secured || size == 0) {
+            return -1;
+        }
+        size_t offset = 0;
+        if (peeked >= 0) {
+            buf[offset++] = (uint8_t)peeked;
+            peeked = -1;
+            if (offset == size) {
+                return offset;
+            }
+        }
+        int ret = mbedtls_ssl_read(&ssl, buf + offset, size - offset);
+        if (ret > 0) {
+            return offset + ret;
+        }
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            stop();
+        }
+        return offset ? (int)offset : -1;
+    }
+
+    int peek() {
+        if (peeked < 0) {
+            uint8_t b;
+            if (secured && mbedtls_ssl_read(&ssl, &b, 1) == 1) {
+                peeked = b;
+            }
+        }
+        return peeked;
+    }
+
+    // Méthode pour attendre des données du broker sans occuper le CPU : la tâche reste bloquée
+    // dans select(), ce qui laisse FreeRTOS passer en sommeil léger automatique
+    bool waitForData(unsigned long timeoutMs) {
+        if (peeked >= 0 || (secured && (mbedtls_ssl_get_bytes_avail(&ssl) > 0 || tcp.available() > 0))) {
+            return true;
+        }
+        int fd = secured ? tcp.fd() : -1;
+        if (fd < 0) {
+            delay(timeoutMs);
+            return false;
+        }
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        struct timeval timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_usec = (timeoutMs % 1000) * 1000;
+        return select(fd + 1, &readable, NULL, NULL, &timeout) > 0;
+    }
+
+    void flush() { tcp.flush(); }
+
+    void stop() {
+        if (secured) {
+            mbedtls_ssl_close_notify(&ssl);
+            secured = false;
+        }
+        peeked = -1;
+        tcp.stop();
+    }
+
+    uint8_t connected() {
+        if (secured && !tcp.connected() && tcp.available() <= 0) {
+            stop();
+        }
+        return secured;
+    }
+
+    operator bool() { return connected(); }
+};
+
+#endif // RESUMABLE_TLS_CLIENT_H
@@ -0,0 +1,56 @@
+// RingBuffer.h - File circulaire sans verrou, un seul producteur et un seul consommateur
+// Le producteur (tâche capteur) et le consommateur (tâche réseau) peuvent tourner sur deux cœurs
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, size_t N>
+class SpscRing {
+private:
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "La capacité doit être une puissance de 2");
+
+    T slots[N];
+    // Index libres de déborder : head - tail donne le nombre d'éléments présents
+    std::atomic<uint32_t> head;     // Écrit uniquement par le producteur
+    std::atomic<uint32_t> tail;     // Écrit uniquement par le consommateur
+    std::atomic<uint32_t> dropped;  // Éléments refusés car la file était pleine
+
+public:
+    SpscRing() : head(0), tail(0), dropped(0) {}
+
+    // Côté producteur : ajouter un élément, false si la file est pleine
+    bool push(const T& value) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == N) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[h & (N - 1)] = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Côté consommateur : retirer l'élément le plus ancien, false si la file est vide
+    bool pop(T& value) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t) {
+            return false;
+        }
+        value = slots[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Nombre d'éléments présents (valeur indicative si l'autre côté est actif)
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return N; }
+    uint32_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+#endif // RING_BUFFER_H
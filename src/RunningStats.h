@@ -0,0 +1,55 @@
+// RunningStats.h - Statistiques d'une fenêtre de mesures en mémoire constante
+// Nombre, minimum, maximum, moyenne et variance mis à jour à chaque valeur (algorithme de
+// Welford : pas de somme des carrés, donc pas de perte de précision sur des valeurs proches).
+// Structures sans constructeur : une instance mise à zéro est une fenêtre vide.
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <stdint.h>
+#include <math.h>
+
+struct RunningStats {
+    uint32_t count;
+    float min;
+    float max;
+    float mean;
+    float m2;       // Somme des carrés des écarts à la moyenne
+
+    void add(float value) {
+        count++;
+        if (count == 1) {
+            min = value;
+            max = value;
+        } else if (value < min) {
+            min = value;
+        } else if (value > max) {
+            max = value;
+        }
+        float delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+
+    // Variance de l'échantillon (n - 1), nulle pour moins de deux valeurs
+    float variance() const { return count > 1 ? m2 / (count - 1) : 0.0f; }
+    float stddev() const { return sqrtf(variance()); }
+
+    void reset() {
+        count = 0;
+        min = 0;
+        max = 0;
+        mean = 0;
+        m2 = 0;
+    }
+};
+
+// Résumé d'une fenêtre, transmis de la tâche capteur à la tâche réseau
+struct WindowSummary {
+    uint32_t start;           // Début de la fenêtre (temps depuis le démarrage à froid, ms)
+    uint32_t duration;        // Durée couverte (ms)
+    RunningStats temperature; // °C
+    RunningStats humidity;    // %
+    uint8_t sensor;           // Index de la sonde dans la table des capteurs
+};
+
+#endif // RUNNING_STATS_H
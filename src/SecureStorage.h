@@ -16,58 +16,202 @@
 #include <Preferences.h>
 #include <mbedtls/aes.h>
 #include <mbedtls/gcm.h>
+#include <mbedtls/md.h>
+#include <mbedtls/platform_util.h>
 #include <esp_wifi.h>
 #include <esp_efuse.h>
+#include "Metrics.h"
+
+// Champ à lire lors d'une récupération groupée (chaîne ou entier)
+struct SecretField {
+    const char* key;
+    char* value;        // Buffer de la chaîne (nullptr pour un entier)
+    size_t value_size;  // Taille du buffer de la chaîne
+    int* number;        // Destination de l'entier (nullptr pour une chaîne)
+};
+
+// Valeur à écrire lors d'un stockage groupé (chaîne ou entier)
+struct SecretValue {
+    const char* key;
+    const char* value;  // Chaîne à chiffrer (nullptr pour un entier)
+    int number;         // Entier à chiffrer si value est nullptr
+};
+
+// Clé de chiffrement : HKDF-SHA256 (RFC 5869) sur la MAC de base de la carte, lue dans les eFuses
+// (disponible avant l'initialisation du Wi-Fi). La MAC n'est pas un secret : compiler avec
+// OAR_EFUSE_KEY_BLOCK=EFUSE_BLK3 (par exemple) ajoute un secret de 24 octets programmé dans ce
+// bloc. Un bloc vierge fait alors échouer la dérivation plutôt que de revenir à la MAC seule.
+// La clé n'est calculée qu'au premier chiffrement ou déchiffrement, puis conservée.
+// Les enregistrements des premiers firmwares restent lisibles tant que la configuration n'a pas été
+// migrée (bundle version 2, marqueur "migrated") : ils sont réécrits avec la nouvelle clé à la
+// première lecture. Une fois le marqueur posé, l'ancienne clé n'est plus jamais essayée.
+
+// Configuration complète de la carte, stockée en un seul enregistrement chiffré
+struct DeviceConfig {
+    char wifi_ssid[64];
+    char wifi_pass[64];
+    char mqtt_server[64];
+    uint16_t mqtt_port;
+    char mqtt_user[64];
+    char mqtt_pass[64];
+};
 
 class SecureStorage {
 private:
     // Espace de noms pour les préférences NVS
     Preferences preferences;
+    // Session ouverte par beginSession() : l'espace de noms reste ouvert entre les appels
+    bool sessionOpen = false;
+    bool sessionReadOnly = true;
     // Taille de la clé AES-GCM (256 bits = 32 octets)
     static const size_t KEY_SIZE = 32;
     // Taille du tag d'authentification
     static const size_t TAG_SIZE = 16;
     // Taille du nonce
     static const size_t NONCE_SIZE = 12;
-    // Clé dérivée de l'adresse MAC
+    // Taille maximale d'un secret : les buffers de chiffrement restent sur la pile,
+    // aucun appel de store*/retrieve* n'alloue sur le tas
+    static const size_t MAX_SECRET_SIZE = 128;
+    static const size_t MAX_RECORD_SIZE = NONCE_SIZE + MAX_SECRET_SIZE + TAG_SIZE;
+    // Nombre maximal de valeurs d'un storeBatch : les anciens enregistrements sont copiés sur la
+    // pile (6 x 156 octets) pour être restaurés si une écriture échoue
+    static const size_t MAX_BATCH_SIZE = 6;
+    
+    // Enregistrement groupé de la configuration (clé NVS "config") :
+    //   en-tête en clair (magic "OC", version, réservé) | nonce | champs chiffrés | tag
+    // L'en-tête est authentifié comme données associées du GCM.
+    // Champs : suite de (type, longueur, valeur), les types inconnus sont ignorés.
+    static constexpr const char* BUNDLE_KEY = "config";
+    static const uint8_t BUNDLE_MAGIC_0 = 'O';
+    static const uint8_t BUNDLE_MAGIC_1 = 'C';
+    static const uint8_t BUNDLE_VERSION = 2;              // Chiffré avec la clé HKDF
+    static const uint8_t BUNDLE_VERSION_LEGACY_KEY = 1;   // Chiffré avec la clé des premiers firmwares
+    static const size_t BUNDLE_HEADER_SIZE = 4;
+    // Marqueur en clair posé avec le premier bundle version 2 : les premiers firmwares ne stockaient
+    // que les identifiants, convertis en bundle, il ne reste alors plus d'enregistrement à l'ancienne clé
+    static constexpr const char* MIGRATED_KEY = "migrated";
+    // Clés possibles des premiers firmwares (voir setupLegacyCipher)
+    enum LegacyKey : uint8_t {
+        LEGACY_KEY_ZERO = 0,
+        LEGACY_KEY_MAC = 1,
+        LEGACY_KEY_COUNT = 2,
+    };
+    enum BundleField : uint8_t {
+        FIELD_WIFI_SSID = 1,
+        FIELD_WIFI_PASS = 2,
+        FIELD_MQTT_SERVER = 3,
+        FIELD_MQTT_PORT = 4,
+        FIELD_MQTT_USER = 5,
+        FIELD_MQTT_PASS = 6,
+    };
+    // Champs en clair : 5 chaînes de 63 caractères au plus et le port (2 octets)
+    static const size_t BUNDLE_MAX_PLAINTEXT = 5 * (2 + 63) + (2 + 2);
+    static const size_t BUNDLE_MAX_SIZE = BUNDLE_HEADER_SIZE + NONCE_SIZE + BUNDLE_MAX_PLAINTEXT + TAG_SIZE;
+    // Paramètres HKDF : sel propre au projet, usage de la clé
+    static constexpr const char* HKDF_SALT = "oar-securestore";
+    static constexpr const char* HKDF_INFO = "aes-256-gcm config v2";
+    // Taille du secret lu dans le bloc eFuse (192 bits : bloc entier avec le codage 3/4)
+    static const size_t EFUSE_SECRET_SIZE = 24;
+    // Clé dérivée au premier usage
     uint8_t derivedKey[KEY_SIZE];
+    bool keyValid = false;
+    bool keyWiped = false;
+    // Contexte GCM conservé entre les appels : l'expansion de la clé AES n'est faite qu'une fois
+    mbedtls_gcm_context gcm;
+    bool cipherReady = false;
+    // Marqueur de migration lu une fois par instance ; espace de noms ouvert en écriture
+    bool migrationChecked = false;
+    bool migrated = false;
+    bool storeWritable = false;
     
-    // Méthode pour dériver une clé de chiffrement à partir de l'adresse MAC
-    bool deriveKeyFromMAC() {
-        uint8_t mac[6];
-        // Obtenir l'adresse MAC de l'ESP32
-        if (esp_wifi_get_mac(WIFI_IF_STA, mac) != ESP_OK) {
-            return false;
+    // Méthode pour dériver la clé de la carte (MAC de base, et secret eFuse si configuré)
+    static bool deriveDeviceKey(uint8_t key[KEY_SIZE]) {
+        uint8_t ikm[EFUSE_SECRET_SIZE + 6];
+        size_t ikm_len = 0;
+        bool success = true;
+#ifdef OAR_EFUSE_KEY_BLOCK
+        success = esp_efuse_read_block(OAR_EFUSE_KEY_BLOCK, ikm, 0, EFUSE_SECRET_SIZE * 8) == ESP_OK;
+        uint8_t burnt = 0;
+        for (size_t i = 0; i < EFUSE_SECRET_SIZE; i++) {
+            burnt |= ikm[i];
         }
+        // Bloc vierge (ou protégé en lecture) : pas de secret à dériver
+        success = success && burnt != 0;
+        ikm_len = EFUSE_SECRET_SIZE;
+#endif
+        success = success && esp_read_mac(ikm + ikm_len, ESP_MAC_WIFI_STA) == ESP_OK &&
+                  hkdfSha256(ikm, ikm_len + 6, key);
         
-        // Utiliser l'adresse MAC comme seed pour dériver une clé plus longue
-        uint8_t expandedSeed[64];
-        memcpy(expandedSeed, mac, 6);
-        
-        // Compléter avec des motifs pour renforcer l'entropie
-        for (int i = 6; i < 64; i++) {
-            expandedSeed[i] = mac[i % 6] ^ (i * 17);
+        // Effacer proprement la mémoire sensible
+        mbedtls_platform_zeroize(ikm, sizeof(ikm));
+        return success;
+    }
+
+    // Méthode pour dériver la clé au premier usage (générateur aléatoire initialisé au passage)
+    bool ensureKey() {
+        if (keyValid) {
+            return true;
         }
-        
-        // Hash simple pour dériver la clé finale
-        for (size_t i = 0; i < KEY_SIZE; i++) {
-            uint8_t hash = 0;
-            for (size_t j = 0; j < 64; j++) {
-                hash ^= expandedSeed[(i + j) % 64];
-                hash = (hash << 1) | (hash >> 7); // Rotation à gauche
+        if (keyWiped) {
+            return false;
+        }
+        randomSeed(esp_random());
+        keyValid = deriveDeviceKey(derivedKey);
+        return keyValid;
+    }
+
+    // Méthode pour préparer un contexte GCM avec une clé des premiers firmwares (migration).
+    // Leur instance globale dérivait la clé dans son constructeur, avant l'initialisation du Wi-Fi :
+    // esp_wifi_get_mac échouait et la clé restait nulle. C'est la clé des cartes déployées ; celle
+    // tirée de la MAC ne concerne qu'une instance créée après le démarrage du Wi-Fi.
+    // mbedtls_gcm_setkey alloue sur le tas (mbedTLS 2.x) : appelée seulement avant la migration.
+    static bool setupLegacyCipher(mbedtls_gcm_context& context, uint8_t candidate) {
+        uint8_t mac[6];
+        uint8_t key[KEY_SIZE] = {0};
+        mbedtls_gcm_init(&context);
+        bool success = true;
+        if (candidate == LEGACY_KEY_MAC) {
+            success = esp_read_mac(mac, ESP_MAC_WIFI_STA) == ESP_OK;
+            if (success) {
+                deriveLegacyKey(mac, key);
             }
-            derivedKey[i] = hash;
+        }
+        success = success && mbedtls_gcm_setkey(&context, MBEDTLS_CIPHER_ID_AES, key, KEY_SIZE * 8) == 0;
+        mbedtls_platform_zeroize(key, sizeof(key));
+        if (!success) {
+            mbedtls_gcm_free(&context);
+        }
+        return success;
+    }
+
+    // Méthode pour préparer le contexte GCM (clé AES étendue au premier appel seulement)
+    bool ensureCipher() {
+        if (cipherReady) {
+            return true;
+        }
+        if (!ensureKey()) {
+            return false;
+        }
+        
+        // Configurer le contexte GCM avec la clé
+        if (mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, derivedKey, KEY_SIZE * 8) != 0) {
+            mbedtls_gcm_free(&gcm);
+            mbedtls_gcm_init(&gcm);
+            return false;
         }
         
+        cipherReady = true;
         return true;
     }
 
-    // Méthode pour chiffrer des données avec AES-GCM
+    // Méthode pour chiffrer des données avec AES-GCM (données associées facultatives)
     bool encryptData(const char* plaintext, size_t plaintext_len, 
-                     uint8_t* ciphertext, size_t* ciphertext_len) {
+                     uint8_t* ciphertext, size_t* ciphertext_len,
+                     const uint8_t* aad = NULL, size_t aad_len = 0) {
         
-        mbedtls_gcm_context gcm;
-        mbedtls_gcm_init(&gcm);
+        if (!ensureCipher()) {
+            return false;
+        }
         
         // Générer un nonce aléatoire
         uint8_t nonce[NONCE_SIZE];
@@ -75,21 +219,14 @@ private:
             nonce[i] = random(256);
         }
         
-        // Configurer le contexte GCM avec la clé
-        if (mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, derivedKey, KEY_SIZE * 8) != 0) {
-            mbedtls_gcm_free(&gcm);
-            return false;
-        }
-        
         // Tag d'authentification
         uint8_t tag[TAG_SIZE];
         
         // Chiffrer les données
         if (mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, plaintext_len,
-                                     nonce, NONCE_SIZE, NULL, 0,
+                                     nonce, NONCE_SIZE, aad, aad_len,
                                      (const unsigned char*)plaintext, 
                                      ciphertext + NONCE_SIZE, TAG_SIZE, tag) != 0) {
-            mbedtls_gcm_free(&gcm);
             return false;
         }
         
@@ -100,21 +237,20 @@ private:
         // Mettre à jour la taille du buffer chiffré
         *ciphertext_len = NONCE_SIZE + plaintext_len + TAG_SIZE;
         
-        mbedtls_gcm_free(&gcm);
         return true;
     }
 
-    // Méthode pour déchiffrer des données avec AES-GCM
+    // Méthode pour déchiffrer des données avec AES-GCM (données associées facultatives),
+    // avec la clé actuelle ou l'une de celles des premiers firmwares
     bool decryptData(const uint8_t* ciphertext, size_t ciphertext_len,
-                     char* plaintext, size_t* plaintext_len) {
+                     char* plaintext, size_t* plaintext_len,
+                     const uint8_t* aad = NULL, size_t aad_len = 0, bool legacyKey = false) {
+        METRIC_SCOPE(METRIC_STORAGE_DECRYPT);
                      
         if (ciphertext_len < NONCE_SIZE + TAG_SIZE) {
             return false;
         }
         
-        mbedtls_gcm_context gcm;
-        mbedtls_gcm_init(&gcm);
-        
         // Extraire le nonce et le tag
         const uint8_t* nonce = ciphertext;
         const uint8_t* encrypted_data = ciphertext + NONCE_SIZE;
@@ -124,22 +260,32 @@ private:
         
         // Vérifier que le buffer de sortie est suffisamment grand
         if (*plaintext_len < encrypted_data_len) {
-            mbedtls_gcm_free(&gcm);
-            return false;
-        }
-        
-        // Configurer le contexte GCM avec la clé
-        if (mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, derivedKey, KEY_SIZE * 8) != 0) {
-            mbedtls_gcm_free(&gcm);
             return false;
         }
         
         // Déchiffrer et vérifier les données
-        if (mbedtls_gcm_auth_decrypt(&gcm, encrypted_data_len,
-                                    nonce, NONCE_SIZE, NULL, 0,
-                                    tag, TAG_SIZE, encrypted_data, 
-                                    (unsigned char*)plaintext) != 0) {
-            mbedtls_gcm_free(&gcm);
+        int ret = -1;
+        if (legacyKey) {
+            for (uint8_t candidate = 0; candidate < LEGACY_KEY_COUNT && ret != 0; candidate++) {
+                mbedtls_gcm_context legacy;
+                if (setupLegacyCipher(legacy, candidate)) {
+                    ret = mbedtls_gcm_auth_decrypt(&legacy, encrypted_data_len,
+                                                   nonce, NONCE_SIZE, aad, aad_len,
+                                                   tag, TAG_SIZE, encrypted_data,
+                                                   (unsigned char*)plaintext);
+                    mbedtls_gcm_free(&legacy);
+                }
+            }
+        } else {
+            if (!ensureCipher()) {
+                return false;
+            }
+            ret = mbedtls_gcm_auth_decrypt(&gcm, encrypted_data_len,
+                                           nonce, NONCE_SIZE, aad, aad_len,
+                                           tag, TAG_SIZE, encrypted_data, 
+                                           (unsigned char*)plaintext);
+        }
+        if (ret != 0) {
             return false;
         }
         
@@ -151,29 +297,60 @@ private:
             plaintext[*plaintext_len] = '\0';
         }
         
-        mbedtls_gcm_free(&gcm);
         return true;
     }
 
-public:
-    SecureStorage() {
-        // Initialiser le générateur de nombres aléatoires
-        randomSeed(esp_random());
-        // Dériver la clé de chiffrement
-        deriveKeyFromMAC();
+    // Ouvrir l'espace de noms, sauf si une session compatible est déjà ouverte
+    bool openStore(bool readOnly) {
+        if (sessionOpen) {
+            storeWritable = !sessionReadOnly;
+            return readOnly || !sessionReadOnly;
+        }
+        storeWritable = !readOnly;
+        return preferences.begin("securestore", readOnly);
     }
-    
-    // Méthode pour stocker un secret dans la NVS
-    bool storeSecret(const char* key, const char* value) {
-        if (!preferences.begin("securestore", false)) {
+
+    // Ouvrir l'espace de noms pour une lecture : en écriture tant que la migration n'est pas
+    // faite, pour réécrire avec la nouvelle clé un enregistrement lu avec l'ancienne
+    // (une session en lecture seule relit l'enregistrement sans le réécrire)
+    bool openStoreForRead() {
+        return openStore(migrated || (sessionOpen && sessionReadOnly));
+    }
+
+    // Des enregistrements des premiers firmwares peuvent-ils rester ? (espace de noms ouvert)
+    bool legacyRecordsPossible() {
+        if (!migrationChecked) {
+            migrated = preferences.isKey(MIGRATED_KEY);
+            migrationChecked = true;
+        }
+        return !migrated;
+    }
+
+    // Poser le marqueur de migration (espace de noms ouvert en écriture)
+    void markMigrated() {
+        if (legacyRecordsPossible()) {
+            const uint8_t version = BUNDLE_VERSION;
+            migrated = preferences.putBytes(MIGRATED_KEY, &version, sizeof(version)) == sizeof(version);
+        }
+    }
+
+    // Fermer l'espace de noms, sauf s'il appartient à une session
+    void closeStore() {
+        if (!sessionOpen) {
+            preferences.end();
+        }
+    }
+
+    // Chiffrer une valeur et l'écrire sous la clé (espace de noms déjà ouvert)
+    bool writeRecord(const char* key, const char* plaintext, size_t plaintext_len) {
+        if (plaintext_len > MAX_SECRET_SIZE) {
             return false;
         }
         
-        size_t value_len = strlen(value);
-        size_t ciphertext_len = NONCE_SIZE + value_len + TAG_SIZE;
-        uint8_t* ciphertext = new uint8_t[ciphertext_len];
+        uint8_t ciphertext[MAX_RECORD_SIZE];
+        size_t ciphertext_len = sizeof(ciphertext);
         
-        bool success = encryptData(value, value_len, ciphertext, &ciphertext_len);
+        bool success = encryptData(plaintext, plaintext_len, ciphertext, &ciphertext_len);
         
         if (success) {
             // Stocker les données chiffrées dans la NVS
@@ -181,16 +358,332 @@ public:
         }
         
         // Effacer proprement la mémoire sensible
-        memset(ciphertext, 0, ciphertext_len);
-        delete[] ciphertext;
+        mbedtls_platform_zeroize(ciphertext, sizeof(ciphertext));
+        return success;
+    }
+
+    // Lire et déchiffrer la valeur d'une clé (espace de noms déjà ouvert)
+    bool readRecord(const char* key, char* value, size_t value_size, size_t* value_len = nullptr) {
+        if (value_size == 0) {
+            return false;
+        }
+        
+        // Lire les données chiffrées de la NVS
+        size_t ciphertext_len = preferences.getBytesLength(key);
+        if (ciphertext_len == 0 || ciphertext_len > MAX_RECORD_SIZE) {
+            return false;
+        }
+        
+        uint8_t ciphertext[MAX_RECORD_SIZE];
+        bool success = preferences.getBytes(key, ciphertext, ciphertext_len) == ciphertext_len;
+        
+        if (success) {
+            // Déchiffrer les données ; avant la migration, un enregistrement des premiers firmwares
+            // ne passe la vérification du tag qu'avec l'ancienne clé, et il est alors réécrit
+            size_t plaintext_len = value_size - 1; // Pour laisser de la place au terminateur nul
+            success = decryptData(ciphertext, ciphertext_len, value, &plaintext_len);
+            if (!success && legacyRecordsPossible()) {
+                plaintext_len = value_size - 1;
+                success = decryptData(ciphertext, ciphertext_len, value, &plaintext_len, NULL, 0, true);
+                if (success && storeWritable) {
+                    // Un échec de réécriture n'empêche pas d'utiliser la valeur lue
+                    writeRecord(key, value, plaintext_len);
+                }
+            }
+            
+            // Garantir que la chaîne est terminée par un nul
+            if (success && plaintext_len < value_size) {
+                value[plaintext_len] = '\0';
+            }
+            if (success && value_len) {
+                *value_len = plaintext_len;
+            }
+        }
+        
+        // Effacer proprement la mémoire sensible, y compris en cas d'échec
+        mbedtls_platform_zeroize(ciphertext, sizeof(ciphertext));
+        return success;
+    }
+
+    // Lire un entier stocké sous forme de chaîne chiffrée (espace de noms déjà ouvert)
+    bool readIntRecord(const char* key, int* value) {
+        // Buffer pour stocker la valeur déchiffrée
+        char valueStr[16];
+        
+        bool success = readRecord(key, valueStr, sizeof(valueStr));
+        if (success) {
+            // Convertir la chaîne en entier
+            *value = atoi(valueStr);
+        }
+        
+        // Effacer proprement la mémoire sensible
+        mbedtls_platform_zeroize(valueStr, sizeof(valueStr));
+        return success;
+    }
+
+    // Lire une série de champs (espace de noms déjà ouvert)
+    bool readFields(SecretField* fields, size_t count) {
+        bool success = true;
+        for (size_t i = 0; i < count && success; i++) {
+            if (fields[i].value != nullptr) {
+                success = readRecord(fields[i].key, fields[i].value, fields[i].value_size);
+            } else if (fields[i].number != nullptr) {
+                success = readIntRecord(fields[i].key, fields[i].number);
+            } else {
+                success = false;
+            }
+        }
+        return success;
+    }
+
+    // Ajouter un champ au bundle en clair
+    static bool putField(uint8_t* out, size_t* pos, size_t capacity, uint8_t type,
+                         const void* value, size_t len) {
+        if (len > 255 || *pos + 2 + len > capacity) {
+            return false;
+        }
+        out[(*pos)++] = type;
+        out[(*pos)++] = (uint8_t)len;
+        memcpy(out + *pos, value, len);
+        *pos += len;
+        return true;
+    }
+
+    // Copier un champ chaîne du bundle vers un buffer de la configuration
+    static bool getStringField(const uint8_t* value, size_t len, char* out, size_t out_size) {
+        if (len >= out_size) {
+            return false;
+        }
+        memcpy(out, value, len);
+        out[len] = '\0';
+        return true;
+    }
+
+    // Sérialiser la configuration en champs (type, longueur, valeur)
+    static bool encodeBundle(const DeviceConfig& config, uint8_t* out, size_t capacity, size_t* out_len) {
+        uint8_t port[2] = {(uint8_t)(config.mqtt_port & 0xFF), (uint8_t)(config.mqtt_port >> 8)};
+        size_t pos = 0;
+        bool success =
+            putField(out, &pos, capacity, FIELD_WIFI_SSID, config.wifi_ssid, strnlen(config.wifi_ssid, sizeof(config.wifi_ssid))) &&
+            putField(out, &pos, capacity, FIELD_WIFI_PASS, config.wifi_pass, strnlen(config.wifi_pass, sizeof(config.wifi_pass))) &&
+            putField(out, &pos, capacity, FIELD_MQTT_SERVER, config.mqtt_server, strnlen(config.mqtt_server, sizeof(config.mqtt_server))) &&
+            putField(out, &pos, capacity, FIELD_MQTT_PORT, port, sizeof(port)) &&
+            putField(out, &pos, capacity, FIELD_MQTT_USER, config.mqtt_user, strnlen(config.mqtt_user, sizeof(config.mqtt_user))) &&
+            putField(out, &pos, capacity, FIELD_MQTT_PASS, config.mqtt_pass, strnlen(config.mqtt_pass, sizeof(config.mqtt_pass)));
+        *out_len = pos;
+        return success;
+    }
+
+    // Relire les champs du bundle déchiffré ; tous les champs connus sont obligatoires
+    static bool decodeBundle(const uint8_t* in, size_t len, DeviceConfig& config) {
+        uint8_t seen = 0;
+        size_t pos = 0;
+        memset(&config, 0, sizeof(config));
+        
+        while (pos + 2 <= len) {
+            uint8_t type = in[pos];
+            size_t field_len = in[pos + 1];
+            const uint8_t* value = in + pos + 2;
+            pos += 2 + field_len;
+            if (pos > len) {
+                return false;
+            }
+            
+            bool valid = true;
+            switch (type) {
+                case FIELD_WIFI_SSID:
+                    valid = getStringField(value, field_len, config.wifi_ssid, sizeof(config.wifi_ssid));
+                    break;
+                case FIELD_WIFI_PASS:
+                    valid = getStringField(value, field_len, config.wifi_pass, sizeof(config.wifi_pass));
+                    break;
+                case FIELD_MQTT_SERVER:
+                    valid = getStringField(value, field_len, config.mqtt_server, sizeof(config.mqtt_server));
+                    break;
+                case FIELD_MQTT_PORT:
+                    valid = field_len == 2;
+                    if (valid) {
+                        config.mqtt_port = (uint16_t)(value[0] | (value[1] << 8));
+                    }
+                    break;
+                case FIELD_MQTT_USER:
+                    valid = getStringField(value, field_len, config.mqtt_user, sizeof(config.mqtt_user));
+                    break;
+                case FIELD_MQTT_PASS:
+                    valid = getStringField(value, field_len, config.mqtt_pass, sizeof(config.mqtt_pass));
+                    break;
+                default:
+                    // Champ ajouté par une version ultérieure : ignoré
+                    continue;
+            }
+            if (!valid) {
+                return false;
+            }
+            seen |= 1 << type;
+        }
+        
+        const uint8_t required = (1 << FIELD_WIFI_SSID) | (1 << FIELD_WIFI_PASS) | (1 << FIELD_MQTT_SERVER) |
+                                 (1 << FIELD_MQTT_PORT) | (1 << FIELD_MQTT_USER) | (1 << FIELD_MQTT_PASS);
+        return pos == len && (seen & required) == required;
+    }
+
+    // Chiffrer et écrire le bundle (espace de noms déjà ouvert en écriture)
+    bool writeBundle(const DeviceConfig& config) {
+        uint8_t plaintext[BUNDLE_MAX_PLAINTEXT];
+        uint8_t record[BUNDLE_MAX_SIZE];
+        size_t plaintext_len = 0;
+        
+        bool success = encodeBundle(config, plaintext, sizeof(plaintext), &plaintext_len);
+        
+        if (success) {
+            record[0] = BUNDLE_MAGIC_0;
+            record[1] = BUNDLE_MAGIC_1;
+            record[2] = BUNDLE_VERSION;
+            record[3] = 0;
+            size_t ciphertext_len = sizeof(record) - BUNDLE_HEADER_SIZE;
+            success = encryptData((const char*)plaintext, plaintext_len,
+                                  record + BUNDLE_HEADER_SIZE, &ciphertext_len,
+                                  record, BUNDLE_HEADER_SIZE);
+            if (success) {
+                success = preferences.putBytes(BUNDLE_KEY, record, BUNDLE_HEADER_SIZE + ciphertext_len) > 0;
+            }
+            if (success) {
+                markMigrated();
+            }
+        }
+        
+        // Effacer proprement la mémoire sensible
+        mbedtls_platform_zeroize(plaintext, sizeof(plaintext));
+        mbedtls_platform_zeroize(record, sizeof(record));
+        return success;
+    }
+
+    // Lire et déchiffrer le bundle (espace de noms déjà ouvert) : une lecture NVS, un déchiffrement.
+    // legacyKey indique un bundle chiffré avec la clé des premiers firmwares.
+    bool readBundle(DeviceConfig& config, bool* legacyKey) {
+        uint8_t record[BUNDLE_MAX_SIZE];
+        uint8_t plaintext[BUNDLE_MAX_PLAINTEXT + 1];
+        
+        size_t record_len = preferences.getBytesLength(BUNDLE_KEY);
+        if (record_len < BUNDLE_HEADER_SIZE + NONCE_SIZE + TAG_SIZE || record_len > sizeof(record)) {
+            return false;
+        }
+        
+        bool success = preferences.getBytes(BUNDLE_KEY, record, record_len) == record_len &&
+                       record[0] == BUNDLE_MAGIC_0 && record[1] == BUNDLE_MAGIC_1 &&
+                       (record[2] == BUNDLE_VERSION || record[2] == BUNDLE_VERSION_LEGACY_KEY);
+        
+        if (success) {
+            *legacyKey = record[2] == BUNDLE_VERSION_LEGACY_KEY;
+            size_t plaintext_len = sizeof(plaintext) - 1;
+            success = decryptData(record + BUNDLE_HEADER_SIZE, record_len - BUNDLE_HEADER_SIZE,
+                                  (char*)plaintext, &plaintext_len, record, BUNDLE_HEADER_SIZE,
+                                  *legacyKey) &&
+                      decodeBundle(plaintext, plaintext_len, config);
+        }
+        
+        // Effacer proprement la mémoire sensible
+        mbedtls_platform_zeroize(plaintext, sizeof(plaintext));
+        mbedtls_platform_zeroize(record, sizeof(record));
+        return success;
+    }
+
+public:
+    // Aucun calcul ici : l'instance globale est construite avant setup(), la clé est dérivée
+    // au premier chiffrement ou déchiffrement
+    SecureStorage() {
+        mbedtls_gcm_init(&gcm);
+    }
+    
+    ~SecureStorage() {
+        endSession();
+        wipeKeys();
+    }
+    
+    // Le contexte GCM ne doit pas être dupliqué
+    SecureStorage(const SecureStorage&) = delete;
+    SecureStorage& operator=(const SecureStorage&) = delete;
+    
+    // Méthode pour effacer la clé étendue du contexte GCM (peut être appelée plusieurs fois)
+    // Le contexte est recréé à la demande au prochain chiffrement ou déchiffrement
+    void releaseCipher() {
+        mbedtls_gcm_free(&gcm);
+        mbedtls_gcm_init(&gcm);
+        cipherReady = false;
+    }
+    
+    // Méthode pour effacer toutes les clés de la mémoire (l'instance devient inutilisable)
+    void wipeKeys() {
+        releaseCipher();
+        mbedtls_platform_zeroize(derivedKey, KEY_SIZE);
+        keyValid = false;
+        keyWiped = true;
+    }
+    
+    // Méthode pour calculer HKDF-SHA256 avec une sortie de 32 octets (un seul bloc d'expansion).
+    // Écrite sur mbedtls_md_hmac : MBEDTLS_HKDF_C n'est pas activé dans la configuration
+    // mbedTLS d'ESP-IDF, alors que SHA-256 y passe par l'accélérateur matériel.
+    static bool hkdfSha256(const uint8_t* ikm, size_t ikm_len, uint8_t key[KEY_SIZE]) {
+        const mbedtls_md_info_t* sha256 = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+        uint8_t prk[KEY_SIZE];
+        uint8_t info[64];
+        size_t info_len = strlen(HKDF_INFO);
+        if (sha256 == NULL || info_len + 1 > sizeof(info)) {
+            return false;
+        }
+        
+        // Extraction : PRK = HMAC(sel, IKM), puis expansion : T(1) = HMAC(PRK, info | 0x01)
+        memcpy(info, HKDF_INFO, info_len);
+        info[info_len] = 0x01;
+        bool success = mbedtls_md_hmac(sha256, (const unsigned char*)HKDF_SALT, strlen(HKDF_SALT),
+                                       ikm, ikm_len, prk) == 0 &&
+                       mbedtls_md_hmac(sha256, prk, sizeof(prk), info, info_len + 1, key) == 0;
+        
+        // Effacer proprement la mémoire sensible
+        mbedtls_platform_zeroize(prk, sizeof(prk));
+        return success;
+    }
+    
+    // Méthode pour calculer la clé des premiers firmwares à partir de la MAC (lecture des anciens
+    // enregistrements, et point de comparaison du banc de mesure)
+    static void deriveLegacyKey(const uint8_t mac[6], uint8_t key[KEY_SIZE]) {
+        // Utiliser l'adresse MAC comme seed pour dériver une clé plus longue
+        uint8_t expandedSeed[64];
+        memcpy(expandedSeed, mac, 6);
+        
+        // Compléter avec des motifs pour renforcer l'entropie
+        for (int i = 6; i < 64; i++) {
+            expandedSeed[i] = mac[i % 6] ^ (i * 17);
+        }
+        
+        // Hash simple pour dériver la clé finale
+        for (size_t i = 0; i < KEY_SIZE; i++) {
+            uint8_t hash = 0;
+            for (size_t j = 0; j < 64; j++) {
+                hash ^= expandedSeed[(i + j) % 64];
+                hash = (hash << 1) | (hash >> 7); // Rotation à gauche
+            }
+            key[i] = hash;
+        }
+        
+        mbedtls_platform_zeroize(expandedSeed, sizeof(expandedSeed));
+    }
+    
+    // Méthode pour stocker un secret dans la NVS
+    bool storeSecret(const char* key, const char* value) {
+        if (!openStore(false)) {
+            return false;
+        }
+        
+        bool success = writeRecord(key, value, strlen(value));
         
-        preferences.end();
+        closeStore();
         return success;
     }
     
     // Méthode pour stocker un entier dans la NVS (pour le port MQTT)
     bool storeInt(const char* key, int value) {
-        if (!preferences.begin("securestore", false)) {
+        if (!openStore(false)) {
             return false;
         }
         
@@ -198,135 +691,277 @@ public:
         char valueStr[16];
         sprintf(valueStr, "%d", value);
         
-        size_t value_len = strlen(valueStr);
-        size_t ciphertext_len = NONCE_SIZE + value_len + TAG_SIZE;
-        uint8_t* ciphertext = new uint8_t[ciphertext_len];
-        
-        bool success = encryptData(valueStr, value_len, ciphertext, &ciphertext_len);
-        
-        if (success) {
-            // Stocker les données chiffrées dans la NVS
-            success = preferences.putBytes(key, ciphertext, ciphertext_len) > 0;
-        }
+        bool success = writeRecord(key, valueStr, strlen(valueStr));
         
         // Effacer proprement la mémoire sensible
-        memset(ciphertext, 0, ciphertext_len);
-        delete[] ciphertext;
+        mbedtls_platform_zeroize(valueStr, sizeof(valueStr));
         
-        preferences.end();
+        closeStore();
         return success;
     }
     
     // Méthode pour récupérer un secret de la NVS
     bool retrieveSecret(const char* key, char* value, size_t value_size) {
-        if (!preferences.begin("securestore", true)) {
+        if (!openStoreForRead()) {
             return false;
         }
         
-        // Lire les données chiffrées de la NVS
-        size_t ciphertext_len = preferences.getBytesLength(key);
-        if (ciphertext_len == 0) {
-            preferences.end();
+        bool success = readRecord(key, value, value_size);
+        
+        closeStore();
+        return success;
+    }
+    
+    // Méthode pour récupérer un entier de la NVS
+    bool retrieveInt(const char* key, int* value) {
+        if (!openStoreForRead()) {
             return false;
         }
         
-        uint8_t* ciphertext = new uint8_t[ciphertext_len];
-        if (preferences.getBytes(key, ciphertext, ciphertext_len) != ciphertext_len) {
-            delete[] ciphertext;
-            preferences.end();
+        bool success = readIntRecord(key, value);
+        
+        closeStore();
+        return success;
+    }
+    
+    // Méthode pour stocker des données binaires de taille fixe (structure)
+    bool storeBlob(const char* key, const void* data, size_t len) {
+        if (!openStore(false)) {
             return false;
         }
         
-        // Déchiffrer les données
-        size_t plaintext_len = value_size - 1; // Pour laisser de la place au terminateur nul
-        bool success = decryptData(ciphertext, ciphertext_len, value, &plaintext_len);
+        bool success = writeRecord(key, (const char*)data, len);
         
-        // Garantir que la chaîne est terminée par un nul
-        if (success && plaintext_len < value_size) {
-            value[plaintext_len] = '\0';
+        closeStore();
+        return success;
+    }
+    
+    // Méthode pour récupérer des données binaires ; échoue si la taille enregistrée diffère
+    bool retrieveBlob(const char* key, void* data, size_t len) {
+        if (len > MAX_SECRET_SIZE || !openStoreForRead()) {
+            return false;
         }
         
-        // Effacer proprement la mémoire sensible
-        memset(ciphertext, 0, ciphertext_len);
-        delete[] ciphertext;
+        // Un octet de plus pour le terminateur de readRecord, un autre pour détecter un enregistrement trop long
+        char plaintext[MAX_SECRET_SIZE + 2];
+        size_t plaintext_len = 0;
+        bool success = readRecord(key, plaintext, len + 2, &plaintext_len) && plaintext_len == len;
+        if (success) {
+            memcpy(data, plaintext, len);
+        }
         
-        preferences.end();
+        // Effacer proprement la mémoire sensible
+        mbedtls_platform_zeroize(plaintext, sizeof(plaintext));
+        closeStore();
         return success;
     }
     
-    // Méthode pour récupérer un entier de la NVS
-    bool retrieveInt(const char* key, int* value) {
-        if (!preferences.begin("securestore", true)) {
+    // Méthode pour ouvrir une session : l'espace de noms reste ouvert jusqu'à endSession()
+    // et les appels suivants (store*, retrieve*, *Batch) ne le rouvrent plus
+    bool beginSession(bool readOnly) {
+        if (sessionOpen) {
             return false;
         }
-        
-        // Lire les données chiffrées de la NVS
-        size_t ciphertext_len = preferences.getBytesLength(key);
-        if (ciphertext_len == 0) {
+        if (!preferences.begin("securestore", readOnly)) {
+            return false;
+        }
+        sessionOpen = true;
+        sessionReadOnly = readOnly;
+        return true;
+    }
+    
+    // Méthode pour fermer la session en cours
+    void endSession() {
+        if (sessionOpen) {
+            sessionOpen = false;
             preferences.end();
+        }
+    }
+    
+    // Méthode pour récupérer plusieurs secrets en une seule ouverture de la NVS
+    // Retourne false dès qu'un champ manque ou ne peut pas être déchiffré
+    bool retrieveBatch(SecretField* fields, size_t count) {
+        if (!openStoreForRead()) {
             return false;
         }
         
-        uint8_t* ciphertext = new uint8_t[ciphertext_len];
-        if (preferences.getBytes(key, ciphertext, ciphertext_len) != ciphertext_len) {
-            delete[] ciphertext;
-            preferences.end();
+        bool success = readFields(fields, count);
+        
+        closeStore();
+        return success;
+    }
+    
+    // Méthode pour stocker plusieurs secrets (MAX_BATCH_SIZE au plus) en une seule ouverture de la NVS
+    // Tout ou rien : les tailles sont vérifiées avant la première écriture, et si une écriture
+    // échoue, les enregistrements précédents sont rétablis (les clés nouvelles sont supprimées)
+    bool storeBatch(const SecretValue* values, size_t count) {
+        if (count > MAX_BATCH_SIZE) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (values[i].value != nullptr && strlen(values[i].value) > MAX_SECRET_SIZE) {
+                return false;
+            }
+        }
+        if (!openStore(false)) {
             return false;
         }
         
-        // Buffer pour stocker la valeur déchiffrée
-        char valueStr[16];
-        size_t plaintext_len = sizeof(valueStr) - 1;
+        // Copier les enregistrements existants ; un blob trop grand pour être rétabli fait refuser le lot
+        uint8_t previous[MAX_BATCH_SIZE][MAX_RECORD_SIZE];
+        size_t previous_len[MAX_BATCH_SIZE];
+        bool success = true;
+        for (size_t i = 0; i < count && success; i++) {
+            previous_len[i] = preferences.getBytesLength(values[i].key);
+            success = previous_len[i] <= MAX_RECORD_SIZE &&
+                      (previous_len[i] == 0 ||
+                       preferences.getBytes(values[i].key, previous[i], previous_len[i]) == previous_len[i]);
+        }
         
-        // Déchiffrer les données
-        bool success = decryptData(ciphertext, ciphertext_len, valueStr, &plaintext_len);
+        size_t written = 0;
+        for (; written < count && success; written++) {
+            if (values[written].value != nullptr) {
+                success = writeRecord(values[written].key, values[written].value,
+                                      strlen(values[written].value));
+            } else {
+                char valueStr[16];
+                sprintf(valueStr, "%d", values[written].number);
+                success = writeRecord(values[written].key, valueStr, strlen(valueStr));
+                mbedtls_platform_zeroize(valueStr, sizeof(valueStr));
+            }
+        }
         
-        // Garantir que la chaîne est terminée par un nul
-        if (success && plaintext_len < sizeof(valueStr)) {
-            valueStr[plaintext_len] = '\0';
-            // Convertir la chaîne en entier
-            *value = atoi(valueStr);
+        if (!success) {
+            // Annuler le lot pour ne pas laisser une configuration à moitié écrite
+            for (size_t i = 0; i < written; i++) {
+                if (previous_len[i] > 0) {
+                    preferences.putBytes(values[i].key, previous[i], previous_len[i]);
+                } else {
+                    preferences.remove(values[i].key);
+                }
+            }
         }
         
         // Effacer proprement la mémoire sensible
-        memset(ciphertext, 0, ciphertext_len);
-        delete[] ciphertext;
-        memset(valueStr, 0, sizeof(valueStr));
+        mbedtls_platform_zeroize(previous, sizeof(previous));
+        closeStore();
+        return success;
+    }
+    
+    // Méthode pour stocker toute la configuration en un seul enregistrement chiffré
+    bool storeConfig(const DeviceConfig& config) {
+        if (!openStore(false)) {
+            return false;
+        }
+        
+        bool success = writeBundle(config);
+        
+        closeStore();
+        return success;
+    }
+    
+    // Méthode pour récupérer toute la configuration : une lecture NVS et un déchiffrement.
+    // Si seul l'ancien format (une clé par identifiant) est présent, il est converti
+    // en bundle et les anciennes clés sont supprimées. Un bundle chiffré avec l'ancienne
+    // clé est réécrit avec la nouvelle ; le marqueur de migration est posé au passage.
+    bool loadConfig(DeviceConfig& config) {
+        if (!openStore(true)) {
+            return false;
+        }
+        
+        bool legacyKey = false;
+        bool success = readBundle(config, &legacyKey);
+        bool hasBundle = preferences.isKey(BUNDLE_KEY);
+        bool markMissing = success && !legacyKey && legacyRecordsPossible();
+        
+        closeStore();
+        if ((success && legacyKey) || markMissing) {
+            if (openStore(false)) {
+                // Un échec de réécriture n'empêche pas d'utiliser la configuration lue
+                if (legacyKey) {
+                    writeBundle(config);
+                } else {
+                    markMigrated();
+                }
+                closeStore();
+            }
+        }
+        if (success || hasBundle) {
+            return success;
+        }
+        return migrateLegacyConfig(config);
+    }
+    
+    // Méthode pour convertir les identifiants stockés clé par clé en bundle
+    bool migrateLegacyConfig(DeviceConfig& config) {
+        static const char* const legacyKeys[] = {
+            "wifi_ssid", "wifi_pass", "mqtt_server", "mqtt_port", "mqtt_user", "mqtt_pass"
+        };
+        
+        if (!openStore(false)) {
+            return false;
+        }
+        
+        int port = 0;
+        memset(&config, 0, sizeof(config));
+        SecretField fields[] = {
+            {"wifi_ssid", config.wifi_ssid, sizeof(config.wifi_ssid), nullptr},
+            {"wifi_pass", config.wifi_pass, sizeof(config.wifi_pass), nullptr},
+            {"mqtt_server", config.mqtt_server, sizeof(config.mqtt_server), nullptr},
+            {"mqtt_port", nullptr, 0, &port},
+            {"mqtt_user", config.mqtt_user, sizeof(config.mqtt_user), nullptr},
+            {"mqtt_pass", config.mqtt_pass, sizeof(config.mqtt_pass), nullptr},
+        };
+        
+        bool success = readFields(fields, sizeof(fields) / sizeof(fields[0])) &&
+                       port > 0 && port <= 0xFFFF;
+        if (success) {
+            config.mqtt_port = (uint16_t)port;
+            success = writeBundle(config);
+        }
+        if (success) {
+            // Les anciennes clés ne sont supprimées qu'une fois le bundle écrit
+            for (size_t i = 0; i < sizeof(legacyKeys) / sizeof(legacyKeys[0]); i++) {
+                preferences.remove(legacyKeys[i]);
+            }
+        }
         
-        preferences.end();
+        closeStore();
         return success;
     }
     
     // Méthode pour vérifier si un secret existe
     bool secretExists(const char* key) {
-        if (!preferences.begin("securestore", true)) {
+        if (!openStore(true)) {
             return false;
         }
         
         bool exists = preferences.isKey(key);
-        preferences.end();
+        closeStore();
         return exists;
     }
     
     // Méthode pour supprimer un secret
     bool deleteSecret(const char* key) {
-        if (!preferences.begin("securestore", false)) {
+        if (!openStore(false)) {
             return false;
         }
         
         bool success = preferences.remove(key);
-        preferences.end();
+        closeStore();
         return success;
     }
     
     // Méthode pour supprimer tous les secrets
     bool clearAllSecrets() {
-        if (!preferences.begin("securestore", false)) {
+        if (!openStore(false)) {
             return false;
         }
         
         bool success = preferences.clear();
-        preferences.end();
+        // Plus aucun enregistrement : le marqueur est reposé avec le prochain bundle
+        migrationChecked = false;
+        closeStore();
         return success;
     }
 };
@@ -0,0 +1,74 @@
+// SensorFilter.h - Filtrage d'une grandeur en virgule fixe : médiane glissante puis lissage exponentiel
+// La médiane écarte les lectures aberrantes isolées (trame DHT22 corrompue malgré sa somme de
+// contrôle), le lissage atténue le bruit de quantification (0,1 °C) pour que la régulation ne
+// bascule pas sur une seule lecture proche d'un seuil.
+// Valeurs en centièmes d'unité ; le lissage garde 8 bits de fraction supplémentaires.
+// Structure sans constructeur : une instance mise à zéro est vide, ce qui permet de la placer
+// en mémoire RTC (RTC_DATA_ATTR) pour le sommeil profond.
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+// N : lectures dans la médiane (impair de préférence) ; SHIFT : lissage de coefficient 1/2^SHIFT
+template <size_t N, uint8_t SHIFT>
+struct MedianEmaFilter {
+    int32_t history[N];   // Dernières lectures (centièmes), dans l'ordre d'arrivée circulaire
+    uint8_t count;        // Lectures présentes dans history (au plus N)
+    uint8_t next;         // Emplacement de la prochaine lecture
+    int32_t smoothed;     // Sortie lissée (centièmes, 8 bits de fraction)
+
+    // Méthode pour ajouter une lecture ; renvoie la valeur filtrée (centièmes)
+    int32_t update(int32_t value) {
+        if (next >= N || count > N) {
+            count = 0;  // Mémoire RTC incohérente : repartir d'un filtre vide
+            next = 0;
+        }
+        history[next] = value;
+        next = (next + 1) % N;
+        if (count < N) {
+            count++;
+        }
+
+        int32_t center = median() * 256;
+        if (count == 1) {
+            smoothed = center;
+        } else {
+            smoothed += (center - smoothed) / (1 << SHIFT);
+        }
+        return (smoothed + (smoothed >= 0 ? 128 : -128)) / 256;
+    }
+
+    // Même chose pour une valeur réelle (°C, %)
+    float update(float value) {
+        return update((int32_t)lroundf(value * 100)) / 100.0f;
+    }
+
+    // Médiane des lectures présentes (moyenne des deux valeurs centrales si leur nombre est pair)
+    int32_t median() const {
+        int32_t sorted[N];
+        for (uint8_t i = 0; i < count; i++) {
+            int32_t v = history[i];
+            uint8_t j = i;
+            while (j > 0 && sorted[j - 1] > v) {
+                sorted[j] = sorted[j - 1];
+                j--;
+            }
+            sorted[j] = v;
+        }
+        if (count % 2 == 1) {
+            return sorted[count / 2];
+        }
+        return (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+    }
+
+    void clear() {
+        count = 0;
+        next = 0;
+        smoothed = 0;
+    }
+};
+
+#endif // SENSOR_FILTER_H
@@ -0,0 +1,64 @@
+// ShellyPowerMeter.h - Consommation de la prise Shelly du climatiseur (API HTTP locale)
+// Même requête que update_consumption() de regulationtemp.py : GET http://<ip>/status, puis
+// meters[0].power dans la réponse JSON. La réponse n'est parcourue que jusqu'à cette valeur, sans
+// analyseur JSON complet.
+#ifndef SHELLY_POWER_METER_H
+#define SHELLY_POWER_METER_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include "ClimateControl.h"
+
+const uint16_t SHELLY_TIMEOUT_MS = 1000;
+
+// Extraire meters[0].power d'une réponse /status ; false si la valeur est absente
+inline bool parseShellyPower(const char* body, float& watts) {
+    const char* meters = strstr(body, "\"meters\"");
+    if (!meters) {
+        return false;
+    }
+    const char* power = strstr(meters, "\"power\"");
+    if (!power) {
+        return false;
+    }
+    power = strchr(power + 7, ':');
+    if (!power) {
+        return false;
+    }
+    char* end;
+    float value = strtof(power + 1, &end);
+    if (end == power + 1) {
+        return false;
+    }
+    watts = value;
+    return true;
+}
+
+class ShellyPowerMeter : public PowerMeter {
+private:
+    char url[48];
+
+public:
+    explicit ShellyPowerMeter(IPAddress address) {
+        snprintf(url, sizeof(url), "http://%u.%u.%u.%u/status", address[0], address[1], address[2], address[3]);
+    }
+
+    // Méthode pour lire la consommation instantanée (W)
+    bool readPower(float& watts) override {
+        HTTPClient http;
+        http.setTimeout(SHELLY_TIMEOUT_MS);
+        http.setConnectTimeout(SHELLY_TIMEOUT_MS);
+        if (!http.begin(url)) {
+            return false;
+        }
+        bool ok = false;
+        if (http.GET() == HTTP_CODE_OK) {
+            String body = http.getString();
+            ok = parseShellyPower(body.c_str(), watts);
+        }
+        http.end();
+        return ok;
+    }
+};
+
+#endif // SHELLY_POWER_METER_H
@@ -0,0 +1,63 @@
+// TelemetryBacklog.h - Réserve bornée des mesures non publiées, rejouées au retour du broker
+// Structure sans constructeur : une instance mise à zéro est une réserve vide, ce qui permet de
+// la placer en mémoire RTC (RTC_DATA_ATTR) pour qu'elle survive au sommeil profond.
+#ifndef TELEMETRY_BACKLOG_H
+#define TELEMETRY_BACKLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Reading.h"
+
+template <size_t N>
+struct TelemetryBacklog {
+    Reading items[N];
+    uint16_t first;       // Index de la mesure la plus ancienne
+    uint16_t count;       // Nombre de mesures en réserve
+    uint16_t highWater;   // Occupation maximale atteinte
+    uint32_t dropped;     // Mesures écrasées faute de place (les plus anciennes)
+    uint32_t replayed;    // Mesures rejouées avec succès
+
+    // Remettre la réserve dans un état cohérent (mémoire RTC non initialisée ou corrompue)
+    void sanitize() {
+        if (first >= N || count > N || highWater > N) {
+            first = 0;
+            count = 0;
+            highWater = 0;
+        }
+    }
+
+    // Ajouter une mesure ; si la réserve est pleine, la plus ancienne est écrasée
+    void push(const Reading& reading) {
+        if (count == N) {
+            first = (first + 1) % N;
+            count--;
+            dropped++;
+        }
+        items[(first + count) % N] = reading;
+        count++;
+        if (count > highWater) {
+            highWater = count;
+        }
+    }
+
+    // Lire la i-ème mesure la plus ancienne sans la retirer
+    const Reading& peek(size_t index) const {
+        return items[(first + index) % N];
+    }
+
+    // Retirer les n mesures les plus anciennes (après un envoi réussi)
+    void discard(size_t n) {
+        if (n > count) {
+            n = count;
+        }
+        first = (first + n) % N;
+        count -= n;
+        replayed += n;
+    }
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    size_t capacity() const { return N; }
+};
+
+#endif // TELEMETRY_BACKLOG_H
@@ -0,0 +1,157 @@
+// TelemetryEncoder.h - Encodage d'une mesure en un seul message MQTT, sans allocation
+// Trois formats :
+//  - TELEMETRY_TEXT   : ancien format, une valeur texte par topic (sensors/temperature, sensors/humidity)
+//  - TELEMETRY_PACKED : structure fixe de 13 octets (14 pour une sonde autre que la première),
+//                       petit-boutiste (voir encodePacked)
+//  - TELEMETRY_CBOR   : map CBOR (RFC 8949) à clés entières, lisible par n'importe quelle bibliothèque CBOR
+// Un message peut regrouper les mesures de plusieurs sondes : enregistrements mis bout à bout
+// (séquence CBOR, RFC 8742, pour TELEMETRY_CBOR).
+#ifndef TELEMETRY_ENCODER_H
+#define TELEMETRY_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "Reading.h"
+
+enum TelemetryFormat {
+    TELEMETRY_TEXT,
+    TELEMETRY_PACKED,
+    TELEMETRY_CBOR
+};
+
+const uint8_t TELEMETRY_PACKED_VERSION = 1;        // Sonde 0 : format d'origine
+const uint8_t TELEMETRY_PACKED_PROBE_VERSION = 2;  // Autre sonde : index ajouté en fin d'enregistrement
+const size_t TELEMETRY_PACKED_SIZE = 13;
+const size_t TELEMETRY_PACKED_PROBE_SIZE = 14;
+const size_t TELEMETRY_TEXT_MAX_SIZE = 16;   // "-40.00", "100.00"... avec marge
+const size_t TELEMETRY_MAX_SIZE = 32;        // Taille suffisante pour tous les formats binaires
+
+// Clés de la map CBOR
+enum TelemetryCborKey {
+    TELEMETRY_KEY_SEQ = 0,
+    TELEMETRY_KEY_TIMESTAMP = 1,
+    TELEMETRY_KEY_TEMPERATURE = 2,
+    TELEMETRY_KEY_HUMIDITY = 3,
+    TELEMETRY_KEY_SENSOR = 4       // Absente pour la sonde 0
+};
+
+// Méthode pour écrire une valeur au format texte de l'ancien firmware (String(float) : 2 décimales)
+inline size_t encodeTextValue(float value, char* output, size_t output_size) {
+    int len = snprintf(output, output_size, "%.2f", value);
+    if (len < 0 || (size_t)len >= output_size) {
+        return 0;
+    }
+    return len;
+}
+
+// Méthode pour encoder une mesure en structure fixe :
+//   [0]     version (TELEMETRY_PACKED_VERSION)
+//   [1..4]  numéro de séquence (uint32)
+//   [5..8]  horodatage millis() (uint32)
+//   [9..10] température en centièmes de °C (int16)
+//   [11..12] humidité en centièmes de % (uint16)
+//   [13]    index de la sonde (version TELEMETRY_PACKED_PROBE_VERSION seulement)
+// Le DHT22 a une résolution de 0,1 : le passage en centièmes ne perd rien.
+inline size_t encodePacked(const Reading& reading, uint8_t* output, size_t output_size) {
+    size_t size = reading.sensor ? TELEMETRY_PACKED_PROBE_SIZE : TELEMETRY_PACKED_SIZE;
+    if (output_size < size) {
+        return 0;
+    }
+    long temperature = lroundf(reading.temperature * 100.0f);
+    long humidity = lroundf(reading.humidity * 100.0f);
+    if (temperature < INT16_MIN || temperature > INT16_MAX || humidity < 0 || humidity > UINT16_MAX) {
+        return 0;
+    }
+
+    output[0] = reading.sensor ? TELEMETRY_PACKED_PROBE_VERSION : TELEMETRY_PACKED_VERSION;
+    for (int i = 0; i < 4; i++) {
+        output[1 + i] = (uint8_t)(reading.seq >> (8 * i));
+        output[5 + i] = (uint8_t)(reading.timestamp >> (8 * i));
+    }
+    uint16_t t = (uint16_t)(int16_t)temperature;
+    uint16_t h = (uint16_t)humidity;
+    output[9] = (uint8_t)t;
+    output[10] = (uint8_t)(t >> 8);
+    output[11] = (uint8_t)h;
+    output[12] = (uint8_t)(h >> 8);
+    if (reading.sensor) {
+        output[13] = reading.sensor;
+    }
+    return size;
+}
+
+// Écrire un entier non signé CBOR (type majeur 0) ou une clé de map
+inline size_t putCborUint(uint32_t value, uint8_t* output) {
+    if (value < 24) {
+        output[0] = (uint8_t)value;
+        return 1;
+    }
+    if (value <= 0xFF) {
+        output[0] = 0x18;
+        output[1] = (uint8_t)value;
+        return 2;
+    }
+    if (value <= 0xFFFF) {
+        output[0] = 0x19;
+        output[1] = (uint8_t)(value >> 8);
+        output[2] = (uint8_t)value;
+        return 3;
+    }
+    output[0] = 0x1A;
+    for (int i = 0; i < 4; i++) {
+        output[1 + i] = (uint8_t)(value >> (24 - 8 * i));
+    }
+    return 5;
+}
+
+// Écrire un flottant simple précision CBOR (type majeur 7, gros-boutiste)
+inline size_t putCborFloat(float value, uint8_t* output) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    output[0] = 0xFA;
+    for (int i = 0; i < 4; i++) {
+        output[1 + i] = (uint8_t)(bits >> (24 - 8 * i));
+    }
+    return 5;
+}
+
+// Méthode pour encoder une mesure en map CBOR {0: seq, 1: horodatage, 2: température, 3: humidité}
+// (plus {4: sonde} pour une sonde autre que la première)
+inline size_t encodeCbor(const Reading& reading, uint8_t* output, size_t output_size) {
+    // Pire cas : en-tête de map, 5 clés, 2 entiers sur 5 octets, 2 flottants sur 5 octets, 1 index sur 2
+    if (output_size < 1 + 5 + 5 * 4 + 2) {
+        return 0;
+    }
+    size_t len = 0;
+    output[len++] = reading.sensor ? 0xA5 : 0xA4;
+    len += putCborUint(TELEMETRY_KEY_SEQ, output + len);
+    len += putCborUint(reading.seq, output + len);
+    len += putCborUint(TELEMETRY_KEY_TIMESTAMP, output + len);
+    len += putCborUint(reading.timestamp, output + len);
+    len += putCborUint(TELEMETRY_KEY_TEMPERATURE, output + len);
+    len += putCborFloat(reading.temperature, output + len);
+    len += putCborUint(TELEMETRY_KEY_HUMIDITY, output + len);
+    len += putCborFloat(reading.humidity, output + len);
+    if (reading.sensor) {
+        len += putCborUint(TELEMETRY_KEY_SENSOR, output + len);
+        len += putCborUint(reading.sensor, output + len);
+    }
+    return len;
+}
+
+// Méthode pour encoder une mesure dans un format binaire (0 si le format est TELEMETRY_TEXT)
+inline size_t encodeTelemetry(TelemetryFormat format, const Reading& reading, uint8_t* output, size_t output_size) {
+    switch (format) {
+        case TELEMETRY_PACKED:
+            return encodePacked(reading, output, output_size);
+        case TELEMETRY_CBOR:
+            return encodeCbor(reading, output, output_size);
+        default:
+            return 0;
+    }
+}
+
+#endif // TELEMETRY_ENCODER_H
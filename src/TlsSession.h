@@ -0,0 +1,80 @@
+// TlsSession.h - Session TLS conservée entre deux connexions, et mesures des poignées de main
+// Structures sans constructeur : une instance mise à zéro est vide, ce qui permet de placer le
+// cache en mémoire RTC (RTC_DATA_ATTR) pour reprendre la session au réveil d'un sommeil profond.
+#ifndef TLS_SESSION_H
+#define TLS_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Fingerprint.h"
+
+// Session sérialisée (mbedtls_ssl_session_save) : ticket et, selon la configuration de mbedTLS,
+// certificat du broker. 1,5 Ko laisse de la place à la réserve de mesures dans les 8 Ko de RTC.
+const size_t TLS_SESSION_MAX_SIZE = 1536;
+
+struct TlsSessionCache {
+    uint8_t data[TLS_SESSION_MAX_SIZE];
+    uint16_t length;      // 0 : pas de session
+    uint16_t port;
+    uint32_t hostHash;    // Empreinte du nom du broker
+    uint32_t checksum;    // Empreinte de data, pour écarter un contenu RTC incohérent
+
+    // Méthode pour savoir si la session peut être proposée à ce broker
+    bool matches(const char* host, uint16_t brokerPort) const {
+        if (length == 0 || length > TLS_SESSION_MAX_SIZE || port != brokerPort) {
+            return false;
+        }
+        return hostHash == fingerprint(host) &&
+               checksum == fingerprint(data, length);
+    }
+
+    // Méthode pour mémoriser la session négociée avec un broker
+    bool store(const char* host, uint16_t brokerPort, const uint8_t* session, size_t session_len) {
+        if (session_len == 0 || session_len > TLS_SESSION_MAX_SIZE) {
+            clear();
+            return false;
+        }
+        if (session != data) {
+            memcpy(data, session, session_len);
+        }
+        length = session_len;
+        port = brokerPort;
+        hostHash = fingerprint(host);
+        checksum = fingerprint(data, length);
+        return true;
+    }
+
+    void clear() {
+        length = 0;
+        checksum = 0;
+    }
+};
+
+// Mesures des poignées de main, pour comparer reprise de session et poignée complète
+struct HandshakeStats {
+    uint32_t full;          // Poignées de main complètes réussies
+    uint32_t resumed;       // Sessions reprises
+    uint32_t failed;        // Échecs (TCP ou TLS)
+    uint32_t fullMs;        // Durée cumulée des poignées complètes
+    uint32_t resumedMs;     // Durée cumulée des reprises
+    uint32_t lastMs;        // Durée de la dernière poignée de main réussie
+    bool lastResumed;
+
+    void record(bool wasResumed, uint32_t ms) {
+        if (wasResumed) {
+            resumed++;
+            resumedMs += ms;
+        } else {
+            full++;
+            fullMs += ms;
+        }
+        lastMs = ms;
+        lastResumed = wasResumed;
+    }
+
+    uint32_t averageFullMs() const { return full ? fullMs / full : 0; }
+    uint32_t averageResumedMs() const { return resumed ? resumedMs / resumed : 0; }
+};
+
+#endif // TLS_SESSION_H
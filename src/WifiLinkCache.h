@@ -0,0 +1,76 @@
+// WifiLinkCache.h - Paramètres de la dernière association Wi-Fi (point d'accès, canal, bail DHCP)
+// Avec le BSSID et le canal, WiFi.begin() rejoint directement le point d'accès sans balayer
+// tous les canaux ; avec l'adresse IP d'un bail récent, la configuration se fait sans DHCP.
+// Structure sans constructeur : une instance mise à zéro est vide, ce qui permet de la placer
+// en mémoire RTC (RTC_DATA_ATTR). Une copie est gardée en NVS pour les démarrages à froid.
+#ifndef WIFI_LINK_CACHE_H
+#define WIFI_LINK_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Fingerprint.h"
+
+// Âge maximal d'un bail réutilisé sans DHCP : la durée réelle du bail n'est pas connue, on prend
+// la moitié d'un bail d'une heure (parmi les plus courts des routeurs courants) pour ne jamais
+// garder une adresse que le routeur a pu réattribuer
+const uint32_t WIFI_LEASE_MAX_AGE_MS = 30UL * 60 * 1000;
+
+struct WifiLinkCache {
+    uint32_t ssidHash;    // Empreinte du SSID associé
+    uint8_t bssid[6];     // Adresse MAC du point d'accès
+    uint8_t channel;      // 0 : pas de point d'accès en cache
+    uint8_t reserved;     // Octet de bourrage, à zéro (couvert par l'empreinte)
+    uint32_t ip;          // Dernier bail DHCP (0 : pas de bail réutilisable)
+    uint32_t leaseAtMs;   // Obtention du bail par le DHCP (uptimeMs())
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint32_t checksum;    // Empreinte des champs ci-dessus
+
+    uint32_t computeChecksum() const {
+        return fingerprint((const uint8_t*)this, offsetof(WifiLinkCache, checksum));
+    }
+
+    // Méthode pour savoir si le point d'accès en cache correspond à ce réseau
+    bool matches(const char* ssid) const {
+        return channel != 0 && ssidHash == fingerprint(ssid) && checksum == computeChecksum();
+    }
+
+    // Méthode pour savoir si le dernier bail peut encore être réutilisé sans DHCP à l'instant now
+    // (uptimeMs(), qui avance aussi pendant le sommeil profond)
+    bool hasLease(uint32_t now) const {
+        return ip != 0 && now - leaseAtMs < WIFI_LEASE_MAX_AGE_MS;
+    }
+
+    // Méthode pour mémoriser une association ; true si le point d'accès ou le bail ont changé
+    // (la copie en NVS n'est alors réécrite que dans ce cas). leaseAtMs est laissé à l'appelant :
+    // seul un bail obtenu par le DHCP le remet à jour
+    bool update(const char* ssid, const uint8_t* apBssid, uint8_t apChannel,
+                uint32_t address, uint32_t gatewayAddress, uint32_t subnetMask, uint32_t dnsAddress) {
+        uint32_t hash = fingerprint(ssid);
+        bool changed = !matches(ssid) || memcmp(bssid, apBssid, sizeof(bssid)) != 0 ||
+                       channel != apChannel || ip != address || gateway != gatewayAddress ||
+                       subnet != subnetMask || dns != dnsAddress;
+        ssidHash = hash;
+        memcpy(bssid, apBssid, sizeof(bssid));
+        channel = apChannel;
+        ip = address;
+        gateway = gatewayAddress;
+        subnet = subnetMask;
+        dns = dnsAddress;
+        seal();
+        return changed;
+    }
+
+    // Méthode pour recalculer l'empreinte après une modification directe d'un champ
+    void seal() {
+        checksum = computeChecksum();
+    }
+
+    void clear() {
+        memset(this, 0, sizeof(*this));
+    }
+};
+
+#endif // WIFI_LINK_CACHE_H
@@ -0,0 +1,162 @@
+// Banc de mesure - Latence par appel du chiffrement et de la dérivation de clé de SecureStorage
+// À téléverser sur l'ESP32, ou à exécuter sur la cible hôte : oar_bench_storage --realtime --duration 0
+#include <Arduino.h>
+#include <mbedtls/gcm.h>
+#include "SecureStorage.h"
+
+// Nombre d'appels par mesure
+const int ITERATIONS = 500;
+
+// Secret représentatif (longueur d'un mot de passe Wi-Fi)
+const char* secret = "mot-de-passe-wifi-32-caracteres";
+
+SecureStorage storage;
+
+// Empêche le compilateur d'écarter les dérivations dont le résultat n'est pas utilisé
+volatile uint8_t sink;
+
+// Afficher la latence moyenne d'une mesure
+void report(const char* label, unsigned long elapsed) {
+  Serial.printf("%-44s %8.2f µs/appel\n", label, (double)elapsed / ITERATIONS);
+}
+
+// Ancien chemin : contexte GCM initialisé et clé AES étendue à chaque appel
+unsigned long benchGcmPerCall(const uint8_t* key) {
+  uint8_t nonce[12] = {0};
+  uint8_t output[64];
+  uint8_t tag[16];
+  size_t len = strlen(secret);
+
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 256);
+    nonce[0] = i;
+    mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, len, nonce, sizeof(nonce), NULL, 0,
+                              (const unsigned char*)secret, output, sizeof(tag), tag);
+    mbedtls_gcm_free(&gcm);
+  }
+  return micros() - start;
+}
+
+// Nouveau chemin : contexte GCM conservé, clé AES étendue une seule fois
+unsigned long benchGcmCached(const uint8_t* key) {
+  uint8_t nonce[12] = {0};
+  uint8_t output[64];
+  uint8_t tag[16];
+  size_t len = strlen(secret);
+
+  mbedtls_gcm_context gcm;
+  mbedtls_gcm_init(&gcm);
+  mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 256);
+
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    nonce[0] = i;
+    mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, len, nonce, sizeof(nonce), NULL, 0,
+                              (const unsigned char*)secret, output, sizeof(tag), tag);
+  }
+  unsigned long elapsed = micros() - start;
+
+  mbedtls_gcm_free(&gcm);
+  return elapsed;
+}
+
+// Ancienne dérivation, exécutée par le constructeur pendant l'initialisation statique
+unsigned long benchLegacyDerivation(const uint8_t* mac) {
+  uint8_t key[32];
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    SecureStorage::deriveLegacyKey(mac, key);
+    sink ^= key[0];
+  }
+  return micros() - start;
+}
+
+// HKDF-SHA256 (SHA-256 par l'accélérateur matériel sur ESP32)
+unsigned long benchHkdfDerivation(const uint8_t* mac) {
+  uint8_t key[32];
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    SecureStorage::hkdfSha256(mac, 6, key);
+    sink ^= key[0];
+  }
+  return micros() - start;
+}
+
+// Construction (coût ajouté au démarrage avant setup()) : la clé n'est plus dérivée ici
+unsigned long benchConstruction() {
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    SecureStorage instance;
+  }
+  return micros() - start;
+}
+
+// Premier déchiffrement d'une instance neuve : dérivation, expansion de la clé AES et lecture NVS
+unsigned long benchFirstRetrieve() {
+  char value[64];
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    SecureStorage instance;
+    instance.retrieveSecret("bench", value, sizeof(value));
+  }
+  return micros() - start;
+}
+
+// Appels complets de SecureStorage (NVS comprise) dans une session
+unsigned long benchStore() {
+  storage.beginSession(false);
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    storage.storeSecret("bench", secret);
+  }
+  unsigned long elapsed = micros() - start;
+  storage.endSession();
+  return elapsed;
+}
+
+unsigned long benchRetrieve() {
+  char value[64];
+  storage.beginSession(true);
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    storage.retrieveSecret("bench", value, sizeof(value));
+  }
+  unsigned long elapsed = micros() - start;
+  storage.endSession();
+  return elapsed;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Serial.println("=== Banc de mesure SecureStorage ===");
+  Serial.printf("%d appels par mesure, secret de %u octets\n", ITERATIONS, (unsigned)strlen(secret));
+
+  uint8_t key[32];
+  for (size_t i = 0; i < sizeof(key); i++) {
+    key[i] = i * 7;
+  }
+
+  uint8_t mac[6];
+  esp_read_mac(mac, ESP_MAC_WIFI_STA);
+  report("Dérivation rotations/xor (ancienne clé)", benchLegacyDerivation(mac));
+  report("Dérivation HKDF-SHA256", benchHkdfDerivation(mac));
+  report("Construction de SecureStorage", benchConstruction());
+
+  report("GCM, setkey à chaque appel (ancien chemin)", benchGcmPerCall(key));
+  report("GCM, contexte conservé (nouveau chemin)", benchGcmCached(key));
+  report("SecureStorage::storeSecret (NVS comprise)", benchStore());
+  report("SecureStorage::retrieveSecret (NVS comprise)", benchRetrieve());
+  report("Premier retrieveSecret d'une instance neuve", benchFirstRetrieve());
+
+  storage.deleteSecret("bench");
+}
+
+void loop() {
+  // Rien à faire ici
+  delay(1000);
+}
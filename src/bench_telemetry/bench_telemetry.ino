@@ -0,0 +1,108 @@
+// Banc de mesure - Coût d'encodage et taille sur le réseau d'une mesure, selon le format
+// À téléverser sur l'ESP32, ou à exécuter sur la cible hôte : oar_bench_telemetry --realtime --duration 0
+#include <Arduino.h>
+#include "TelemetryEncoder.h"
+
+// Nombre d'encodages par mesure
+const int ITERATIONS = 10000;
+
+// Surcoût d'un enregistrement TLS 1.2 AES-GCM : en-tête (5), nonce explicite (8), tag (16)
+const size_t TLS_RECORD_OVERHEAD = 5 + 8 + 16;
+
+// Résultat volatile pour que le compilateur ne supprime pas les boucles
+volatile size_t sink = 0;
+
+// Taille d'un paquet MQTT PUBLISH QoS 0 : en-tête fixe, longueur restante, topic, contenu
+size_t mqttPublishSize(const char* topic, size_t payload_len) {
+  size_t remaining = 2 + strlen(topic) + payload_len;
+  size_t length_bytes = 1;
+  for (size_t r = remaining; r >= 128; r /= 128) {
+    length_bytes++;
+  }
+  return 1 + length_bytes + remaining;
+}
+
+// Afficher le coût moyen d'encodage et le volume envoyé pour une mesure
+void report(const char* label, unsigned long elapsed, int messages, size_t payload_bytes, size_t wire_bytes) {
+  Serial.printf("%-30s %8.3f µs  %d msg  %3u o utiles  %3u o MQTT+TLS\n", label,
+                (double)elapsed / ITERATIONS, messages, (unsigned)payload_bytes, (unsigned)wire_bytes);
+}
+
+Reading sample(int i) {
+  Reading reading;
+  reading.timestamp = 3600000UL + i * 10000UL;
+  reading.seq = 360 + i;
+  reading.temperature = 21.3f + (i % 20) * 0.1f;
+  reading.humidity = 45.6f + (i % 10) * 0.1f;
+  reading.sensor = 0;
+  return reading;
+}
+
+// Ancien chemin : deux String(float) construites sur le tas
+void benchString() {
+  Reading reading = sample(0);
+  String t = String(reading.temperature);
+  String h = String(reading.humidity);
+  size_t payload = t.length() + h.length();
+  size_t wire = mqttPublishSize("sensors/temperature", t.length()) +
+                mqttPublishSize("sensors/humidity", h.length()) + 2 * TLS_RECORD_OVERHEAD;
+
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    reading = sample(i);
+    String temperature = String(reading.temperature);
+    String humidity = String(reading.humidity);
+    sink += temperature.length() + humidity.length();
+  }
+  report("texte, String(float) x2", micros() - start, 2, payload, wire);
+}
+
+// Format texte conservé, sans allocation
+void benchText() {
+  char t[TELEMETRY_TEXT_MAX_SIZE];
+  char h[TELEMETRY_TEXT_MAX_SIZE];
+  Reading reading = sample(0);
+  size_t tl = encodeTextValue(reading.temperature, t, sizeof(t));
+  size_t hl = encodeTextValue(reading.humidity, h, sizeof(h));
+  size_t wire = mqttPublishSize("sensors/temperature", tl) +
+                mqttPublishSize("sensors/humidity", hl) + 2 * TLS_RECORD_OVERHEAD;
+
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    reading = sample(i);
+    sink += encodeTextValue(reading.temperature, t, sizeof(t));
+    sink += encodeTextValue(reading.humidity, h, sizeof(h));
+  }
+  report("texte, encodeTextValue x2", micros() - start, 2, tl + hl, wire);
+}
+
+// Formats binaires : un seul message sur "sensors/telemetry"
+void benchBinary(const char* label, TelemetryFormat format) {
+  uint8_t payload[TELEMETRY_MAX_SIZE];
+  size_t len = encodeTelemetry(format, sample(0), payload, sizeof(payload));
+  size_t wire = mqttPublishSize("sensors/telemetry", len) + TLS_RECORD_OVERHEAD;
+
+  unsigned long start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    sink += encodeTelemetry(format, sample(i), payload, sizeof(payload));
+  }
+  report(label, micros() - start, 1, len, wire);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  Serial.println("=== Banc de mesure de l'encodage des mesures ===");
+  Serial.printf("%d encodages par format ; taille réseau par mesure (QoS 0, TLS 1.2 AES-GCM)\n", ITERATIONS);
+
+  benchString();
+  benchText();
+  benchBinary("structure fixe (packed)", TELEMETRY_PACKED);
+  benchBinary("CBOR", TELEMETRY_CBOR);
+}
+
+void loop() {
+  // Rien à faire ici
+  delay(1000);
+}
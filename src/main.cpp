@@ -4,12 +4,97 @@
 #include <PubSubClient.h>
 #include <DHT.h>
 #include <WiFiClientSecure.h>
+#include <ResumableTlsClient.h>
 #include "SecureStorage.h"
+#include "Reading.h"
+#include "RingBuffer.h"
+#include "TelemetryBacklog.h"
+#include "TelemetryEncoder.h"
+#include "WifiLinkCache.h"
+#include "Deadband.h"
+#include "RunningStats.h"
+#include "SensorFilter.h"
+#include "Metrics.h"
+#include "ReconnectBackoff.h"
+#include "MqttClient.h"
+#include "QueuedMqttClient.h"
+#include "Log.h"
+#ifdef OAR_DEEP_SLEEP
+#include <esp_sleep.h>
+#endif
+#ifdef OAR_LIGHT_SLEEP
+#include <esp_pm.h>
+#endif
+#ifdef OAR_LOCAL_CONTROL
+#include "ClimateControl.h"
+#include "BroadlinkIr.h"
+#include "ShellyPowerMeter.h"
+#endif
+
+#if defined(OAR_DEEP_SLEEP) && defined(OAR_LIGHT_SLEEP)
+#error "OAR_DEEP_SLEEP et OAR_LIGHT_SLEEP sont exclusifs"
+#endif
+#if defined(OAR_DEEP_SLEEP) && defined(OAR_LOCAL_CONTROL)
+#error "La régulation locale (OAR_LOCAL_CONTROL) demande une carte toujours éveillée"
+#endif
+
+// ------------------- REPARTITION SUR LES DEUX COEURS ------------------------
+// Sur ESP32, la lecture du capteur et le réseau (Wi-Fi, MQTT, TLS) tournent dans deux tâches
+// épinglées chacune sur un cœur. Définir OAR_SINGLE_CORE pour revenir à la boucle coopérative
+// (toujours utilisée par la cible hôte et par les modes sommeil profond et sommeil léger).
+// La régulation locale bloque la tâche qui l'exécute : lecture HTTP de la prise Shelly (connexion et
+// réponse, SHELLY_TIMEOUT_MS chacune, 2 s au plus) puis au plus trois échanges UDP avec le Broadlink
+// (découverte ou commande refusée, authentification, commande : BROADLINK_TIMEOUT_MS chacun, 1,5 s),
+// soit jusqu'à 3,5 s par lecture de la sonde.
+// Sur la carte, elle n'est donc permise qu'avec les deux cœurs, dans la tâche réseau : la boucle
+// coopérative retarderait d'autant la lecture du capteur. La cible hôte, en temps simulé, la garde.
+#if defined(ARDUINO_ARCH_ESP32) && !defined(OAR_SINGLE_CORE) && !defined(OAR_DEEP_SLEEP) && !defined(OAR_LIGHT_SLEEP)
+#define OAR_DUAL_CORE 1
+#else
+#define OAR_DUAL_CORE 0
+#endif
+#if defined(ARDUINO_ARCH_ESP32) && defined(OAR_LOCAL_CONTROL) && !OAR_DUAL_CORE
+#error "La régulation locale (OAR_LOCAL_CONTROL) bloque jusqu'à 3,5 s : elle demande les deux cœurs (ni OAR_SINGLE_CORE, ni OAR_LIGHT_SLEEP)"
+#endif
+
+// ------------------- RESUMES PAR FENETRE ------------------------
+// Le capteur est lu au rythme maximal du DHT22 et chaque fenêtre est résumée sur "sensors/summary".
+// Sans objet en sommeil profond (une seule lecture par réveil).
+#ifndef OAR_DEEP_SLEEP
+#define OAR_WINDOW_SUMMARY 1
+#else
+#define OAR_WINDOW_SUMMARY 0
+#endif
+
+// ------------------- PARAMETRAGES DES CAPTEURS DHT ------------------------
+// Table des sondes, fixée à la compilation : broche et type du capteur, suffixe des topics et
+// correction d'étalonnage ajoutée à chaque lecture. Une carte (et une session TLS) sert toutes
+// les sondes. La sonde au suffixe vide publie sur les topics historiques lus par regulationtemp.py,
+// les autres sur "sensors/temperature/<suffixe>", "sensors/humidity/<suffixe>"...
+// OAR_RACK_PROBES : quatre sondes par baie (entrée et sortie d'air, haut et bas).
+struct SensorProbe {
+  DHT dht;
+  const char* suffix;         // Suffixe des topics ("" : topics historiques)
+  float temperatureOffset;    // Correction d'étalonnage (°C)
+  float humidityOffset;       // Correction d'étalonnage (points d'humidité relative)
+};
 
-// ------------------- PARAMETRAGES DU CAPTEUR DHT ------------------------
 #define DHTPIN 4               // Définit la broche GPIO 4 de l'ESP32 pour le capteur DHT22
 #define DHTTYPE DHT22          // Spécifie que le capteur utilisé est le DHT22 (température et humidité)
-DHT dht(DHTPIN, DHTTYPE);      // Crée une instance du capteur DHT22 sur la broche définie
+SensorProbe probes[] = {
+#ifdef OAR_RACK_PROBES
+  {DHT(DHTPIN, DHTTYPE), "", 0.0f, 0.0f},        // Entrée d'air, régulée par la climatisation
+  {DHT(18, DHT22), "outlet", 0.0f, 0.0f},        // Sortie d'air
+  {DHT(19, DHT22), "top", 0.0f, 0.0f},           // Haut de la baie
+  {DHT(21, DHT22), "bottom", 0.0f, 0.0f},        // Bas de la baie
+#else
+  {DHT(DHTPIN, DHTTYPE), "", 0.0f, 0.0f},        // Sonde unique
+#endif
+};
+const size_t PROBE_COUNT = sizeof(probes) / sizeof(probes[0]);
+static_assert(PROBE_COUNT <= 8, "Au plus 8 sondes (file des résumés, lots de publication)");
+const unsigned long DHT_MIN_INTERVAL_MS = 2000; // Le DHT22 ne fournit pas de nouvelle mesure plus souvent
+const uint8_t SENSOR_MAX_RETRIES = 2;           // Nouveaux essais après une lecture invalide, avant l'échéance suivante
 
 // ------------------- CERTIFICAT DE L'AUTORITÉ DE CERTIFICATION ------------------------
 const char* ca_cert = R"(
@@ -36,176 +121,1277 @@ duFbrKQUkK7gIailBhhRcbvDJnkJOJsf0kgKgV5a3gkkL/GgQVVNQT0RIQiMLcBw
 )";  // Certificat du CA utilisé pour sécuriser la connexion MQTT via TLS/SSL
 
 // ------------------- OBJETS POUR LA CONNEXION WIFI ET MQTT ------------------------
-WiFiClientSecure espClient;     // Objet pour gérer la connexion sécurisée (SSL/TLS) Wi-Fi
-PubSubClient client(espClient); // Objet pour gérer la connexion MQTT via l'objet WiFiClientSecure
+ResumableTlsClient espClient;   // Objet pour gérer la connexion sécurisée (SSL/TLS), avec reprise de session
 SecureStorage storage;          // Instance de la classe SecureStorage pour récupérer les identifiants
 
-// Variables pour stocker les identifiants récupérés
-char wifi_ssid[64] = {0};
-char wifi_pass[64] = {0};
-char mqtt_server[64] = {0};
-int mqtt_port = 0;
-char mqtt_user[64] = {0};
-char mqtt_pass[64] = {0};
+// Identifiants Wi-Fi et MQTT récupérés depuis la NVS
+DeviceConfig config = {};
+
+// Dernière session TLS négociée avec le broker : en mémoire RTC, elle reste disponible
+// au réveil d'un sommeil profond et évite une poignée de main complète
+RTC_DATA_ATTR TlsSessionCache tlsSession = {};
+
+// Point d'accès (BSSID, canal) et bail DHCP de la dernière association : en mémoire RTC pour
+// le réveil d'un sommeil profond, avec une copie en NVS pour les démarrages à froid
+RTC_DATA_ATTR WifiLinkCache wifiLink = {};
+const char* WIFI_LINK_KEY = "wifi_link";
+
+// ------------------- PARAMETRAGES DE LA BOUCLE ------------------------
+// Aucune étape de loop() n'attend : chaque état vérifie son échéance avec millis() et rend la main
+#ifndef OAR_SAMPLE_INTERVAL_MS
+#define OAR_SAMPLE_INTERVAL_MS 10000
+#endif
+const unsigned long SAMPLE_INTERVAL_MS = OAR_SAMPLE_INTERVAL_MS;  // Période entre deux mesures soumises à la publication
+#if OAR_WINDOW_SUMMARY
+const unsigned long SENSOR_READ_MS = DHT_MIN_INTERVAL_MS;  // Lecture du DHT22 à son rythme maximal
+const unsigned long WINDOW_MS = 60000;           // Durée d'une fenêtre résumée
+#else
+const unsigned long SENSOR_READ_MS = SAMPLE_INTERVAL_MS;
+#endif
+// Chaque lecture d'un DHT22 bloque quelques millisecondes (trame lue interruptions masquées) :
+// les sondes sont lues à tour de rôle, réparties sur la période de lecture. En sommeil profond,
+// elles sont lues l'une après l'autre (une par tour de loop()) pour écourter le réveil.
+#if OAR_WINDOW_SUMMARY
+const unsigned long PROBE_STAGGER_MS = SENSOR_READ_MS / PROBE_COUNT;
+#else
+const unsigned long PROBE_STAGGER_MS = 0;
+#endif
+const unsigned long WIFI_RETRY_MS = 5000;        // Délai avant de relancer WiFi.begin()
+const unsigned long WIFI_FAST_TIMEOUT_MS = 2000; // Délai avant d'abandonner le point d'accès en cache
+// Tentatives MQTT : délai tiré entre la moitié et la totalité d'un plafond qui double à chaque
+// échec (1 s à 15 s) ; après 8 échecs consécutifs, le disjoncteur s'ouvre pour 60 à 75 s
+const BackoffPolicy MQTT_BACKOFF = {1000, 15000, 8, 60000};
+const int MQTT_WARN_ATTEMPTS = 5;                // Tentatives avant d'afficher un avertissement
+
+// ------------------- FORMAT DES MESURES ------------------------
+// TELEMETRY_TEXT garde les deux topics texte lus par regulationtemp.py ; TELEMETRY_PACKED ou
+// TELEMETRY_CBOR envoient un seul message binaire sur "sensors/telemetry" pour les mesures de
+// toutes les sondes publiées au même tour.
+#ifndef OAR_TELEMETRY_FORMAT
+#define OAR_TELEMETRY_FORMAT TELEMETRY_TEXT
+#endif
+const TelemetryFormat TELEMETRY_FORMAT = OAR_TELEMETRY_FORMAT;
+const size_t PUBLISH_BATCH = TELEMETRY_FORMAT == TELEMETRY_TEXT ? 1 : PROBE_COUNT;  // Mesures par message
+
+// États de la connexion réseau
+enum NetState {
+  NET_UNCONFIGURED,     // Pas d'identifiants : rien à faire
+  NET_WIFI_CONNECTING,  // Association Wi-Fi en cours
+  NET_MQTT_CONNECTING,  // Wi-Fi connecté, session MQTT à ouvrir
+  NET_ONLINE            // Session MQTT ouverte
+};
+
+NetState netState = NET_UNCONFIGURED;
+unsigned long netStateSince = 0;   // Dernière action de l'état courant (WiFi.begin, tentative MQTT)
+unsigned long nextSampleAt = 0;    // Échéance de la prochaine lecture, toutes sondes confondues
+RTC_DATA_ATTR uint32_t sampleSeq = 0;  // Numéro de séquence de la prochaine mesure (conservé en sommeil profond)
+bool wifiFastJoin = false;         // Association en cours directement sur le point d'accès en cache
+bool wifiLeaseReused = false;      // Association en cours avec l'adresse du bail en cache (sans DHCP)
+unsigned long wifiBeganAt = 0;     // Dernier appel à WiFi.begin()
+
+// État de chaque sonde, côté capteur
+struct ProbeState {
+  unsigned long nextReadAt;   // Échéance de la prochaine lecture (nouvel essai compris)
+  unsigned long gridAt;       // Prochaine échéance régulière de lecture
+  uint8_t retries;            // Nouveaux essais faits depuis la dernière échéance régulière
+  bool settled;               // Lecture valide ou essais épuisés depuis la dernière publication
+  bool fresh;                 // Lecture valide depuis la dernière publication
+  Reading latest;             // Dernière lecture filtrée (sans numéro de séquence)
+#if OAR_WINDOW_SUMMARY
+  WindowSummary window;       // Fenêtre en cours
+#endif
+};
+ProbeState probeStates[PROBE_COUNT];
+
+// Mesures en attente d'envoi : écrites par la tâche capteur, lues par la tâche réseau
+SpscRing<Reading, 32> readings;
+
+#if OAR_WINDOW_SUMMARY
+// Résumés en attente de publication, côté réseau
+unsigned long nextReportAt = 0;    // Échéance de la prochaine mesure soumise à la publication
+SpscRing<WindowSummary, 8> summaries;
+#endif
+
+// ------------------- PUBLICATION PAR EXCEPTION ------------------------
+// Une mesure n'est publiée que si la température ou l'humidité sort de sa bande morte autour de
+// la dernière valeur publiée, ou après HEARTBEAT_MS sans publication (détection des cartes muettes).
+// Les mesures filtrées ne prennent pas de numéro de séquence. Une référence par sonde.
+const DeadbandConfig DEADBANDS[2] = {
+  {0.1f, 0.0f},   // Température : 0,1 °C
+  {0.5f, 0.0f},   // Humidité : 0,5 point d'humidité relative
+};
+const unsigned long HEARTBEAT_MS = 60000;  // Silence maximal entre deux publications
+
+RTC_DATA_ATTR ReportFilter<2> reportFilters[PROBE_COUNT] = {};
+
+// ------------------- FILTRAGE DES LECTURES ------------------------
+// Médiane des 5 dernières lectures puis lissage exponentiel de coefficient 1/4, en virgule fixe.
+// Les mesures publiées (et donc la régulation) sont filtrées ; les résumés par fenêtre gardent
+// les lectures brutes pour montrer les pics.
+RTC_DATA_ATTR MedianEmaFilter<5, 2> temperatureFilters[PROBE_COUNT] = {};
+RTC_DATA_ATTR MedianEmaFilter<5, 2> humidityFilters[PROBE_COUNT] = {};
+
+// ------------------- RESERVE DES MESURES NON PUBLIEES ------------------------
+// Les mesures qui n'ont pas pu être publiées (broker absent, envoi en échec) sont gardées
+// puis rejouées par lots sur "sensors/backlog", à débit limité pour ne pas saturer le broker.
+// Avec OAR_BACKLOG_IN_RTC (implicite en mode sommeil profond), la réserve est en mémoire RTC
+// et survit au sommeil profond.
+// 20 octets par mesure. En sommeil profond, la réserve partage la mémoire RTC avec la file MQTT :
+// 128 mesures (2,5 Ko) au lieu de 192 (3,75 Ko), voir BUDGET DE LA MEMOIRE RTC
+#ifdef OAR_DEEP_SLEEP
+const size_t BACKLOG_CAPACITY = 128;
+#else
+const size_t BACKLOG_CAPACITY = 192;
+#endif
+const size_t REPLAY_BATCH = 10;                 // Mesures par message de rattrapage
+const uint16_t MQTT_BUFFER_SIZE = 512;          // Un lot complet doit tenir dans un paquet
+#ifdef OAR_DEEP_SLEEP
+const unsigned long REPLAY_INTERVAL_MS = 0;     // Tout rejouer d'un coup pour se rendormir au plus vite
+#else
+const unsigned long REPLAY_INTERVAL_MS = 500;   // Délai minimal entre deux messages de rattrapage
+#endif
+
+#if defined(OAR_BACKLOG_IN_RTC) || defined(OAR_DEEP_SLEEP)
+RTC_DATA_ATTR
+#endif
+TelemetryBacklog<BACKLOG_CAPACITY> backlog = {};
+unsigned long lastReplayAt = 0;
+
+// Temps écoulé depuis le démarrage à froid, sommeils profonds compris : horodatage des mesures
+// (millis() repart de zéro à chaque réveil)
+RTC_DATA_ATTR uint32_t rtcClockBaseMs = 0;
+
+unsigned long uptimeMs() {
+  return rtcClockBaseMs + millis();
+}
+
+// ------------------- CLIENT MQTT ------------------------
+// Par défaut, publish() dépose le message dans une file et rend la main : les messages partent
+// depuis client.loop(), en QoS 1 pour les mesures, avec au plus OAR_MQTT_WINDOW messages en attente
+// de leur PUBACK. Ceux en vol lors d'une perte de session repartent à la connexion suivante.
+// Avec OAR_MQTT_SYNC, PubSubClient publie en QoS 0 sur le transport TLS pendant l'appel.
+const uint8_t TELEMETRY_QOS = 1;        // Mesures, rattrapages, résumés et commandes de régulation
+#ifdef OAR_MQTT_SYNC
+PubSubClient pubSubClient(espClient);   // Objet pour gérer la connexion MQTT via l'objet WiFiClientSecure
+PubSubMqttClient mqttClient(pubSubClient);
+#else
+#ifndef OAR_MQTT_WINDOW
+#define OAR_MQTT_WINDOW 4
+#endif
+const QueuedMqttConfig MQTT_QUEUE = {
+  OAR_MQTT_WINDOW,  // Messages QoS 1 en vol au plus (-DOAR_MQTT_WINDOW=n)
+  10000,            // Un PUBACK attendu plus de 10 s ferme la session (renvoi à la reconnexion)
+  1024,             // Octets écrits au plus par client.loop()
+  15000,            // Attente du CONNACK
+};
+#ifdef OAR_DEEP_SLEEP
+// En mémoire RTC avec la réserve : les messages non acquittés attendent le réveil suivant
+const size_t MQTT_OUTBOX_BYTES = 1024;
+const size_t MQTT_OUTBOX_SLOTS = 16;
+RTC_DATA_ATTR
+#else
+const size_t MQTT_OUTBOX_BYTES = 2048;
+const size_t MQTT_OUTBOX_SLOTS = 24;
+#endif
+MqttOutbox<MQTT_OUTBOX_BYTES, MQTT_OUTBOX_SLOTS> mqttOutbox = {};
+QueuedMqttClient<MQTT_OUTBOX_BYTES, MQTT_OUTBOX_SLOTS, MQTT_BUFFER_SIZE> mqttClient(espClient, mqttOutbox,
+                                                                                  MQTT_QUEUE, uptimeMs);
+#endif
+MqttClient& client = mqttClient;
+
+// Espacement des tentatives MQTT (échéances en uptimeMs()) : en mémoire RTC, un disjoncteur
+// ouvert le reste d'un réveil à l'autre
+RTC_DATA_ATTR ReconnectBackoff mqttBackoff = {};
+
+#ifdef OAR_METRICS
+// ------------------- METRIQUES ------------------------
+// Durées des chemins critiques et niveaux du tas (src/Metrics.h), publiés sur "device/metrics".
+// En sommeil profond, les cumuls repartent de zéro à chaque réveil.
+const unsigned long METRICS_INTERVAL_MS = 60000;
+RTC_DATA_ATTR uint32_t nextMetricsAt = 0;   // Échéance de la prochaine publication (uptimeMs())
+#endif
+
+#ifdef OAR_LOCAL_CONTROL
+// ------------------- REGULATION LOCALE DU CLIMATISEUR ------------------------
+// L'hystérésis de regulationtemp.py est appliquée sur la carte à chaque lecture de la sonde
+// CONTROL_PROBE : commande IR par le Broadlink et consommation par la prise Shelly passent par le
+// réseau local, sans le broker ni le serveur. Le serveur ne fait plus que superviser
+// ("control/command" à chaque commande, "control/state" toutes les CONTROL_STATE_MS).
+const ControlConfig CONTROL = {
+  22.0f,    // Seuil haut (°C) : refroidir au-dessus
+  20.0f,    // Seuil bas (°C) : arrêter au-dessous
+  5.0f,     // Consommation (W) à partir de laquelle le climatiseur est en marche
+  30000     // Délai minimal entre deux commandes (ms), le temps que la prise mesure le nouvel état
+};
+const uint8_t CONTROL_PROBE = 0;
+const unsigned long CONTROL_STATE_MS = 60000;
+
+// Touche marche/arrêt du climatiseur apprise par le Broadlink (IR_COMMAND de regulationtemp.py)
+const uint8_t IR_COMMAND[] = {
+  0x26, 0x00, 0x48, 0x00, 0x00, 0x01, 0x22, 0x94, 0x13, 0x13, 0x12, 0x13, 0x12, 0x14, 0x12, 0x13,
+  0x12, 0x13, 0x12, 0x38, 0x12, 0x13, 0x12, 0x14, 0x12, 0x37, 0x12, 0x38, 0x12, 0x38, 0x12, 0x37,
+  0x13, 0x37, 0x12, 0x14, 0x12, 0x37, 0x12, 0x38, 0x12, 0x13, 0x13, 0x37, 0x12, 0x13, 0x13, 0x13,
+  0x12, 0x13, 0x12, 0x13, 0x12, 0x14, 0x12, 0x13, 0x12, 0x37, 0x13, 0x13, 0x12, 0x37, 0x13, 0x37,
+  0x13, 0x37, 0x12, 0x38, 0x12, 0x38, 0x12, 0x37, 0x13, 0x00, 0x0d, 0x05
+};
+
+BroadlinkIrTransport irTransport(IPAddress(192, 168, 5, 79));   // BROADLINK_IP de regulationtemp.py
+ShellyPowerMeter powerMeter(IPAddress(192, 168, 5, 251));       // SHELLY_IP de regulationtemp.py
+HysteresisControl climate = {};
+// Lectures filtrées de la sonde de régulation : écrites par la tâche capteur, lues par la tâche réseau
+SpscRing<Reading, 4> controlFeed;
+float controlTemperature = NAN;   // Dernière température soumise à la régulation
+float controlPower = NAN;         // Dernière consommation lue
+ControlAction lastControlAction = CONTROL_NONE;
+unsigned long nextControlStateAt = 0;   // Échéance de la prochaine publication de l'état (uptimeMs())
+#endif
+
+#ifdef OAR_DEEP_SLEEP
+// ------------------- MODE SOMMEIL PROFOND ------------------------
+// À chaque réveil : lecture du capteur, connexion (point d'accès, bail et session TLS en cache),
+// publication de la mesure et de la réserve, puis sommeil profond jusqu'à l'échéance suivante.
+const unsigned long AWAKE_BUDGET_MS = 15000;  // Au-delà, la mesure reste en réserve et la carte se rendort
+const unsigned long MIN_SLEEP_MS = 1000;
+
+// Durées du cycle précédent, publiées au cycle suivant pour régler le mode
+struct CycleStats {
+  uint32_t cycles;        // Réveils depuis le démarrage à froid
+  uint32_t timeouts;      // Cycles interrompus par AWAKE_BUDGET_MS
+  uint32_t lastAwakeMs;   // Durée d'éveil du cycle précédent
+  uint32_t maxAwakeMs;
+};
+RTC_DATA_ATTR CycleStats cycleStats = {};
+
+bool cycleSampled = false;         // Lecture de toutes les sondes faite pendant ce réveil
+unsigned long cycleWifiMs = 0;     // Instant de l'association Wi-Fi (0 : pas encore)
+unsigned long cycleOnlineMs = 0;   // Instant de l'ouverture de la session MQTT
+bool cycleReported = false;
+#endif
+
+// ------------------- BUDGET DE LA MEMOIRE RTC ------------------------
+// Les variables RTC_DATA_ATTR partagent les 8 Ko de la mémoire RTC lente avec ESP-IDF (données
+// RTC du système, 512 octets réservés au coprocesseur ULP par le cœur Arduino) : le budget laisse
+// 2 Ko à ces derniers. En sommeil profond : 5,6 à 5,9 Ko selon les options, dont 2,5 Ko de réserve
+// et 1,4 Ko de file MQTT.
+const size_t RTC_DATA_BUDGET = 6 * 1024;
+const size_t RTC_DATA_USED = sizeof(tlsSession) + sizeof(wifiLink) + sizeof(sampleSeq) +
+                             sizeof(reportFilters) + sizeof(temperatureFilters) + sizeof(humidityFilters) +
+                             sizeof(rtcClockBaseMs) + sizeof(mqttBackoff)
+#if defined(OAR_BACKLOG_IN_RTC) || defined(OAR_DEEP_SLEEP)
+                             + sizeof(backlog)
+#endif
+#if defined(OAR_DEEP_SLEEP) && !defined(OAR_MQTT_SYNC)
+                             + sizeof(mqttOutbox)
+#endif
+#ifdef OAR_DEEP_SLEEP
+                             + sizeof(cycleStats)
+#endif
+#ifdef OAR_METRICS
+                             + sizeof(nextMetricsAt)
+#endif
+                             ;
+static_assert(RTC_DATA_USED <= RTC_DATA_BUDGET, "Variables RTC_DATA_ATTR au-delà du budget de la mémoire RTC");
+
+#ifdef OAR_LIGHT_SLEEP
+// ------------------- MODE SOMMEIL LEGER ------------------------
+// Pour rester joignable entre deux lectures : la session MQTT reste ouverte et la boucle se
+// bloque jusqu'à la prochaine échéance ou l'arrivée de données du broker. Le CPU passe alors en
+// sommeil léger automatique, la radio (économie d'énergie du modem) ne se réveille qu'aux
+// balises DTIM, où le point d'accès livre les trames gardées pour la carte.
+const uint16_t MQTT_KEEPALIVE_S = 60;   // Un PINGREQ au plus par minute sans publication
+const unsigned long IDLE_POLL_MS = 20;  // Attente maximale pendant une connexion ou un rattrapage
+
+#if defined(ESP_IDF_VERSION_MAJOR) && ESP_IDF_VERSION_MAJOR < 5
+typedef esp_pm_config_esp32_t esp_pm_config_t;  // Cœur Arduino 2.x (ESP-IDF 4.4)
+#endif
+#endif
+
+#if OAR_DUAL_CORE
+const BaseType_t SENSOR_CORE = 1;      // Cœur applicatif, à l'écart de la pile Wi-Fi
+const BaseType_t NETWORK_CORE = 0;     // Cœur de la pile Wi-Fi/lwIP
+const unsigned long NETWORK_TICK_MS = 10;
+#endif
+
+// Envoyer (ou déposer dans la file) un message MQTT en mesurant la durée de l'appel
+bool mqttPublish(const char* topic, const char* payload, uint8_t qos = 0) {
+  METRIC_SCOPE(METRIC_PUBLISH);
+  return client.publish(topic, payload, qos);
+}
+
+bool mqttPublish(const char* topic, const uint8_t* payload, unsigned int length, uint8_t qos = 0) {
+  METRIC_SCOPE(METRIC_PUBLISH);
+  return client.publish(topic, payload, length, qos);
+}
+
+// Publier la durée de la dernière poignée de main TLS et les cumuls depuis le démarrage
+void publishHandshakeStats() {
+  const HandshakeStats& stats = espClient.handshakeStats();
+  char payload[160];
+  snprintf(payload, sizeof(payload),
+           "{\"last_ms\":%lu,\"resumed\":%s,\"full\":%lu,\"resumed_count\":%lu,"
+           "\"failed\":%lu,\"avg_full_ms\":%lu,\"avg_resumed_ms\":%lu}",
+           (unsigned long)stats.lastMs, stats.lastResumed ? "true" : "false",
+           (unsigned long)stats.full, (unsigned long)stats.resumed, (unsigned long)stats.failed,
+           (unsigned long)stats.averageFullMs(), (unsigned long)stats.averageResumedMs());
+  LOG_DEBUG("Poignée de main TLS : %s", payload);
+  mqttPublish("device/tls", payload);
+}
+
+// ------------------- MESSAGES ENTRANTS ------------------------
+// "device/ping" : le contenu est renvoyé tel quel sur "device/pong", l'émetteur mesure
+// l'aller-retour (latence de réveil comprise en mode sommeil léger)
+void onMqttMessage(char* topic, uint8_t* payload, unsigned int length) {
+  if (strcmp(topic, "device/ping") == 0) {
+    // PubSubClient publie depuis le même buffer : copier le contenu avant de répondre
+    uint8_t echo[64];
+    unsigned int len = length < sizeof(echo) ? length : sizeof(echo);
+    memcpy(echo, payload, len);
+    mqttPublish("device/pong", echo, len);
+  }
+}
+
+// Publier les compteurs de reconnexion, à chaque connexion réussie
+void publishBackoffStats(uint16_t failures) {
+  char payload[128];
+  snprintf(payload, sizeof(payload),
+           "{\"attempts\":%lu,\"failures\":%u,\"successes\":%lu,\"breaker_opens\":%lu,\"last_delay_ms\":%lu}",
+           (unsigned long)mqttBackoff.attempts, (unsigned)failures, (unsigned long)mqttBackoff.successes,
+           (unsigned long)mqttBackoff.breakerOpens, (unsigned long)mqttBackoff.lastDelayMs);
+  mqttPublish("device/reconnect", payload);
+}
+
+#ifndef OAR_MQTT_SYNC
+// Publier les compteurs de la file MQTT (renvois, délais d'acquittement), à chaque connexion
+void publishOutboxStats() {
+  const MqttOutboxStats& stats = mqttClient.stats();
+  char payload[192];
+  snprintf(payload, sizeof(payload),
+           "{\"queued\":%lu,\"rejected\":%lu,\"sent\":%lu,\"retransmits\":%lu,\"acked\":%lu,"
+           "\"avg_ack_ms\":%lu,\"max_ack_ms\":%lu,\"high_water\":%u,\"window\":%u}",
+           (unsigned long)stats.queued, (unsigned long)stats.rejected, (unsigned long)stats.sent,
+           (unsigned long)stats.retransmits, (unsigned long)stats.acked,
+           (unsigned long)(stats.acked ? stats.ackTotalMs / stats.acked : 0), (unsigned long)stats.ackMaxMs,
+           (unsigned)stats.highWater, (unsigned)MQTT_QUEUE.window);
+  mqttPublish("device/mqtt", payload);
+}
+#endif
 
 // ------------------- FONCTION DE RECONNEXION MQTT ------------------------
-void reconnect() {
-  // Boucler jusqu'à ce que nous soyons reconnectés
-  int tentatives = 0;
-  while (!client.connected() && tentatives < 5) {
-    Serial.print("Tentative de connexion MQTT...");
-    tentatives++;
+// Une seule tentative par appel : loop() espace les tentatives selon MQTT_BACKOFF
+bool reconnect() {
+  METRIC_SCOPE(METRIC_RECONNECT);
+  LOG_INFO("Tentative de connexion MQTT...");
+  mqttBackoff.onAttempt();
+  
+  // Identifiant propre à la carte (fin de la MAC) : le broker ferme la session d'un client
+  // dès qu'un autre se connecte avec le même identifiant
+  uint8_t mac[6];
+  esp_wifi_get_mac(WIFI_IF_STA, mac);
+  char clientId[24];
+  snprintf(clientId, sizeof(clientId), "ESP32Client-%02X%02X%02X", mac[3], mac[4], mac[5]);
+  
+  // Tentative de connexion avec les identifiants récupérés
+  // (la poignée de main TLS reste bloquante le temps de l'échange avec le broker)
+  if (client.connect(clientId, config.mqtt_user, config.mqtt_pass)) {
+    LOG_INFO("Connecté au broker MQTT!");
+    uint16_t failures = mqttBackoff.failures;
+    mqttBackoff.onSuccess();
+    METRIC_HEAP();  // Tampons TLS et MQTT alloués
+    publishHandshakeStats();
+    publishBackoffStats(failures);
+#ifndef OAR_MQTT_SYNC
+    publishOutboxStats();
+#endif
     
-    // Tentative de connexion avec les identifiants récupérés
-    if (client.connect("ESP32Client", mqtt_user, mqtt_pass)) {
-      Serial.println("Connecté au broker MQTT!");
-      
-      // Souscription aux topics si nécessaire
-      // client.subscribe("commandes/led");
-      
-      // Publier un message pour signaler la connexion
-      client.publish("device/status", "ESP32 connecté");
-    } else {
-      Serial.print("Échec, code d'erreur: ");
-      Serial.print(client.state());
-      Serial.println(" Nouvelle tentative dans 2 secondes...");
-      delay(2000);
-    }
+    // Souscription aux topics si nécessaire
+    // client.subscribe("commandes/led");
+    client.subscribe("device/ping");
+    
+    // Publier un message pour signaler la connexion
+    mqttPublish("device/status", "ESP32 connecté");
+    return true;
   }
   
-  if (!client.connected() && tentatives >= 5) {
-    Serial.println("Impossible de se connecter au broker MQTT après 5 tentatives.");
-    Serial.println("Vérifiez les identifiants MQTT ou la connectivité du serveur.");
+  mqttBackoff.onFailure(MQTT_BACKOFF, uptimeMs(), esp_random());
+  LOG_WARN("Échec, code d'erreur: %d Nouvelle tentative dans %lu ms%s", client.state(),
+           (unsigned long)mqttBackoff.lastDelayMs,
+           mqttBackoff.breaker == BREAKER_OPEN ? " (disjoncteur ouvert)" : "");
+  
+  if (mqttBackoff.failures == MQTT_WARN_ATTEMPTS) {
+    LOG_ERROR("Impossible de se connecter au broker MQTT après 5 tentatives.");
+    LOG_ERROR("Vérifiez les identifiants MQTT ou la connectivité du serveur.");
   }
+  return false;
 }
 
 // Fonction pour récupérer et afficher toutes les informations stockées
+// (mots de passe masqués : le port série est lisible par quiconque y branche un câble)
 void displayAllStoredInformation() {
-  Serial.println("\n=== Informations récupérées depuis la NVS ===");
+  LOG_INFO("=== Informations récupérées depuis la NVS ===");
   
   // Affichage des informations Wi-Fi
-  Serial.print("SSID Wi-Fi: ");
-  Serial.println(wifi_ssid);
-  Serial.print("Mot de passe Wi-Fi: ");
-  Serial.println(wifi_pass);
+  LOG_INFO("SSID Wi-Fi: %s", config.wifi_ssid);
+  LOG_INFO("Mot de passe Wi-Fi: %s", LOG_SECRET(config.wifi_pass));
   
   // Affichage des informations MQTT
-  Serial.print("Serveur MQTT: ");
-  Serial.println(mqtt_server);
-  Serial.print("Port MQTT: ");
-  Serial.println(mqtt_port);
-  Serial.print("Utilisateur MQTT: ");
-  Serial.println(mqtt_user);
-  Serial.print("Mot de passe MQTT: ");
-  Serial.println(mqtt_pass);
+  LOG_INFO("Serveur MQTT: %s", config.mqtt_server);
+  LOG_INFO("Port MQTT: %u", (unsigned)config.mqtt_port);
+  LOG_INFO("Utilisateur MQTT: %s", config.mqtt_user);
+  LOG_INFO("Mot de passe MQTT: %s", LOG_SECRET(config.mqtt_pass));
 }
 
-// ------------------- FONCTION D'INITIALISATION (SETUP) ------------------------
-void setup() {
-  // Initialisation de la communication série pour le debug
-  Serial.begin(115200);
-  delay(1000);
+// Changer d'état réseau en notant l'instant de la transition
+void setNetState(NetState state, unsigned long now) {
+  netState = state;
+  netStateSince = now;
+}
+
+// ------------------- CONNEXION WI-FI ------------------------
+// Le bail en cache ne sert qu'en sommeil profond, où chaque association ne dure qu'un cycle.
+// Une carte toujours éveillée garde son association : configurée en adresse statique, elle ne
+// renouvellerait jamais le bail, elle repasse donc par le DHCP même sur le point d'accès en cache
+bool leaseReusable() {
+#ifdef OAR_DEEP_SLEEP
+  return wifiLink.hasLease(uptimeMs());
+#else
+  return false;
+#endif
+}
+
+// Lancer l'association : directement sur le point d'accès en cache (sans balayer les canaux,
+// et sans DHCP si le bail peut être réutilisé) ou, sinon, par un balayage complet
+void startWifi(unsigned long now, bool allowFastJoin) {
+  wifiFastJoin = allowFastJoin && wifiLink.matches(config.wifi_ssid);
+  wifiLeaseReused = wifiFastJoin && leaseReusable();
   
-  Serial.println("=== Programme principal avec récupération des identifiants Wi-Fi et MQTT ===");
-  WiFi.persistent(false);
+  if (wifiLeaseReused) {
+    WiFi.config(IPAddress(wifiLink.ip), IPAddress(wifiLink.gateway), IPAddress(wifiLink.subnet),
+                IPAddress(wifiLink.dns));
+  } else {
+    // Adresse nulle : retour au DHCP (après une association rapide précédente en adresse statique)
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());
+  }
   
-  // Initialisation du capteur DHT22
-  dht.begin();
+  if (wifiFastJoin) {
+    WiFi.begin(config.wifi_ssid, config.wifi_pass, wifiLink.channel, wifiLink.bssid);
+  } else {
+    WiFi.begin(config.wifi_ssid, config.wifi_pass);
+  }
+  wifiBeganAt = now;
+  setNetState(NET_WIFI_CONNECTING, now);
+}
+
+// Mémoriser le point d'accès et le bail de l'association qui vient d'aboutir ;
+// la copie en NVS n'est réécrite que s'ils ont changé
+void rememberWifiLink(unsigned long now) {
+  METRIC_RECORD(METRIC_WIFI_JOIN, (now - wifiBeganAt) * 1000UL);
+  LOG_INFO("Connecté au Wi-Fi en %lu ms (%s)", now - wifiBeganAt,
+           !wifiFastJoin ? "balayage complet" : wifiLeaseReused ? "point d'accès et bail en cache" : "point d'accès en cache");
   
-  // Récupération des identifiants Wi-Fi depuis le stockage sécurisé
-  Serial.println("Récupération des identifiants Wi-Fi depuis la mémoire NVS...");
+  // Un bail réutilisé garde la date de son obtention, sans quoi il ne vieillirait jamais
+  uint32_t leaseAtMs = wifiLeaseReused ? wifiLink.leaseAtMs : uptimeMs();
+  bool changed = wifiLink.update(config.wifi_ssid, WiFi.BSSID(), WiFi.channel(), WiFi.localIP(),
+                                 WiFi.gatewayIP(), WiFi.subnetMask(), WiFi.dnsIP());
+  wifiLink.leaseAtMs = leaseAtMs;
+  wifiLink.seal();
+  if (changed && !storage.storeBlob(WIFI_LINK_KEY, &wifiLink, sizeof(wifiLink))) {
+    LOG_ERROR("Erreur lors de la sauvegarde du point d'accès.");
+  }
+}
+
+// Retrouver le point d'accès de la dernière association : en RTC après un sommeil profond,
+// sinon dans la copie en NVS
+void loadWifiLink() {
+  if (wifiLink.matches(config.wifi_ssid)) {
+    return;
+  }
+  if (storage.retrieveBlob(WIFI_LINK_KEY, &wifiLink, sizeof(wifiLink)) && wifiLink.matches(config.wifi_ssid)) {
+    // Bail antérieur à la coupure d'alimentation : uptimeMs() repart de zéro, son âge est
+    // inconnu, repasser par le DHCP
+    wifiLink.ip = 0;
+    wifiLink.seal();
+  } else {
+    wifiLink.clear();
+  }
+}
+
+// ------------------- MACHINE A ETATS RESEAU ------------------------
+void networkStep(unsigned long now) {
+  switch (netState) {
+    case NET_UNCONFIGURED:
+      break;
+      
+    case NET_WIFI_CONNECTING:
+      if (WiFi.status() == WL_CONNECTED) {
+        rememberWifiLink(now);
+        LOG_INFO("Adresse IP: %s", WiFi.localIP().toString().c_str());
+        // Première tentative MQTT sans attendre, sauf délai de reconnexion en cours
+        setNetState(NET_MQTT_CONNECTING, now);
+      } else if (wifiFastJoin && now - netStateSince >= WIFI_FAST_TIMEOUT_MS) {
+        // Point d'accès introuvable sur le canal en cache (changement de canal, autre borne)
+        LOG_WARN("Point d'accès en cache introuvable, balayage complet...");
+        startWifi(now, false);
+      } else if (now - netStateSince >= WIFI_RETRY_MS) {
+        LOG_WARN("Wi-Fi déconnecté. Tentative de reconnexion...");
+        startWifi(now, true);
+      }
+      break;
+      
+    case NET_MQTT_CONNECTING:
+    case NET_ONLINE:
+      // Vérifier si on est toujours connecté au Wi-Fi
+      if (WiFi.status() != WL_CONNECTED) {
+        LOG_WARN("Wi-Fi déconnecté. Tentative de reconnexion...");
+        startWifi(now, true);
+        break;
+      }
+      
+      if (netState == NET_ONLINE) {
+        if (client.connected()) {
+          client.loop(); // Gère l'écoute des messages MQTT entrants et la gestion de la communication
+          break;
+        }
+        // Session perdue (redémarrage du broker ?) : première tentative après une gigue, pour
+        // ne pas revenir au même instant que les autres cartes
+        mqttBackoff.onDisconnect(MQTT_BACKOFF, uptimeMs(), esp_random());
+        setNetState(NET_MQTT_CONNECTING, now);
+      }
+      
+      if (mqttBackoff.due(uptimeMs())) {
+        setNetState(reconnect() ? NET_ONLINE : NET_MQTT_CONNECTING, millis());
+      }
+      break;
+  }
+}
+
+// ------------------- ECHANTILLONNAGE ET PUBLICATION ------------------------
+// Suffixe des topics d'une sonde (vide pour un index inconnu, réserve RTC corrompue)
+const char* probeSuffix(uint8_t sensor) {
+  return sensor < PROBE_COUNT ? probes[sensor].suffix : "";
+}
+
+// Topic d'une sonde : "base" pour la sonde au suffixe vide, "base/suffixe" sinon
+const char* probeTopic(char* out, size_t size, const char* base, uint8_t sensor) {
+  const char* suffix = probeSuffix(sensor);
+  if (suffix[0]) {
+    snprintf(out, size, "%s/%s", base, suffix);
+  } else {
+    snprintf(out, size, "%s", base);
+  }
+  return out;
+}
+
+// Publier une mesure au format texte historique : une valeur par topic
+bool publishReadingText(const Reading& reading) {
+  char value[TELEMETRY_TEXT_MAX_SIZE];
+  char topic[48];
+  bool success = true;
   
-  bool wifi_creds_ok = storage.retrieveSecret("wifi_ssid", wifi_ssid, sizeof(wifi_ssid)) &&
-                      storage.retrieveSecret("wifi_pass", wifi_pass, sizeof(wifi_pass));
+  // Envoi de la température au broker MQTT sur le topic "sensors/temperature"
+  if (encodeTextValue(reading.temperature, value, sizeof(value)) &&
+      mqttPublish(probeTopic(topic, sizeof(topic), "sensors/temperature", reading.sensor), value, TELEMETRY_QOS)) {
+    LOG_INFO("Température envoyée : %s", value);
+  } else {
+    LOG_ERROR("Erreur lors de l'envoi de la température.");
+    success = false;
+  }
   
-  // Récupération des informations MQTT depuis le stockage sécurisé
-  Serial.println("Récupération des informations MQTT depuis la mémoire NVS...");
+  // Envoi de l'humidité au broker MQTT sur le topic "sensors/humidity"
+  if (encodeTextValue(reading.humidity, value, sizeof(value)) &&
+      mqttPublish(probeTopic(topic, sizeof(topic), "sensors/humidity", reading.sensor), value, TELEMETRY_QOS)) {
+    LOG_INFO("Humidité envoyée : %s", value);
+  } else {
+    LOG_ERROR("Erreur lors de l'envoi de l'humidité.");
+    success = false;
+  }
   
-  bool mqtt_creds_ok = storage.retrieveSecret("mqtt_server", mqtt_server, sizeof(mqtt_server)) &&
-                      storage.retrieveInt("mqtt_port", &mqtt_port) &&
-                      storage.retrieveSecret("mqtt_user", mqtt_user, sizeof(mqtt_user)) &&
-                      storage.retrieveSecret("mqtt_pass", mqtt_pass, sizeof(mqtt_pass));
+  return success;
+}
+
+// Publier en direct jusqu'à PUBLISH_BATCH mesures ; false si l'envoi a échoué
+bool publishReadings(const Reading* batch, size_t count) {
+  if (TELEMETRY_FORMAT == TELEMETRY_TEXT) {
+    return publishReadingText(batch[0]);
+  }
   
-  if (wifi_creds_ok && mqtt_creds_ok) {
-    // Affichage de toutes les informations récupérées
-    displayAllStoredInformation();
-    
-    // Connexion au réseau Wi-Fi avec les identifiants récupérés
-    Serial.println("\nConnexion au Wi-Fi...");
-    WiFi.begin(wifi_ssid, wifi_pass);
-    
-    // Attente que la connexion Wi-Fi soit établie (avec timeout)
-    int tentatives = 0;
-    while (WiFi.status() != WL_CONNECTED && tentatives < 30) {
-      delay(1000);
-      Serial.print(".");
-      tentatives++;
-    }
-    
-    if (WiFi.status() == WL_CONNECTED) {
-      Serial.println("\nConnecté au Wi-Fi!");
-      Serial.print("Adresse IP: ");
-      Serial.println(WiFi.localIP());
-      
-      // Charger le certificat de l'autorité de certification pour établ
-      espClient.setCACert(ca_cert);
-      
-      // Configuration du serveur MQTT
-      client.setServer(mqtt_server, mqtt_port);
-    } else {
-      Serial.println("\nImpossible de se connecter au Wi-Fi. Vérifiez les identifiants.");
+  // Un seul message sur "sensors/telemetry" pour toutes les sondes : un enregistrement par mesure
+  // (température, humidité, horodatage, séquence, sonde)
+  uint8_t payload[PROBE_COUNT * TELEMETRY_MAX_SIZE];
+  size_t len = 0;
+  bool encoded = true;
+  for (size_t i = 0; i < count; i++) {
+    size_t recordLen = encodeTelemetry(TELEMETRY_FORMAT, batch[i], payload + len, sizeof(payload) - len);
+    encoded = encoded && recordLen > 0;
+    len += recordLen;
+  }
+  if (!encoded || len == 0 || !mqttPublish("sensors/telemetry", payload, len, TELEMETRY_QOS)) {
+    LOG_ERROR("Erreur lors de l'envoi des mesures.");
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    LOG_INFO("Mesure %lu envoyée (sonde %u) : %.2f °C, %.2f %%", (unsigned long)batch[i].seq,
+             (unsigned)batch[i].sensor, batch[i].temperature, batch[i].humidity);
+  }
+  return true;
+}
+
+// Rejouer un lot de la réserve : une ligne "seq;age_ms;temperature;humidite" par mesure (suivie
+// de ";suffixe" pour une sonde autre que celle des topics historiques), l'âge permettant au
+// consommateur de retrouver l'heure de la lecture. Un lot n'est déposé qu'une fois la file MQTT
+// écrite : la réserve ne déborde pas dans la file.
+void replayBacklog(unsigned long now) {
+  if (backlog.empty() || netState != NET_ONLINE || client.pending() > 0 ||
+      now - lastReplayAt < REPLAY_INTERVAL_MS) {
+    return;
+  }
+  lastReplayAt = now;
+  
+  char payload[REPLAY_BATCH * 48];
+  size_t len = 0;
+  size_t batch = 0;
+  while (batch < REPLAY_BATCH && batch < backlog.size()) {
+    const Reading& reading = backlog.peek(batch);
+    const char* suffix = probeSuffix(reading.sensor);
+    int lineLen = snprintf(payload + len, sizeof(payload) - len, "%lu;%lu;%.2f;%.2f%s%s\n",
+                           (unsigned long)reading.seq, (unsigned long)(uptimeMs() - reading.timestamp),
+                           reading.temperature, reading.humidity, suffix[0] ? ";" : "", suffix);
+    if (lineLen < 0 || (size_t)lineLen >= sizeof(payload) - len) {
+      break; // Ligne reportée au lot suivant
     }
+    len += lineLen;
+    batch++;
+  }
+  
+  if (!mqttPublish("sensors/backlog", (const uint8_t*)payload, len, TELEMETRY_QOS)) {
+    LOG_ERROR("Erreur lors de l'envoi d'un lot de la réserve.");
+    return;
+  }
+  backlog.discard(batch);
+  
+  if (backlog.empty()) {
+    char stats[96];
+    snprintf(stats, sizeof(stats), "{\"replayed\":%lu,\"dropped\":%lu,\"high_water\":%u}",
+             (unsigned long)backlog.replayed, (unsigned long)backlog.dropped, (unsigned)backlog.highWater);
+    mqttPublish("device/backlog", stats);
+    LOG_INFO("Réserve vidée : %s", stats);
+  }
+}
+
+#if OAR_WINDOW_SUMMARY
+// Publier le résumé d'une fenêtre : nombre de lectures, minimum, maximum, moyenne, variance et
+// écart type de chaque grandeur
+size_t formatStats(char* out, size_t size, const char* name, const RunningStats& stats) {
+  int len = snprintf(out, size, "\"%s\":{\"min\":%.2f,\"max\":%.2f,\"mean\":%.3f,\"var\":%.4f,\"std\":%.3f}",
+                     name, stats.min, stats.max, stats.mean, stats.variance(), stats.stddev());
+  return len > 0 && (size_t)len < size ? len : 0;
+}
+
+void publishSummary(const WindowSummary& summary) {
+  char payload[320];
+  size_t len = snprintf(payload, sizeof(payload), "{\"start_ms\":%lu,\"window_ms\":%lu,\"count\":%lu,",
+                        (unsigned long)summary.start, (unsigned long)summary.duration,
+                        (unsigned long)summary.temperature.count);
+  len += formatStats(payload + len, sizeof(payload) - len, "temperature", summary.temperature);
+  payload[len++] = ',';
+  len += formatStats(payload + len, sizeof(payload) - len, "humidity", summary.humidity);
+  payload[len++] = '}';
+  payload[len] = '\0';
+  
+  char topic[48];
+  if (mqttPublish(probeTopic(topic, sizeof(topic), "sensors/summary", summary.sensor), payload, TELEMETRY_QOS)) {
+    LOG_DEBUG("Résumé envoyé : %s", payload);
   } else {
-    Serial.println("Erreur lors de la récupération des identifiants Wi-Fi!");
-    Serial.println("Veuillez d'abord exécuter le programme de stockage des identifiants.");
+    LOG_ERROR("Erreur lors de l'envoi du résumé.");
   }
 }
+#endif
 
-// ------------------- BOUCLE PRINCIPALE (LOOP) ------------------------
-void loop() {
-  // Vérifier si on est connecté au Wi-Fi
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("Wi-Fi déconnecté. Tentative de reconnexion...");
-    WiFi.begin(wifi_ssid, wifi_pass);
-    delay(5000);
+#ifdef OAR_METRICS
+// Publier les métriques : un message pour le tas, puis un par chemin mesuré
+// (nombre, minimum, moyenne, maximum et histogramme < 100 µs, < 1 ms, ..., >= 1 s)
+void publishMetrics() {
+  uint32_t now = uptimeMs();
+  if (netState != NET_ONLINE || (int32_t)(now - nextMetricsAt) < 0) {
     return;
   }
+  nextMetricsAt = now + METRICS_INTERVAL_MS;
+  METRIC_HEAP();
+  
+  const MetricsRegistry& registry = metrics();
+  char payload[192];
+  snprintf(payload, sizeof(payload),
+           "{\"metric\":\"heap\",\"free\":%lu,\"min_free\":%lu,\"max_block\":%lu,\"min_max_block\":%lu}",
+           (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(),
+           (unsigned long)ESP.getMaxAllocHeap(), (unsigned long)registry.heap.minMaxBlock);
+  mqttPublish("device/metrics", payload);
+  LOG_DEBUG("Métriques : %s", payload);
   
-  // Si le client MQTT n'est pas connecté, on tente de se reconnecter
-  if (!client.connected()) {
-    reconnect();
+  for (int id = 0; id < METRIC_COUNT; id++) {
+    const TimingStats& stats = registry.timings[id];
+    if (stats.count == 0) {
+      continue;
+    }
+    snprintf(payload, sizeof(payload),
+             "{\"metric\":\"%s\",\"count\":%lu,\"min_us\":%lu,\"avg_us\":%lu,\"max_us\":%lu,"
+             "\"hist\":[%lu,%lu,%lu,%lu,%lu,%lu]}",
+             metricName((MetricId)id), (unsigned long)stats.count, (unsigned long)stats.minUs,
+             (unsigned long)stats.averageUs(), (unsigned long)stats.maxUs,
+             (unsigned long)stats.buckets[0], (unsigned long)stats.buckets[1], (unsigned long)stats.buckets[2],
+             (unsigned long)stats.buckets[3], (unsigned long)stats.buckets[4], (unsigned long)stats.buckets[5]);
+    mqttPublish("device/metrics", payload);
+    LOG_DEBUG("Métriques : %s", payload);
+  }
+}
+#endif
+
+// Côté réseau : vider la file des mesures, garder en réserve celles qui ne partent pas
+void drainReadings() {
+#ifdef OAR_DEEP_SLEEP
+  // La mesure du réveil attend la connexion dans la file : dutyCycleStep() ne la met en réserve
+  // que si le budget d'éveil est épuisé
+  if (netState != NET_ONLINE) {
+    return;
   }
+#endif
+  // Les mesures d'un même tour sont déposées ensemble dans la file : elles partent dans le même
+  // message (formats binaires)
+  Reading batch[PROBE_COUNT];
+  for (;;) {
+    size_t count = 0;
+    while (count < PUBLISH_BATCH && readings.pop(batch[count])) {
+      count++;
+    }
+    if (count == 0) {
+      break;
+    }
+    if (netState == NET_ONLINE && publishReadings(batch, count)) {
+      continue;
+    }
+    if (netState != NET_ONLINE) {
+      LOG_WARN("Broker MQTT non connecté, mesure mise en réserve.");
+    }
+    for (size_t i = 0; i < count; i++) {
+      backlog.push(batch[i]);
+    }
+  }
+  replayBacklog(millis());
   
-  client.loop(); // Gère l'écoute des messages MQTT entrants et la gestion de la communication
+#if OAR_WINDOW_SUMMARY
+  // Les résumés attendent la session MQTT dans leur file (les plus récents sont perdus si elle déborde)
+  WindowSummary summary;
+  while (netState == NET_ONLINE && summaries.pop(summary)) {
+    publishSummary(summary);
+  }
+#endif
+#ifdef OAR_METRICS
+  publishMetrics();
+#endif
+}
+
+// Côté capteur : lire une sonde, agréger la lecture dans sa fenêtre et la filtrer
+// Renvoie false si la lecture est invalide
+bool readProbe(uint8_t index) {
+  SensorProbe& probe = probes[index];
+  ProbeState& state = probeStates[index];
   
   // Lecture des valeurs de température et d'humidité du capteur DHT
-  float humidity = dht.readHumidity();           // Lecture de l'humidité
-  float temperature = dht.readTemperature();     // Lecture de la température en °C
+  float humidity;
+  float temperature;
+  {
+    METRIC_SCOPE(METRIC_DHT_READ);
+    humidity = probe.dht.readHumidity();           // Lecture de l'humidité
+    temperature = probe.dht.readTemperature();     // Lecture de la température en °C
+  }
   
   // Vérification si les données lues sont valides (non NaN)
   if (isnan(humidity) || isnan(temperature)) {
-    Serial.println("Erreur de lecture du capteur DHT!");
-    return; // Sortie de la fonction si une erreur est détectée
+    LOG_ERROR("Erreur de lecture du capteur DHT (sonde %u)!", (unsigned)index);
+    return false;
   }
+  // Hors de la plage du DHT22 (-40 à 80 °C, 0 à 100 %) : trame corrompue
+  if (temperature < -40 || temperature > 80 || humidity < 0 || humidity > 100) {
+    LOG_WARN("Lecture du capteur DHT hors plage (sonde %u), ignorée.", (unsigned)index);
+    return false;
+  }
+  temperature += probe.temperatureOffset;
+  humidity += probe.humidityOffset;
   
-  // Envoi de la température au broker MQTT sur le topic "sensors/temperature"
-  if (client.publish("sensors/temperature", String(temperature).c_str())) {
-    Serial.print("Température envoyée : ");
-    Serial.println(temperature);
+  uint32_t timestamp = uptimeMs();
+#if OAR_WINDOW_SUMMARY
+  // Fenêtre écoulée : résumé des lectures précédentes, la lecture courante ouvre la suivante.
+  // Une fenêtre sans lecture valide (capteur en panne) n'est pas publiée.
+  WindowSummary& window = state.window;
+  if (window.temperature.count > 0 && timestamp - window.start >= WINDOW_MS) {
+    window.duration = timestamp - window.start;
+    if (!summaries.push(window)) {
+      LOG_WARN("File des résumés pleine, résumé perdu.");
+    }
+    window.temperature.reset();
+    window.humidity.reset();
+  }
+  if (window.temperature.count == 0) {
+    window.start = timestamp;
+    window.sensor = index;
+  }
+  window.temperature.add(temperature);
+  window.humidity.add(humidity);
+#endif
+  
+  // Toutes les lectures passent par les filtres ; la suite ne voit que les valeurs filtrées
+  state.latest.timestamp = timestamp;
+  state.latest.temperature = temperatureFilters[index].update(temperature);
+  state.latest.humidity = humidityFilters[index].update(humidity);
+  state.latest.sensor = index;
+  state.fresh = true;
+#ifdef OAR_LOCAL_CONTROL
+  // File pleine (tâche réseau bloquée) : la régulation prendra la lecture suivante
+  if (index == CONTROL_PROBE) {
+    controlFeed.push(state.latest);
+  }
+#endif
+  return true;
+}
+
+// Côté capteur : une fois toutes les sondes lues (ou abandonnées) depuis la dernière
+// publication, soumettre leurs dernières lectures à la bande morte et déposer ensemble dans la
+// file celles à publier
+void reportReadings() {
+  for (uint8_t i = 0; i < PROBE_COUNT; i++) {
+    if (!probeStates[i].settled) {
+      return;
+    }
+  }
+  
+#if OAR_WINDOW_SUMMARY
+  // Entre deux échéances de SAMPLE_INTERVAL_MS, les lectures ne sont qu'agrégées et filtrées
+  uint32_t now = uptimeMs();
+  if ((long)(now - nextReportAt) < 0) {
+    return;
+  }
+  nextReportAt += SAMPLE_INTERVAL_MS;
+  if ((long)(now - nextReportAt) >= 0) {
+    nextReportAt = now + SAMPLE_INTERVAL_MS;
+  }
+#endif
+  
+  for (uint8_t i = 0; i < PROBE_COUNT; i++) {
+    ProbeState& state = probeStates[i];
+    bool fresh = state.fresh;
+    state.settled = false;
+    state.fresh = false;
+    if (!fresh) {
+      continue;
+    }
+    
+    // Valeur trop proche de la dernière publiée : rien à envoyer avant le battement de cœur
+    float values[2] = {state.latest.temperature, state.latest.humidity};
+    ReportReason reason = reportFilters[i].admit(DEADBANDS, values, state.latest.timestamp, HEARTBEAT_MS);
+    if (reason == REPORT_NONE) {
+      continue;
+    }
+    if (reason == REPORT_HEARTBEAT) {
+      LOG_DEBUG("Mesure inchangée (sonde %u), publiée comme battement de cœur.", (unsigned)i);
+    }
+    
+    Reading reading = state.latest;
+    reading.seq = sampleSeq++;
+    if (!readings.push(reading)) {
+      LOG_WARN("File des mesures pleine, mesure perdue.");
+    }
+  }
+#ifdef OAR_DEEP_SLEEP
+  // Lectures valides ou essais épuisés pour toutes les sondes : le réveil peut s'achever
+  cycleSampled = true;
+#endif
+}
+
+// Lire la sonde dont l'échéance est la plus proche : une seule lecture bloquante par appel
+void sensorStep(unsigned long now) {
+  if ((long)(now - nextSampleAt) < 0) {
+    return;
+  }
+  uint8_t index = 0;
+  for (uint8_t i = 1; i < PROBE_COUNT; i++) {
+    if ((long)(probeStates[i].nextReadAt - probeStates[index].nextReadAt) < 0) {
+      index = i;
+    }
+  }
+  ProbeState& state = probeStates[index];
+  
+  // Échéances fixes : la période ne dérive pas avec la durée des lectures et des envois.
+  // Après un long blocage (poignée de main TLS), on repart de maintenant au lieu de rattraper.
+  if ((long)(now - state.gridAt) >= 0) {
+    state.gridAt += SENSOR_READ_MS;
+    if ((long)(now - state.gridAt) >= 0) {
+      state.gridAt = now + SENSOR_READ_MS;
+    }
+    state.retries = 0;
+  }
+  state.nextReadAt = state.gridAt;
+  
+  // Lecture invalide : nouvel essai dès que le DHT22 le permet, s'il reste du temps avant
+  // l'échéance suivante. Cela dépend de SENSOR_READ_MS et non du mode : à SAMPLE_INTERVAL_MS
+  // (10 s par défaut), jusqu'à SENSOR_MAX_RETRIES essais, qui retardent d'autant la sonde et donc
+  // reportReadings() (la grille des échéances, elle, ne bouge pas) ; à DHT_MIN_INTERVAL_MS
+  // (résumés par fenêtre), jamais, la lecture suivante étant déjà à 2 s
+  if (!readProbe(index) && state.retries < SENSOR_MAX_RETRIES &&
+      (long)(state.gridAt - now) > (long)DHT_MIN_INTERVAL_MS) {
+    state.retries++;
+    state.nextReadAt = now + DHT_MIN_INTERVAL_MS;
   } else {
-    Serial.println("Erreur lors de l'envoi de la température.");
+    state.settled = true;
+    reportReadings();
   }
   
-  // Envoi de l'humidité au broker MQTT sur le topic "sensors/humidity"
-  if (client.publish("sensors/humidity", String(humidity).c_str())) {
-    Serial.print("Humidité envoyée : ");
-    Serial.println(humidity);
+  nextSampleAt = probeStates[0].nextReadAt;
+  for (uint8_t i = 1; i < PROBE_COUNT; i++) {
+    if ((long)(probeStates[i].nextReadAt - nextSampleAt) < 0) {
+      nextSampleAt = probeStates[i].nextReadAt;
+    }
+  }
+}
+
+#ifdef OAR_LOCAL_CONTROL
+// ------------------- REGULATION LOCALE ------------------------
+const char* controlActionName(ControlAction action) {
+  switch (action) {
+    case CONTROL_COOL_ON: return "cool_on";
+    case CONTROL_COOL_OFF: return "cool_off";
+    case CONTROL_NO_POWER: return "no_power";
+    case CONTROL_GUARD: return "guard";
+    case CONTROL_SEND_FAILED: return "send_failed";
+    default: return "none";
+  }
+}
+
+// Valeur JSON d'une mesure, null si elle est inconnue
+const char* jsonNumber(char* out, size_t size, float value, int decimals) {
+  if (isnan(value)) {
+    return "null";
+  }
+  snprintf(out, size, "%.*f", decimals, value);
+  return out;
+}
+
+// Publier l'état de la régulation pour la supervision côté serveur
+void publishControlState() {
+  char temperature[16];
+  char power[16];
+  char payload[224];
+  snprintf(payload, sizeof(payload),
+           "{\"temperature\":%s,\"power\":%s,\"last\":\"%s\",\"commands\":%lu,\"send_failures\":%lu,"
+           "\"power_failures\":%lu,\"upper\":%.1f,\"lower\":%.1f}",
+           jsonNumber(temperature, sizeof(temperature), controlTemperature, 2),
+           jsonNumber(power, sizeof(power), controlPower, 1), controlActionName(lastControlAction),
+           (unsigned long)climate.commands, (unsigned long)climate.sendFailures,
+           (unsigned long)climate.powerFailures, CONTROL.upperC, CONTROL.lowerC);
+  mqttPublish("control/state", payload);
+}
+
+// Côté réseau : appliquer l'hystérésis à la dernière lecture de la sonde de régulation, dès que
+// le Wi-Fi est associé (session MQTT ouverte ou non)
+void controlStep() {
+  Reading reading = {};
+  bool fresh = false;
+  while (controlFeed.pop(reading)) {
+    fresh = true;
+  }
+  bool wifiUp = netState == NET_MQTT_CONNECTING || netState == NET_ONLINE;
+  if (fresh && wifiUp) {
+    float watts = NAN;
+    ControlAction action = climate.update(CONTROL, reading.temperature, powerMeter, irTransport, IR_COMMAND,
+                                          sizeof(IR_COMMAND), uptimeMs(), &watts);
+    controlTemperature = reading.temperature;
+    if (!isnan(watts)) {
+      controlPower = watts;
+    }
+    if (action != CONTROL_NONE && action != CONTROL_GUARD) {
+      lastControlAction = action;
+    }
+    
+    if (action == CONTROL_COOL_ON || action == CONTROL_COOL_OFF) {
+      LOG_INFO("Température %.2f °C, consommation %.1f W : commande IR envoyée (%s).",
+               reading.temperature, watts, action == CONTROL_COOL_ON ? "marche" : "arrêt");
+      if (netState == NET_ONLINE) {
+        char payload[96];
+        snprintf(payload, sizeof(payload), "{\"action\":\"%s\",\"temperature\":%.2f,\"power\":%.1f,\"commands\":%lu}",
+                 controlActionName(action), reading.temperature, watts, (unsigned long)climate.commands);
+        mqttPublish("control/command", payload, TELEMETRY_QOS);
+      }
+    } else if (action == CONTROL_NO_POWER) {
+      LOG_WARN("Consommation de la prise Shelly illisible, pas de commande IR.");
+    } else if (action == CONTROL_SEND_FAILED) {
+      LOG_ERROR("Échec de l'envoi de la commande IR au Broadlink.");
+    }
+  }
+  
+  if (netState == NET_ONLINE && (long)(uptimeMs() - nextControlStateAt) >= 0) {
+    nextControlStateAt = uptimeMs() + CONTROL_STATE_MS;
+    publishControlState();
+  }
+}
+#endif
+
+#if OAR_DUAL_CORE
+// ------------------- TACHES FREERTOS ------------------------
+// Tâche capteur : réveils aux échéances des sondes, insensible aux blocages du réseau
+void sensorTask(void* parameter) {
+  for (;;) {
+    sensorStep(millis());
+    long wait = (long)(nextSampleAt - millis());
+    vTaskDelay(pdMS_TO_TICKS(wait > 0 ? wait : 0) + 1);
+  }
+}
+
+// Tâche réseau : Wi-Fi, MQTT et TLS, peut bloquer sans retarder les lectures
+void networkTask(void* parameter) {
+  for (;;) {
+    networkStep(millis());
+    drainReadings();
+#ifdef OAR_LOCAL_CONTROL
+    controlStep();
+#endif
+    vTaskDelay(pdMS_TO_TICKS(NETWORK_TICK_MS));
+  }
+}
+
+// Tâche de journal : seule à attendre l'UART, sous les tâches capteur et réseau
+void logTask(void* parameter) {
+  for (;;) {
+    logFlush();
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+  }
+}
+#endif
+
+#ifdef OAR_DEEP_SLEEP
+// ------------------- CYCLE DE SOMMEIL PROFOND ------------------------
+// Publier les durées du cycle en cours (jusqu'ici) et du cycle précédent
+void publishCycleStats(unsigned long now) {
+  char payload[192];
+  snprintf(payload, sizeof(payload),
+           "{\"cycle\":%lu,\"awake_ms\":%lu,\"wifi_ms\":%lu,\"mqtt_ms\":%lu,"
+           "\"prev_awake_ms\":%lu,\"max_awake_ms\":%lu,\"timeouts\":%lu}",
+           (unsigned long)cycleStats.cycles, now, cycleWifiMs, cycleOnlineMs,
+           (unsigned long)cycleStats.lastAwakeMs, (unsigned long)cycleStats.maxAwakeMs,
+           (unsigned long)cycleStats.timeouts);
+  mqttPublish("device/cycle", payload);
+  LOG_DEBUG("Cycle : %s", payload);
+}
+
+// Couper le réseau et dormir jusqu'à l'échéance suivante
+void goToSleep(unsigned long now) {
+  cycleStats.lastAwakeMs = now;
+  if (now > cycleStats.maxAwakeMs) {
+    cycleStats.maxAwakeMs = now;
+  }
+  
+  client.disconnect();
+  WiFi.disconnect(true);
+  
+  unsigned long sleepMs = now + MIN_SLEEP_MS < SAMPLE_INTERVAL_MS ? SAMPLE_INTERVAL_MS - now : MIN_SLEEP_MS;
+  rtcClockBaseMs += now + sleepMs;
+  LOG_INFO("Sommeil profond pendant %lu ms (éveil : %lu ms)", sleepMs, now);
+  // Le journal en attente part avant la coupure de l'UART
+  logFlush();
+  Serial.flush();
+  
+  esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000);
+  esp_deep_sleep_start();
+}
+
+// Dormir dès que la mesure et la réserve sont publiées (ou qu'il n'y a rien à publier), ou quand
+// le budget d'éveil est épuisé
+void dutyCycleStep() {
+  if (netState == NET_UNCONFIGURED) {
+    return; // Sans identifiants, rester éveillé pour permettre le diagnostic
+  }
+  unsigned long now = millis(); // Après networkStep(), qui peut bloquer pendant la poignée de main
+  if (!cycleWifiMs && (netState == NET_MQTT_CONNECTING || netState == NET_ONLINE)) {
+    cycleWifiMs = now;
+  }
+  if (!cycleOnlineMs && netState == NET_ONLINE) {
+    cycleOnlineMs = now;
+  }
+  
+  // Mesure filtrée par la bande morte et réserve vide : rien à publier, la carte se rendort
+  // sans attendre le réseau
+  // Messages MQTT encore dans la file ou en attente de leur PUBACK : pas avant qu'ils soient acquittés
+  bool done = cycleSampled && readings.size() == 0 && backlog.empty() && client.idle();
+  if (done && netState == NET_ONLINE && !cycleReported) {
+    publishCycleStats(now);
+    cycleReported = true;
+    done = client.idle();  // Sinon, le message part au prochain client.loop()
+  }
+  // Prochaine tentative MQTT après la fin du budget (disjoncteur ouvert) : inutile d'attendre
+  bool unreachable = netState == NET_MQTT_CONNECTING && now < AWAKE_BUDGET_MS &&
+                     mqttBackoff.remaining(uptimeMs()) >= AWAKE_BUDGET_MS - now;
+  if (done) {
+    goToSleep(millis());
+  } else if (cycleSampled && unreachable) {
+    LOG_WARN("Broker pas retenté avant la fin du budget d'éveil, mesure gardée en réserve.");
+    Reading reading;
+    while (readings.pop(reading)) {
+      backlog.push(reading);
+    }
+    goToSleep(now);
+  } else if (now >= AWAKE_BUDGET_MS) {
+    LOG_WARN("Budget d'éveil épuisé, mesure gardée en réserve.");
+    Reading reading;
+    while (readings.pop(reading)) {
+      backlog.push(reading);
+    }
+    cycleStats.timeouts++;
+    goToSleep(now);
+  }
+}
+#endif
+
+#ifdef OAR_LIGHT_SLEEP
+// ------------------- SOMMEIL LEGER ------------------------
+// Économie d'énergie du modem (réveil à chaque DTIM) et sommeil léger automatique du CPU dès que
+// toutes les tâches sont bloquées (ESP-IDF compilé avec CONFIG_PM_ENABLE et le tickless idle)
+void enablePowerSave() {
+  WiFi.setSleep(WIFI_PS_MIN_MODEM);
+  
+  esp_pm_config_t pm = {};
+  pm.max_freq_mhz = getCpuFrequencyMhz();
+  pm.min_freq_mhz = 40;  // Fréquence du quartz pendant les attentes
+  pm.light_sleep_enable = true;
+  esp_err_t err = esp_pm_configure(&pm);
+  if (err != ESP_OK) {
+    LOG_WARN("Sommeil léger automatique indisponible (erreur %d), économie d'énergie du modem seule.", err);
+  }
+}
+
+// Bloquer la boucle jusqu'à la prochaine échéance (lecture du capteur, PINGREQ) ou jusqu'à
+// l'arrivée de données du broker
+void idleUntilNextEvent() {
+  unsigned long now = millis();
+  unsigned long wait = (long)(nextSampleAt - now) > 0 ? nextSampleAt - now : 0;
+  
+  if (netState == NET_ONLINE && backlog.empty() && client.idle()) {
+    // Le client MQTT envoie PINGREQ au premier client.loop() après MQTT_KEEPALIVE_S sans émission
+    unsigned long pingAt = espClient.lastWriteMs() + MQTT_KEEPALIVE_S * 1000UL + 1;
+    unsigned long untilPing = (long)(pingAt - now) > 0 ? pingAt - now : 0;
+    wait = untilPing < wait ? untilPing : wait;
+  } else if (netState == NET_MQTT_CONNECTING && !mqttBackoff.due(uptimeMs())) {
+    // Délai de reconnexion ou disjoncteur ouvert : rien à faire avant la prochaine tentative
+    // (une perte du Wi-Fi n'est constatée qu'à cette échéance)
+    unsigned long untilAttempt = mqttBackoff.remaining(uptimeMs());
+    wait = untilAttempt < wait ? untilAttempt : wait;
+  } else if (netState != NET_UNCONFIGURED) {
+    // Association, connexion MQTT, rattrapage ou file MQTT en cours : scrutation rapprochée (les
+    // PUBACK réveillent la boucle dès leur arrivée)
+    wait = IDLE_POLL_MS < wait ? IDLE_POLL_MS : wait;
+  }
+  
+  if (wait > 0) {
+    espClient.waitForData(wait);
+  }
+}
+#endif
+
+// ------------------- FONCTION D'INITIALISATION (SETUP) ------------------------
+void setup() {
+  // Initialisation de la communication série pour le debug
+  Serial.begin(115200);
+#ifdef OAR_DEEP_SLEEP
+  // Au réveil du sommeil profond, chaque milliseconde d'éveil compte : pas d'attente
+  cycleStats.cycles++;
+  cycleSampled = false;   // Déjà faux après un vrai réveil ; utile à la simulation hôte
+  cycleWifiMs = 0;
+  cycleOnlineMs = 0;
+  cycleReported = false;
+  if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) {
+    delay(1000);
+  }
+#else
+  delay(1000);
+#endif
+  
+  LOG_INFO("=== Programme principal avec récupération des identifiants Wi-Fi et MQTT ===");
+  WiFi.persistent(false);
+  
+  // Initialisation des capteurs DHT22
+  for (size_t i = 0; i < PROBE_COUNT; i++) {
+    probes[i].dht.begin();
+  }
+  
+  // Récupération des identifiants Wi-Fi et MQTT : un seul enregistrement chiffré
+  // (l'ancien format clé par clé est converti automatiquement au premier démarrage)
+  LOG_INFO("Récupération des identifiants Wi-Fi et MQTT depuis la mémoire NVS...");
+  
+  if (storage.loadConfig(config)) {
+    // Affichage de toutes les informations récupérées
+    displayAllStoredInformation();
+    
+    // Charger le certificat de l'autorité de certification pour établir la connexion TLS
+    espClient.setCACert(ca_cert);
+    espClient.setSessionCache(&tlsSession);
+    
+    // Configuration du serveur MQTT
+    client.setServer(config.mqtt_server, config.mqtt_port);
+#ifdef OAR_MQTT_SYNC
+    pubSubClient.setBufferSize(MQTT_BUFFER_SIZE);
+#else
+    mqttOutbox.sanitize();  // File en mémoire RTC : vide au démarrage à froid, conservée au réveil
+#endif
+    client.setCallback(onMqttMessage);
+#ifdef OAR_LIGHT_SLEEP
+    client.setKeepAlive(MQTT_KEEPALIVE_S);
+    enablePowerSave();
+#endif
+    
+    // Connexion au réseau Wi-Fi : la suite est gérée par la machine à états de loop()
+    LOG_INFO("Connexion au Wi-Fi...");
+    loadWifiLink();
+    startWifi(millis(), true);
   } else {
-    Serial.println("Erreur lors de l'envoi de l'humidité.");
+    LOG_ERROR("Erreur lors de la récupération des identifiants Wi-Fi!");
+    LOG_ERROR("Veuillez d'abord exécuter le programme de stockage des identifiants.");
+  }
+  
+  // Première lecture de chaque sonde décalée de PROBE_STAGGER_MS sur la précédente
+  nextSampleAt = millis();
+  for (size_t i = 0; i < PROBE_COUNT; i++) {
+    probeStates[i] = ProbeState();
+    probeStates[i].gridAt = nextSampleAt + i * PROBE_STAGGER_MS;
+    probeStates[i].nextReadAt = probeStates[i].gridAt;
   }
+  backlog.sanitize();
   
-  // Attente de 10 secondes avant la prochaine lecture
-  delay(10000);
+#if OAR_DUAL_CORE
+  // La tâche capteur est prioritaire sur la boucle Arduino de son cœur
+  xTaskCreatePinnedToCore(sensorTask, "capteur", 4096, NULL, 2, NULL, SENSOR_CORE);
+  xTaskCreatePinnedToCore(networkTask, "reseau", 8192, NULL, 1, NULL, NETWORK_CORE);
+  xTaskCreatePinnedToCore(logTask, "journal", 3072, NULL, 0, NULL, NETWORK_CORE);
+#endif
+}
+
+// ------------------- BOUCLE PRINCIPALE (LOOP) ------------------------
+// Boucle coopérative : chaque étape rend la main immédiatement, client.loop() est servi à chaque tour
+void loop() {
+#if OAR_DUAL_CORE
+  // Tout le travail est fait par les tâches capteur et réseau
+  vTaskDelete(NULL);
+#else
+  unsigned long now = millis();
+  networkStep(now);
+  sensorStep(now);
+  drainReadings();
+#ifdef OAR_LOCAL_CONTROL
+  controlStep();   // Boucle coopérative : cible hôte seulement (voir REPARTITION SUR LES DEUX COEURS)
+#endif
+#ifdef OAR_DEEP_SLEEP
+  dutyCycleStep();
+#endif
+  // Journal écrit après le travail du tour, sans attendre l'UART
+  logDrain();
+#ifdef OAR_LIGHT_SLEEP
+  idleUntilNextEvent();
+#endif
+#endif
 }
 
 // // Premier programme - Stockage des identifiants Wi-Fi et MQTT
@@ -26,39 +26,35 @@ void setup() {
   
   Serial.println("Stockage des identifiants Wi-Fi dans la mémoire NVS sécurisée...");
   
-  // Stockage du SSID Wi-Fi
-  if (storage.storeSecret("wifi_ssid", wifi_ssid)) {
-    Serial.println("SSID Wi-Fi stocké avec succès!");
+  // Stockage du SSID et du mot de passe Wi-Fi en un seul lot
+  SecretValue values[] = {
+    {"wifi_ssid", wifi_ssid, 0},
+    {"wifi_pass", wifi_pass, 0},
+  };
+  if (storage.storeBatch(values, sizeof(values) / sizeof(values[0]))) {
+    Serial.println("SSID et mot de passe Wi-Fi stockés avec succès!");
   } else {
-    Serial.println("Erreur lors du stockage du SSID Wi-Fi!");
-  }
-  
-  // Stockage du mot de passe Wi-Fi
-  if (storage.storeSecret("wifi_pass", wifi_pass)) {
-    Serial.println("Mot de passe Wi-Fi stocké avec succès!");
-  } else {
-    Serial.println("Erreur lors du stockage du mot de passe Wi-Fi!");
+    Serial.println("Erreur lors du stockage des identifiants Wi-Fi!");
   }
   
   Serial.println("Vérification des secrets stockés...");
   
-  // Vérification que les secrets ont bien été stockés
-  if (storage.secretExists("wifi_ssid") && storage.secretExists("wifi_pass")) {
+  // Vérification que les secrets ont bien été stockés, relus en un seul lot
+  char ssid[64] = {0};
+  char pass[64] = {0};
+  SecretField fields[] = {
+    {"wifi_ssid", ssid, sizeof(ssid), nullptr},
+    {"wifi_pass", pass, sizeof(pass), nullptr},
+  };
+  
+  if (storage.retrieveBatch(fields, sizeof(fields) / sizeof(fields[0]))) {
     Serial.println("Les identifiants Wi-Fi ont été correctement stockés.");
     
     // Affichage pour vérification
-    char ssid[64] = {0};
-    char pass[64] = {0};
-    
-    if (storage.retrieveSecret("wifi_ssid", ssid, sizeof(ssid))) {
-      Serial.print("SSID Wi-Fi récupéré: ");
-      Serial.println(ssid);
-    }
-    
-    if (storage.retrieveSecret("wifi_pass", pass, sizeof(pass))) {
-      Serial.print("Mot de passe Wi-Fi récupéré: ");
-      Serial.println(pass);
-    }
+    Serial.print("SSID Wi-Fi récupéré: ");
+    Serial.println(ssid);
+    Serial.print("Mot de passe Wi-Fi récupéré: ");
+    Serial.println(pass);
     
     Serial.println("\nLe stockage des identifiants Wi-Fi est terminé!");
     Serial.println("Vous pouvez maintenant téléverser le programme principal.");